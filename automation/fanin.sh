@@ -0,0 +1,27 @@
+#!/bin/sh
+# fanin.sh - Scaling of one pong receiving from M pingers. Each pinger is a
+# separate process with its own topic pair (ping -I), and pong reflects all
+# M topics (-T M). Pong's -F reports each source's rate and backlog.
+# The pingers are not pinned, so that they don't share a CPU.
+
+for M in 1 2 4 8; do :
+  T=fanin$M
+  automation/local_run.sh $H2 ponger EF_POLL_USEC=-1 onload ./um_lat_pong -s f -x um.xml $PONGER_A -T $M -F -E >test$T.ponger.log 2>&1 &
+  PONGER_PID=$!
+  sleep 1
+  PINGER_PIDS=""
+  I=0
+  while [ $I -lt $M ]; do :
+    automation/local_run.sh $H1 pinger$I EF_POLL_USEC=-1 onload ./um_lat_ping -s f -x um.xml -I $I -m 24 -n 500000 -r 20000 -w 5,5 -H 2,60 >test$T.pinger$I.log 2>&1 &
+    PINGER_PIDS="$PINGER_PIDS $!"
+    I=`expr $I + 1`
+  done
+  wait $PINGER_PIDS
+  wait $PONGER_PID
+  I=0
+  while [ $I -lt $M ]; do :
+    automation/summary.sh test$T.pinger$I.log; ST="$?"; if [ $ST -ne 0 ]; then exit $ST; fi
+    I=`expr $I + 1`
+  done
+  egrep "^FanIn: (num_sources|percentile=(50|99|99.9),)" test$T.ponger.log
+done
@@ -0,0 +1,15 @@
+#!/bin/sh
+# shim.sh - ping/pong on this host with no middleware (see "bld.sh" without
+# "lbm.sh"), over each of the shim's transports. Subtract these from the UM
+# results taken with the same CPUs to get UM's own share of the latency.
+# Pass affinities as $PINGER_A and $PONGER_A, e.g. PINGER_A="-A 5 -a 6".
+
+for TRANSPORT in udp shm; do :
+  T=shim_$TRANSPORT
+  LBM_SHIM_TRANSPORT=$TRANSPORT ./um_lat_pong -s f $PONGER_A -E >test$T.ponger.log 2>&1 &
+  PONGER_PID=$!
+  sleep 1
+  LBM_SHIM_TRANSPORT=$TRANSPORT ./um_lat_ping -s f $PINGER_A -m 24 -n 500000 -r 20000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1
+  wait $PONGER_PID
+  automation/summary.sh test$T.pinger.log; ST="$?"; if [ $ST -ne 0 ]; then exit $ST; fi
+done
@@ -0,0 +1,24 @@
+#!/bin/sh
+# shm.sh - um_lat_shm_ping/pong on this host, with each of the wait
+# methods, then with two sender threads (MPSC request ring). Compare with
+# udp.sh to see how much of the round trip is the network stack.
+# Pass affinities as $PINGER_A and $PONGER_A, e.g. PINGER_A="-A 5 -a 6".
+
+for S in f s p; do :
+  T=shm_$S
+  M=$S; if [ "$S" = "f" ]; then M=""; fi
+  ./um_lat_shm_pong $PONGER_A -s "$M" -E >test$T.ponger.log 2>&1 &
+  PONGER_PID=$!
+  sleep 1
+  ./um_lat_shm_ping $PINGER_A -s "$M" -m 24 -n 500000 -r 20000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1
+  wait $PONGER_PID
+  automation/summary.sh test$T.pinger.log; ST="$?"; if [ $ST -ne 0 ]; then exit $ST; fi
+done
+
+T=shm_mpsc
+./um_lat_shm_pong $PONGER_A -E >test$T.ponger.log 2>&1 &
+PONGER_PID=$!
+sleep 1
+./um_lat_shm_ping $PINGER_A -T 2 -m 24 -n 250000 -r 10000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1
+wait $PONGER_PID
+automation/summary.sh test$T.pinger.log; ST="$?"; if [ $ST -ne 0 ]; then exit $ST; fi
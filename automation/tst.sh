@@ -39,7 +39,7 @@ T=c1
 automation/local_run.sh $H2 ponger ./um_lat_pong -s f -x um.xml $PONGER_A -E >test$T.ponger.log 2>&1 &
 PONGER_PID=$!
 sleep 1
-automation/local_run.sh $H1 pinger ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 300,1000 >test$T.pinger.log 2>&1 &
+automation/local_run.sh $H1 pinger ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1 &
 PINGER_PID=$!
 echo "wait $PINGER_PID (pinger)"
 wait $PINGER_PID
@@ -51,7 +51,7 @@ T=c2
 automation/local_run.sh $H2 ponger ./um_lat_pong -s f -x um.xml $PONGER_A -E >test$T.ponger.log 2>&1 &
 PONGER_PID=$!
 sleep 1
-automation/local_run.sh $H1 pinger ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 300,1000 >test$T.pinger.log 2>&1 &
+automation/local_run.sh $H1 pinger ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1 &
 PINGER_PID=$!
 echo "wait $PINGER_PID (pinger)"
 wait $PINGER_PID
@@ -63,7 +63,7 @@ T=c3
 automation/local_run.sh $H2 ponger ./um_lat_pong -s f -x um.xml $PONGER_A -E >test$T.ponger.log 2>&1 &
 PONGER_PID=$!
 sleep 1
-automation/local_run.sh $H1 pinger ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 300,1000 >test$T.pinger.log 2>&1 &
+automation/local_run.sh $H1 pinger ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1 &
 PINGER_PID=$!
 echo "wait $PINGER_PID (pinger)"
 wait $PINGER_PID
@@ -75,7 +75,7 @@ T=co1
 automation/local_run.sh $H2 ponger EF_POLL_USEC=-1 onload ./um_lat_pong -s f -x um.xml $PONGER_A -E >test$T.ponger.log 2>&1 &
 PONGER_PID=$!
 sleep 1
-automation/local_run.sh $H1 pinger EF_POLL_USEC=-1 onload ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 300,1000 >test$T.pinger.log 2>&1 &
+automation/local_run.sh $H1 pinger EF_POLL_USEC=-1 onload ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1 &
 PINGER_PID=$!
 echo "wait $PINGER_PID (pinger)"
 wait $PINGER_PID
@@ -87,7 +87,7 @@ T=co2
 automation/local_run.sh $H2 ponger EF_POLL_USEC=-1 onload ./um_lat_pong -s f -x um.xml $PONGER_A -E >test$T.ponger.log 2>&1 &
 PONGER_PID=$!
 sleep 1
-automation/local_run.sh $H1 pinger EF_POLL_USEC=-1 onload ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 300,1000 >test$T.pinger.log 2>&1 &
+automation/local_run.sh $H1 pinger EF_POLL_USEC=-1 onload ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1 &
 PINGER_PID=$!
 echo "wait $PINGER_PID (pinger)"
 wait $PINGER_PID
@@ -99,7 +99,7 @@ T=co3
 automation/local_run.sh $H2 ponger EF_POLL_USEC=-1 onload ./um_lat_pong -s f -x um.xml $PONGER_A -E >test$T.ponger.log 2>&1 &
 PONGER_PID=$!
 sleep 1
-automation/local_run.sh $H1 pinger EF_POLL_USEC=-1 onload ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 300,1000 >test$T.pinger.log 2>&1 &
+automation/local_run.sh $H1 pinger EF_POLL_USEC=-1 onload ./um_lat_ping -s f $PINGER_A -x um.xml -m 24 -n 500000 -r 50000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1 &
 PINGER_PID=$!
 echo "wait $PINGER_PID (pinger)"
 wait $PINGER_PID
@@ -186,3 +186,7 @@ automation/summary.sh test$T.pinger.log
 ./automation/cf.sh
 
 ./automation/jf.sh
+
+./automation/zc.sh
+
+./automation/fanin.sh
@@ -0,0 +1,16 @@
+#!/bin/sh
+# udp.sh - um_lat_udp_ping/pong on this host (loopback), with each of the
+# receive methods. Compare with the UM (or shim.sh) results taken with the
+# same CPUs to see how much of the round trip is the kernel's UDP.
+# Pass affinities as $PINGER_A and $PONGER_A, e.g. PINGER_A="-A 5 -a 6".
+
+for S in b s e; do :
+  T=udp_$S
+  M=$S; if [ "$S" = "b" ]; then M=""; fi
+  ./um_lat_udp_pong $PONGER_A -s "$M" -E >test$T.ponger.log 2>&1 &
+  PONGER_PID=$!
+  sleep 1
+  ./um_lat_udp_ping $PINGER_A -s "$M" -m 24 -n 500000 -r 20000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1
+  wait $PONGER_PID
+  automation/summary.sh test$T.pinger.log; ST="$?"; if [ $ST -ne 0 ]; then exit $ST; fi
+done
@@ -0,0 +1,20 @@
+#!/bin/sh
+# zc.sh - Compare pong's full-copy and header-only (-Z) reflection
+# for large messages. Needs ping's -m >= 72 so that pong reports its
+# turnaround time ("Legs:" lines). Messages must not exceed um.xml's
+# smart_src_max_message_length (1424).
+
+for M in 256 1024 1400; do :
+  for Z in 0 2; do :
+    T=zc${M}z$Z
+    automation/local_run.sh $H2 ponger EF_POLL_USEC=-1 onload ./um_lat_pong -s f -x um.xml $PONGER_A -Z $Z -E >test$T.ponger.log 2>&1 &
+    PONGER_PID=$!
+    sleep 1
+    automation/local_run.sh $H1 pinger EF_POLL_USEC=-1 onload ./um_lat_ping -s f $PINGER_A -x um.xml -m $M -n 1000000 -r 100000 -w 5,5 -H 2,60 >test$T.pinger.log 2>&1 &
+    PINGER_PID=$!
+    wait $PINGER_PID
+    wait $PONGER_PID
+    automation/summary.sh test$T.pinger.log; ST="$?"; if [ $ST -ne 0 ]; then exit $ST; fi
+    egrep "^Legs: percentile=(50|99|99.9)," test$T.pinger.log
+  done
+done
@@ -11,32 +11,58 @@ for F in *.md; do :
   fi
 done
 
-if [ ! -f lbm.sh ]; then :
-  echo "No 'lbm.sh', no tools built."
-  exit 1
+# Without UM, ping and pong are built with the local shim (not UM).
+if [ -f lbm.sh ]; then :
+  . ./lbm.sh
+  LBM_FLAGS="-I $LBM/include -I $LBM/include/lbm"
+  LBM_LIBS="-L $LBM/lib -l lbm"
+else :
+  echo "No 'lbm.sh', building um_lat_ping and um_lat_pong with shim/lbm_shim.c"
+  LBM_FLAGS="-I . -I shim"
+  LBM_SHIM="shim/lbm_shim.c"
 fi
-. ./lbm.sh
 
 # For Linux
 LIBS="-l pthread -l m -l rt"
 
 echo "Building code"
 
-gcc -Wall -g $LIBS \
-    -o um_lat_jitter cprt.c um_lat_jitter.c
+gcc -Wall -g \
+    -o um_lat_jitter cprt.c um_lat_hist.c um_lat_proc.c um_lat_uring.c um_lat_jitter.c $LIBS
 if [ $? -ne 0 ]; then echo error in um_lat_jitter.c; exit 1; fi
 
-gcc -Wall -g -I $LBM/include -I $LBM/include/lbm -L $LBM/lib -l lbm $LIBS \
-    -o um_lat_ping cprt.c um_lat_ping.c
+gcc -Wall -g \
+    -o um_lat_udp_ping cprt.c um_lat_hist.c um_lat_udp.c um_lat_udp_ping.c $LIBS
+if [ $? -ne 0 ]; then echo error in um_lat_udp_ping.c; exit 1; fi
+
+gcc -Wall -g \
+    -o um_lat_udp_pong cprt.c um_lat_udp.c um_lat_udp_pong.c $LIBS
+if [ $? -ne 0 ]; then echo error in um_lat_udp_pong.c; exit 1; fi
+
+gcc -Wall -g \
+    -o um_lat_shm_ping cprt.c um_lat_hist.c um_lat_shm.c um_lat_shm_ping.c $LIBS
+if [ $? -ne 0 ]; then echo error in um_lat_shm_ping.c; exit 1; fi
+
+gcc -Wall -g \
+    -o um_lat_shm_pong cprt.c um_lat_shm.c um_lat_shm_pong.c $LIBS
+if [ $? -ne 0 ]; then echo error in um_lat_shm_pong.c; exit 1; fi
+
+gcc -Wall -g $LBM_FLAGS \
+    -o um_lat_ping cprt.c um_lat_hist.c $LBM_SHIM um_lat_ping.c $LBM_LIBS $LIBS
 if [ $? -ne 0 ]; then echo error in um_lat_ping.c; exit 1; fi
 
-gcc -Wall -g -I $LBM/include -I $LBM/include/lbm -L $LBM/lib -l lbm $LIBS \
-    -o um_lat_pong cprt.c um_lat_pong.c
+gcc -Wall -g $LBM_FLAGS \
+    -o um_lat_pong cprt.c um_lat_hist.c $LBM_SHIM um_lat_pong.c $LBM_LIBS $LIBS
 if [ $? -ne 0 ]; then echo error in um_lat_pong.c; exit 1; fi
 
 gcc -Wall -g $LIBS \
     -o sock_send cprt.c sock_send.c
 
+if [ -n "$LBM_SHIM" ]; then :
+  echo "Success (shim; Java tools need UM)"
+  exit 0
+fi
+
 javac $CP lbmpong.java
 if [ $? -ne 0 ]; then echo error in lbmpong.java; exit 1; fi
 
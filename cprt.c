@@ -82,12 +82,117 @@ void cprt_inittime()
 }  /* cprt_inittime */
 
 
-#else  /* Non-Apple Unixes */
+#elif defined(__x86_64__)  /* Non-Apple Unixes on x86-64. */
+#include <cpuid.h>
+
+int cprt_tsc_selected = 0;
+int cprt_tsc_invariant = -1;  /* Not yet checked. */
+uint64_t cprt_tsc_base_ticks = 0;
+uint64_t cprt_tsc_base_ns = 0;
+uint64_t cprt_tsc_mult = 0;
+
+
+/* Read the TSC and CLOCK_MONOTONIC as close together as possible. Repeat
+ * and keep the pair with the shortest bracket to filter out interrupts. */
+static void cprt_tsc_sample(uint64_t *ticks, uint64_t *ns)
+{
+  uint64_t best_bracket = UINT64_MAX;
+  int i;
+  for (i = 0; i < 10; i++) {
+    struct timespec ts;
+    unsigned int aux;
+    uint64_t t1 = __rdtscp(&aux);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t t2 = __rdtscp(&aux);
+    if ((t2 - t1) < best_bracket) {
+      best_bracket = t2 - t1;
+      *ticks = t1 + (t2 - t1) / 2;
+      *ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    }
+  }
+}  /* cprt_tsc_sample */
+
+
+/* Calibrate the TSC against CLOCK_MONOTONIC. Only done if the CPU reports
+ * an invariant TSC (constant rate, keeps running in deep C-states);
+ * otherwise cprt_tsc_select() refuses to use it. Takes about 50 ms, so it
+ * is only done the first time the TSC is selected. */
+static void cprt_tsc_calibrate()
+{
+  unsigned int eax, ebx, ecx, edx;
+
+  cprt_tsc_invariant = 0;
+  if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) && eax >= 0x80000007) {
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    cprt_tsc_invariant = ((edx & (1 << 8)) != 0);
+  }
+  if (! cprt_tsc_invariant) {
+    return;
+  }
+
+  uint64_t start_ticks, start_ns, end_ticks, end_ns;
+  cprt_tsc_sample(&start_ticks, &start_ns);
+  struct timespec sleep_ts = { 0, 50000000 };
+  nanosleep(&sleep_ts, NULL);
+  cprt_tsc_sample(&end_ticks, &end_ns);
+
+  cprt_tsc_mult = (uint64_t)((((unsigned __int128)(end_ns - start_ns)) << 32)
+      / (end_ticks - start_ticks));
+  cprt_tsc_base_ticks = end_ticks;
+  cprt_tsc_base_ns = end_ns;
+}  /* cprt_tsc_calibrate */
+
+
 void cprt_inittime()
 {
 }  /* cprt_inittime */
 
 
+/* Select the time source for CPRT_GETTIME: 1=TSC, 0=CLOCK_MONOTONIC.
+ * Returns the source actually selected; asking for the TSC falls back to
+ * CLOCK_MONOTONIC if it is not invariant. Call before any timestamps are
+ * taken (the first TSC selection calibrates it). */
+int cprt_tsc_select(int use_tsc)
+{
+  if (use_tsc && cprt_tsc_invariant == -1) {
+    cprt_tsc_calibrate();
+  }
+  cprt_tsc_selected = (use_tsc && cprt_tsc_invariant == 1 && cprt_tsc_mult != 0);
+  return cprt_tsc_selected;
+}  /* cprt_tsc_select */
+
+
+/* TSC rate measured by cprt_tsc_select() (0 if not calibrated). */
+double cprt_tsc_ghz()
+{
+  if (cprt_tsc_mult == 0) {
+    return 0.0;
+  }
+  return 4294967296.0 / (double)cprt_tsc_mult;
+}  /* cprt_tsc_ghz */
+
+
+#else  /* Other non-Apple Unixes */
+void cprt_inittime()
+{
+}  /* cprt_inittime */
+
+
+#endif
+
+
+#if ! defined(__x86_64__) || defined(_WIN32) || defined(__APPLE__)
+/* No TSC time source on this platform; always CLOCK_MONOTONIC. */
+int cprt_tsc_select(int use_tsc)
+{
+  return 0;
+}  /* cprt_tsc_select */
+
+
+double cprt_tsc_ghz()
+{
+  return 0.0;
+}  /* cprt_tsc_ghz */
 #endif
 
 
@@ -372,6 +477,59 @@ int cprt_try_affinity(uint64_t in_mask)
 }  /* cprt_try_affinity */
 
 
+/* Fill "cpus" with the CPU numbers this process may run on (not limited
+ * to 64 like the masks above). Returns the number of CPUs. */
+int cprt_allowed_cpus(int *cpus, int max_cpus)
+{
+  int num_cpus = 0;
+#if defined(_WIN32)
+  DWORD_PTR process_mask, system_mask;
+  int i;
+  if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask) == 0) {
+    errno = GetLastError();
+    CPRT_PERRNO("GetProcessAffinityMask");
+  }
+  for (i = 0; i < (int)(sizeof(process_mask) * 8) && num_cpus < max_cpus; i++) {
+    if (process_mask & ((DWORD_PTR)1 << i)) {
+      cpus[num_cpus++] = i;
+    }
+  }
+
+#elif defined(__linux__)
+  cpu_set_t cpuset;
+  int i;
+  CPU_ZERO(&cpuset);
+  CPRT_EM1(sched_getaffinity(0, sizeof(cpuset), &cpuset));
+  for (i = 0; i < CPU_SETSIZE && num_cpus < max_cpus; i++) {
+    if (CPU_ISSET(i, &cpuset)) {
+      cpus[num_cpus++] = i;
+    }
+  }
+
+#else /* Non-Linux Unix. */
+#endif
+  return num_cpus;
+}  /* cprt_allowed_cpus */
+
+
+/* Pin the calling thread to one CPU (any CPU number). */
+void cprt_set_affinity_cpu(int cpu)
+{
+#if defined(_WIN32)
+  cprt_set_affinity(1ull << cpu);
+
+#elif defined(__linux__)
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  CPRT_EOK0(errno = pthread_setaffinity_np(
+      pthread_self(), sizeof(cpuset), &cpuset));
+
+#else /* Non-Linux Unix. */
+#endif
+}  /* cprt_set_affinity_cpu */
+
+
 #define CPRT_MAX_EVENTS 1024
 int cprt_num_events = 0;
 int cprt_events[CPRT_MAX_EVENTS];
@@ -508,6 +508,31 @@ extern "C" {
 } while (0)
 
 
+/* Align a struct or field to a cache line, to avoid false sharing. */
+#if defined(_WIN32)
+  #define CPRT_CACHE_ALIGN __declspec(align(64))
+#else
+  #define CPRT_CACHE_ALIGN __attribute__((aligned(64)))
+#endif
+
+
+/* For spin-wait loops: CPRT_CPU_PAUSE() hints to the CPU that the thread is
+ * spinning, CPRT_YIELD() gives the CPU to another runnable thread. */
+#if defined(_WIN32)
+  #define CPRT_CPU_PAUSE() YieldProcessor()
+  #define CPRT_YIELD() SwitchToThread()
+#else
+  #if defined(__x86_64__) || defined(__i386__)
+    #define CPRT_CPU_PAUSE() __builtin_ia32_pause()
+  #elif defined(__aarch64__)
+    #define CPRT_CPU_PAUSE() __asm__ __volatile__("yield")
+  #else
+    #define CPRT_CPU_PAUSE() do { } while (0)
+  #endif
+  #define CPRT_YIELD() sched_yield()
+#endif
+
+
 #define CPRT_INITTIME cprt_inittime
 #if defined(_WIN32)
   struct cprt_timeval {
@@ -526,7 +551,34 @@ extern "C" {
   #define CPRT_GETTIME(_ts) clock_gettime(CLOCK_MONOTONIC_RAW, _ts)
   #define cprt_timeval timeval
   #define cprt_timespec timespec
-#else  /* Non-Apple Unixes */
+#elif defined(__x86_64__)  /* Non-Apple Unixes on x86-64. */
+  #include <x86intrin.h>
+  /* The time source can be switched at run time from CLOCK_MONOTONIC to the
+   * CPU's invariant TSC (see cprt_tsc_select()). The TSC is calibrated against
+   * CLOCK_MONOTONIC when it is first selected, so the two sources share an epoch
+   * and can be mixed within a process. */
+  extern int cprt_tsc_selected;
+  extern uint64_t cprt_tsc_base_ticks;
+  extern uint64_t cprt_tsc_base_ns;
+  extern uint64_t cprt_tsc_mult;  /* ns per tick, scaled by 2^32. */
+  #define CPRT_GETTIME(_ts) cprt_gettime(_ts)
+  static inline void cprt_gettime(struct timespec *ts)
+  {
+    if (cprt_tsc_selected) {
+      unsigned int aux;
+      uint64_t ticks = __rdtscp(&aux) - cprt_tsc_base_ticks;
+      uint64_t ns = cprt_tsc_base_ns
+          + (uint64_t)(((unsigned __int128)ticks * cprt_tsc_mult) >> 32);
+      ts->tv_sec = (time_t)(ns / 1000000000);
+      ts->tv_nsec = (long)(ns % 1000000000);
+    }
+    else {
+      clock_gettime(CLOCK_MONOTONIC, ts);
+    }
+  }  /* cprt_gettime */
+  #define cprt_timeval timeval
+  #define cprt_timespec timespec
+#else  /* Other non-Apple Unixes */
   #define CPRT_GETTIME(_ts) clock_gettime(CLOCK_MONOTONIC, _ts)
   #define cprt_timeval timeval
   #define cprt_timespec timespec
@@ -544,7 +596,11 @@ extern "C" {
 char *cprt_strerror(int errnum, char *buffer, size_t buf_sz);
 void cprt_set_affinity(uint64_t in_mask);
 int cprt_try_affinity(uint64_t in_mask);
+int cprt_allowed_cpus(int *cpus, int max_cpus);
+void cprt_set_affinity_cpu(int cpu);
 void cprt_inittime();
+int cprt_tsc_select(int use_tsc);
+double cprt_tsc_ghz();
 void cprt_sleep_ns(uint64_t duration_ns);
 void cprt_localtime_r(time_t *timep, struct tm *result);
 
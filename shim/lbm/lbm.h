@@ -0,0 +1,183 @@
+/* lbm.h - local stand-in for the subset of the UM API used by um_lat_ping
+ * and um_lat_pong. See shim/lbm_shim.c and https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+/* This is NOT Ultra Messaging. It has the same names and signatures as the
+ * UM functions the tools call, so that the tools build unchanged with
+ * "-I shim" in place of the UM include directory. Messages go over loopback
+ * UDP multicast or a shared-memory ring (see LBM_SHIM_TRANSPORT in
+ * lbm_shim.c); there is no topic resolution, persistence, or recovery.
+ */
+
+#ifndef LBM_SHIM_H
+#define LBM_SHIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LBM_OK 0
+#define LBM_FAILURE -1
+
+#define LBM_MSG_MAX_SOURCE_LEN 128
+#define LBM_SHIM_MAX_MSG_LEN 2000  /* Fits a shared-memory ring slot. */
+
+typedef unsigned int lbm_uint_t;
+typedef unsigned long lbm_ulong_t;
+
+typedef struct lbm_context_stct_t lbm_context_t;
+typedef struct lbm_context_attr_stct_t lbm_context_attr_t;
+typedef struct lbm_context_stct_t lbm_xsp_t;  /* An XSP is a context without sources. */
+typedef struct lbm_src_stct_t lbm_src_t;
+typedef struct lbm_src_stct_t lbm_ssrc_t;  /* Smart Sources are sources with loaned buffers. */
+typedef struct lbm_rcv_stct_t lbm_rcv_t;
+typedef struct lbm_topic_stct_t lbm_topic_t;
+typedef struct lbm_topic_attr_stct_t lbm_src_topic_attr_t;
+typedef struct lbm_topic_attr_stct_t lbm_rcv_topic_attr_t;
+typedef struct lbm_event_queue_stct_t lbm_event_queue_t;
+
+/* Message types (msg->type). */
+#define LBM_MSG_DATA 0
+#define LBM_MSG_EOS 1
+#define LBM_MSG_UNRECOVERABLE_LOSS 5
+#define LBM_MSG_BOS 10
+#define LBM_MSG_UME_REGISTRATION_ERROR 11
+
+#define LBM_MSG_FLAG_RETRANSMIT 0x2  /* Never set; there is no recovery. */
+
+typedef struct lbm_msg_t_stct {
+  char source[LBM_MSG_MAX_SOURCE_LEN];
+  const char *topic_name;
+  const char *data;
+  size_t len;
+  int type;
+  lbm_uint_t sequence_number;
+  lbm_ulong_t flags;
+  void *source_clientd;  /* From the source notification create callback. */
+
+  /* Private to the shim. */
+  int refcnt;  /* Delivery holds one; lbm_msg_retain() adds one. */
+  int from_heap;  /* Pool was all retained; free on last delete. */
+  char *buf;  /* LBM_SHIM_MAX_MSG_LEN bytes. */
+} lbm_msg_t;
+
+typedef struct {
+  int transport_type;
+  char source[LBM_MSG_MAX_SOURCE_LEN];
+} lbm_new_transport_info_t;
+
+typedef lbm_xsp_t *(*lbm_transport_mapping_function_cb)(lbm_context_t *ctx,
+    lbm_new_transport_info_t *transp_info, void *clientd);
+typedef struct {
+  lbm_transport_mapping_function_cb mapping_func;
+  void *clientd;
+} lbm_transport_mapping_func_t;
+
+typedef void *(*lbm_rcv_src_notification_create_function_cb)(const char *source_name, void *clientd);
+typedef int (*lbm_rcv_src_notification_delete_function_cb)(const char *source_name, void *clientd, void *source_clientd);
+typedef struct {
+  lbm_rcv_src_notification_create_function_cb create_func;
+  lbm_rcv_src_notification_delete_function_cb delete_func;
+  void *clientd;
+} lbm_rcv_src_notification_func_t;
+
+/* Source events. The shim never delivers any; they are defined so that the
+ * tools' event handlers compile. */
+#define LBM_SRC_EVENT_CONNECT 1
+#define LBM_SRC_EVENT_DISCONNECT 2
+#define LBM_SRC_EVENT_WAKEUP 4
+#define LBM_SRC_EVENT_UME_REGISTRATION_ERROR 5
+#define LBM_SRC_EVENT_UME_STORE_UNRESPONSIVE 7
+#define LBM_SRC_EVENT_UME_REGISTRATION_SUCCESS_EX 13
+#define LBM_SRC_EVENT_UME_REGISTRATION_COMPLETE_EX 14
+#define LBM_SRC_EVENT_UME_MESSAGE_STABLE_EX 15
+#define LBM_SRC_EVENT_SEQUENCE_NUMBER_INFO 17
+#define LBM_SRC_EVENT_FLIGHT_SIZE_NOTIFICATION 18
+#define LBM_SRC_EVENT_UME_MESSAGE_RECLAIMED_EX 19
+#define LBM_SRC_EVENT_UME_DEREGISTRATION_SUCCESS_EX 20
+#define LBM_SRC_EVENT_UME_DEREGISTRATION_COMPLETE_EX 21
+#define LBM_SRC_EVENT_UME_MESSAGE_NOT_STABLE 22
+#define LBM_SRC_EVENT_UME_MESSAGE_RECLAIMED_EX_FLAG_FORCED 0x1
+typedef struct {
+  lbm_uint_t sequence_number;
+  lbm_uint_t flags;
+} lbm_src_event_ume_ack_ex_info_t;
+
+#define LBM_SRC_NONBLOCK 0x1
+
+typedef int (*lbm_log_cb_proc)(int level, const char *message, void *clientd);
+typedef int (*lbm_rcv_cb_proc)(lbm_rcv_t *rcv, lbm_msg_t *msg, void *clientd);
+typedef int (*lbm_src_cb_proc)(lbm_src_t *src, int event, void *extra_data, void *client_data);
+typedef int (*lbm_ssrc_cb_proc)(lbm_ssrc_t *ssrc, int event, void *extra_data, void *client_data);
+typedef struct lbm_ssrc_send_ex_info_t_stct lbm_ssrc_send_ex_info_t;
+
+const char *lbm_errmsg(void);
+int lbm_log(lbm_log_cb_proc proc, void *clientd);
+/* Configuration files are accepted and ignored. */
+int lbm_config(const char *fname);
+int lbm_config_xml_file(const char *url, const char *application_name);
+
+int lbm_context_attr_create(lbm_context_attr_t **attrp);
+int lbm_context_attr_delete(lbm_context_attr_t *attr);
+int lbm_context_attr_setopt(lbm_context_attr_t *attr, const char *optname, void *optval, size_t optlen);
+int lbm_context_attr_str_setopt(lbm_context_attr_t *attr, const char *optname, const char *optval);
+int lbm_context_create(lbm_context_t **ctxp, lbm_context_attr_t *attr, void *proc, void *clientd);
+int lbm_context_delete(lbm_context_t *ctx);
+int lbm_context_process_events(lbm_context_t *ctx, lbm_ulong_t msec);
+int lbm_context_unblock(lbm_context_t *ctx);
+
+int lbm_xsp_create(lbm_xsp_t **xspp, lbm_context_t *ctx, lbm_context_attr_t *cattr, void *xattr);
+int lbm_xsp_delete(lbm_xsp_t *xsp);
+int lbm_xsp_process_events(lbm_xsp_t *xsp, lbm_ulong_t msec);
+int lbm_xsp_unblock(lbm_xsp_t *xsp);
+
+int lbm_src_topic_attr_create(lbm_src_topic_attr_t **attrp);
+int lbm_src_topic_attr_delete(lbm_src_topic_attr_t *attr);
+int lbm_src_topic_attr_str_setopt(lbm_src_topic_attr_t *attr, const char *optname, const char *optval);
+int lbm_src_topic_alloc(lbm_topic_t **topicp, lbm_context_t *ctx, const char *symbol, lbm_src_topic_attr_t *attr);
+int lbm_src_create(lbm_src_t **srcp, lbm_context_t *ctx, lbm_topic_t *topic, lbm_src_cb_proc proc, void *clientd, lbm_event_queue_t *evq);
+int lbm_src_delete(lbm_src_t *src);
+int lbm_src_send(lbm_src_t *src, const char *msg, size_t len, int flags);
+
+int lbm_ssrc_create(lbm_ssrc_t **ssrcp, lbm_context_t *ctx, lbm_topic_t *topic, lbm_ssrc_cb_proc proc, void *clientd, lbm_event_queue_t *evq);
+int lbm_ssrc_delete(lbm_ssrc_t *ssrc);
+int lbm_ssrc_buff_get(lbm_ssrc_t *ssrc, char **bp, int flags);
+int lbm_ssrc_buff_put(lbm_ssrc_t *ssrc, char *buff);
+int lbm_ssrc_send_ex(lbm_ssrc_t *ssrc, char *buff, size_t len, int flags, lbm_ssrc_send_ex_info_t *info);
+
+int lbm_rcv_topic_attr_create(lbm_rcv_topic_attr_t **attrp);
+int lbm_rcv_topic_attr_delete(lbm_rcv_topic_attr_t *attr);
+int lbm_rcv_topic_attr_setopt(lbm_rcv_topic_attr_t *attr, const char *optname, void *optval, size_t optlen);
+int lbm_rcv_topic_lookup(lbm_topic_t **topicp, lbm_context_t *ctx, const char *symbol, lbm_rcv_topic_attr_t *attr);
+int lbm_rcv_create(lbm_rcv_t **rcvp, lbm_context_t *ctx, lbm_topic_t *topic, lbm_rcv_cb_proc proc, void *clientd, lbm_event_queue_t *evq);
+int lbm_rcv_delete(lbm_rcv_t *rcv);
+
+int lbm_msg_retain(lbm_msg_t *msg);
+int lbm_msg_delete(lbm_msg_t *msg);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  /* LBM_SHIM_H */
@@ -0,0 +1,1109 @@
+/* lbm_shim.c - local stand-in for the subset of the UM API used by
+ * um_lat_ping and um_lat_pong. See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+/* The shim moves messages with no middleware protocol at all, so its
+ * numbers are a floor to compare UM's against on the same host and CPUs.
+ * Environment variables:
+ *   LBM_SHIM_TRANSPORT - "udp" (default) or "shm".
+ *   LBM_SHIM_ADDR - UDP destination; default 239.101.3.10. A unicast
+ *       address works too, but then only one receiver gets each message.
+ *   LBM_SHIM_INTERFACE - multicast interface; default 127.0.0.1.
+ *   LBM_SHIM_PORT - base UDP port; a topic uses base + (hash % 1000).
+ *
+ * udp: each topic is a UDP port. Any number of sources and receivers.
+ * shm: each topic is a ring in "/dev/shm/lbm_shim.<topic>" with one source
+ *   and any number of receivers. The source never waits for receivers; a
+ *   receiver that falls more than a ring behind sees unrecoverable loss.
+ *
+ * Both transports put the same header in front of each message, so
+ * receivers find sources (BOS, EOS, source notification) and detect loss
+ * (sequence gaps) the same way. Contexts and XSPs are both event loops
+ * that poll their receivers: in a thread of their own, or in the
+ * application's with "operational_mode" "sequential". A context's thread
+ * blocks in poll() unless "file_descriptor_management_behavior" is
+ * "busy_wait"; with shm, it never blocks (it yields, or spins with busy_wait).
+ */
+
+#include "cprt.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "lbm/lbm.h"
+
+#define SHIM_MAGIC 0x4c424d53  /* "LBMS" */
+#define SHIM_MAX_RCVS 64  /* Per context or XSP. */
+#define SHIM_MAX_SOURCES 256  /* Per receiver. */
+#define SHIM_MSG_POOL 2048  /* Per receiver; more than pong's handoff ring. */
+#define SHIM_RCV_BATCH 64  /* Datagrams read per receiver per pass. */
+#define SHIM_RING_SLOTS 4096  /* Must be a power of 2. */
+#define SHIM_SOCKET_BUFFER (8 * 1024 * 1024)
+
+enum shim_transport_enum { SHIM_UDP, SHIM_SHM };
+enum shim_hdr_type_enum { SHIM_HDR_DATA, SHIM_HDR_EOS };
+
+/* In front of every message, on both transports. */
+struct shim_hdr_s {
+  uint32_t magic;
+  uint32_t topic_hash;  /* Drops other topics that hash to the same port. */
+  uint64_t src_id;  /* pid << 20 | source number within the process. */
+  uint32_t seq;  /* Per source. */
+  uint16_t type;
+  uint16_t pad;
+};
+
+struct shim_slot_s {
+  uint64_t seq;  /* Ring position + 1 when valid; 0 while being written. */
+  uint32_t len;
+  uint32_t pad;
+  struct shim_hdr_s hdr;
+  char data[LBM_SHIM_MAX_MSG_LEN];
+};
+
+struct shim_ring_s {
+  uint32_t magic;
+  uint32_t num_slots;
+  CPRT_CACHE_ALIGN uint64_t head;  /* Ring positions written so far. */
+  uint64_t src_id;  /* Current source, or 0. */
+  CPRT_CACHE_ALIGN struct shim_slot_s slots[SHIM_RING_SLOTS];
+};
+
+struct lbm_context_attr_stct_t {
+  int sequential;
+  int busy_wait;
+  lbm_transport_mapping_func_t mapping;  /* mapping_func NULL = none. */
+};
+
+struct lbm_topic_attr_stct_t {
+  lbm_rcv_src_notification_func_t src_notification;  /* create_func NULL = none. */
+};
+
+struct lbm_topic_stct_t {
+  char name[256];
+  uint32_t hash;
+  struct lbm_topic_attr_stct_t attr;
+};
+
+/* A context or an XSP. */
+struct lbm_context_stct_t {
+  struct lbm_context_attr_stct_t attr;
+  CPRT_MUTEX_T lock;  /* Protects rcvs[]; held while delivering. */
+  lbm_rcv_t *rcvs[SHIM_MAX_RCVS];
+  int num_rcvs;
+  int wake_fd;  /* eventfd; interrupts poll(). */
+  int unblock;
+  int running;  /* Context thread (not sequential). */
+  CPRT_THREAD_T thread_id;
+};
+
+struct lbm_src_stct_t {
+  lbm_topic_t *topic;
+  struct shim_hdr_s hdr;  /* Next header to send. */
+  int sock;  /* udp. */
+  struct sockaddr_in dest;
+  struct shim_ring_s *ring;  /* shm. */
+};
+
+/* A source seen by a receiver. */
+struct shim_rcv_source_s {
+  uint64_t src_id;
+  uint32_t next_seq;
+  void *source_clientd;
+  char name[LBM_MSG_MAX_SOURCE_LEN];
+};
+
+struct lbm_rcv_stct_t {
+  lbm_context_t *evq;  /* The context or XSP that delivers its messages. */
+  lbm_topic_t *topic;
+  lbm_rcv_cb_proc proc;
+  void *clientd;
+  int sock;  /* udp. */
+  struct shim_ring_s *ring;  /* shm. */
+  uint64_t ring_next;  /* Next ring position to read. */
+  struct shim_rcv_source_s sources[SHIM_MAX_SOURCES];
+  int num_sources;
+  int last_source;  /* Index of the most recent lookup. */
+  lbm_msg_t *pool;  /* SHIM_MSG_POOL messages, each with its buffer. */
+  char *pool_bufs;
+  int pool_next;
+};
+
+/* Globals. */
+__thread char shim_errmsg[256];
+lbm_log_cb_proc shim_log_proc = NULL;
+void *shim_log_clientd = NULL;
+enum shim_transport_enum shim_transport = SHIM_UDP;
+struct in_addr shim_addr;
+struct in_addr shim_interface;
+int shim_port = 14400;
+int shim_env_read = 0;
+int shim_num_srcs = 0;  /* Source numbers within this process. */
+
+
+static int shim_fail(const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(shim_errmsg, sizeof(shim_errmsg), fmt, args);
+  va_end(args);
+  return LBM_FAILURE;
+}  /* shim_fail */
+
+
+static void shim_log(const char *fmt, ...)
+{
+  char message[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(message, sizeof(message), fmt, args);
+  va_end(args);
+  if (shim_log_proc != NULL) {
+    (*shim_log_proc)(5, message, shim_log_clientd);
+  }
+}  /* shim_log */
+
+
+/* FNV-1a. */
+static uint32_t shim_hash(const char *str)
+{
+  uint32_t hash = 2166136261u;
+  while (*str != '\0') {
+    hash ^= (uint8_t)*str++;
+    hash *= 16777619u;
+  }
+  return hash;
+}  /* shim_hash */
+
+
+static void shim_read_env()
+{
+  char *env;
+  if (shim_env_read) {
+    return;
+  }
+  shim_env_read = 1;
+
+  env = getenv("LBM_SHIM_TRANSPORT");
+  if (env != NULL && strcasecmp(env, "shm") == 0) {
+    shim_transport = SHIM_SHM;
+  }
+  env = getenv("LBM_SHIM_ADDR");
+  inet_aton((env != NULL) ? env : "239.101.3.10", &shim_addr);
+  env = getenv("LBM_SHIM_INTERFACE");
+  inet_aton((env != NULL) ? env : "127.0.0.1", &shim_interface);
+  env = getenv("LBM_SHIM_PORT");
+  if (env != NULL) {
+    shim_port = atoi(env);
+  }
+
+  shim_log("lbm_shim: transport=%s, addr=%s, port=%d (not Ultra Messaging)",
+      (shim_transport == SHIM_SHM) ? "shm" : "udp", inet_ntoa(shim_addr), shim_port);
+}  /* shim_read_env */
+
+
+const char *lbm_errmsg(void)
+{
+  return shim_errmsg;
+}  /* lbm_errmsg */
+
+
+int lbm_log(lbm_log_cb_proc proc, void *clientd)
+{
+  shim_log_proc = proc;
+  shim_log_clientd = clientd;
+  return LBM_OK;
+}  /* lbm_log */
+
+
+int lbm_config(const char *fname)
+{
+  return LBM_OK;
+}  /* lbm_config */
+
+
+int lbm_config_xml_file(const char *url, const char *application_name)
+{
+  return LBM_OK;
+}  /* lbm_config_xml_file */
+
+
+/*
+ * Attributes. Options the shim has no use for are accepted and ignored.
+ */
+
+int lbm_context_attr_create(lbm_context_attr_t **attrp)
+{
+  lbm_context_attr_t *attr = (lbm_context_attr_t *)calloc(1, sizeof(lbm_context_attr_t));
+  if (attr == NULL) {
+    return shim_fail("lbm_context_attr_create: out of memory");
+  }
+  *attrp = attr;
+  return LBM_OK;
+}  /* lbm_context_attr_create */
+
+
+int lbm_context_attr_delete(lbm_context_attr_t *attr)
+{
+  free(attr);
+  return LBM_OK;
+}  /* lbm_context_attr_delete */
+
+
+int lbm_context_attr_setopt(lbm_context_attr_t *attr, const char *optname, void *optval, size_t optlen)
+{
+  if (strcmp(optname, "transport_mapping_function") == 0) {
+    if (optlen != sizeof(lbm_transport_mapping_func_t)) {
+      return shim_fail("lbm_context_attr_setopt: bad optlen for '%s'", optname);
+    }
+    memcpy(&attr->mapping, optval, optlen);
+  }
+  return LBM_OK;
+}  /* lbm_context_attr_setopt */
+
+
+int lbm_context_attr_str_setopt(lbm_context_attr_t *attr, const char *optname, const char *optval)
+{
+  if (strcmp(optname, "operational_mode") == 0) {
+    attr->sequential = (strcmp(optval, "sequential") == 0);
+  }
+  else if (strcmp(optname, "file_descriptor_management_behavior") == 0) {
+    attr->busy_wait = (strcmp(optval, "busy_wait") == 0);
+  }
+  return LBM_OK;
+}  /* lbm_context_attr_str_setopt */
+
+
+int lbm_src_topic_attr_create(lbm_src_topic_attr_t **attrp)
+{
+  lbm_src_topic_attr_t *attr = (lbm_src_topic_attr_t *)calloc(1, sizeof(lbm_src_topic_attr_t));
+  if (attr == NULL) {
+    return shim_fail("lbm_src_topic_attr_create: out of memory");
+  }
+  *attrp = attr;
+  return LBM_OK;
+}  /* lbm_src_topic_attr_create */
+
+
+int lbm_src_topic_attr_delete(lbm_src_topic_attr_t *attr)
+{
+  free(attr);
+  return LBM_OK;
+}  /* lbm_src_topic_attr_delete */
+
+
+int lbm_src_topic_attr_str_setopt(lbm_src_topic_attr_t *attr, const char *optname, const char *optval)
+{
+  return LBM_OK;
+}  /* lbm_src_topic_attr_str_setopt */
+
+
+int lbm_rcv_topic_attr_create(lbm_rcv_topic_attr_t **attrp)
+{
+  return lbm_src_topic_attr_create(attrp);
+}  /* lbm_rcv_topic_attr_create */
+
+
+int lbm_rcv_topic_attr_delete(lbm_rcv_topic_attr_t *attr)
+{
+  free(attr);
+  return LBM_OK;
+}  /* lbm_rcv_topic_attr_delete */
+
+
+int lbm_rcv_topic_attr_setopt(lbm_rcv_topic_attr_t *attr, const char *optname, void *optval, size_t optlen)
+{
+  if (strcmp(optname, "source_notification_function") == 0) {
+    if (optlen != sizeof(lbm_rcv_src_notification_func_t)) {
+      return shim_fail("lbm_rcv_topic_attr_setopt: bad optlen for '%s'", optname);
+    }
+    memcpy(&attr->src_notification, optval, optlen);
+  }
+  return LBM_OK;
+}  /* lbm_rcv_topic_attr_setopt */
+
+
+static int shim_topic_create(lbm_topic_t **topicp, const char *symbol, struct lbm_topic_attr_stct_t *attr)
+{
+  lbm_topic_t *topic = (lbm_topic_t *)calloc(1, sizeof(lbm_topic_t));
+  if (topic == NULL) {
+    return shim_fail("topic: out of memory");
+  }
+  strncpy(topic->name, symbol, sizeof(topic->name) - 1);
+  topic->hash = shim_hash(topic->name);
+  if (attr != NULL) {
+    topic->attr = *attr;
+  }
+  *topicp = topic;  /* Like UM, topic objects are never freed. */
+  return LBM_OK;
+}  /* shim_topic_create */
+
+
+int lbm_src_topic_alloc(lbm_topic_t **topicp, lbm_context_t *ctx, const char *symbol, lbm_src_topic_attr_t *attr)
+{
+  return shim_topic_create(topicp, symbol, attr);
+}  /* lbm_src_topic_alloc */
+
+
+int lbm_rcv_topic_lookup(lbm_topic_t **topicp, lbm_context_t *ctx, const char *symbol, lbm_rcv_topic_attr_t *attr)
+{
+  return shim_topic_create(topicp, symbol, attr);
+}  /* lbm_rcv_topic_lookup */
+
+
+/*
+ * Transports.
+ */
+
+static int shim_topic_port(lbm_topic_t *topic)
+{
+  return shim_port + (int)(topic->hash % 1000);
+}  /* shim_topic_port */
+
+
+/* Map the topic's ring, creating it if this is the first user. */
+static int shim_ring_map(lbm_topic_t *topic, struct shim_ring_s **ringp)
+{
+  char path[300];
+  char *c;
+  struct stat st;
+  struct shim_ring_s *ring;
+
+  snprintf(path, sizeof(path), "/lbm_shim.%s", topic->name);
+  for (c = path + 1; *c != '\0'; c++) {
+    if (*c == '/') {
+      *c = '_';
+    }
+  }
+
+  int fd = shm_open(path, O_RDWR | O_CREAT, 0666);
+  if (fd == -1) {
+    return shim_fail("shm_open(%s): %s", path, strerror(errno));
+  }
+  if (fstat(fd, &st) == -1 || (st.st_size < (off_t)sizeof(struct shim_ring_s)
+      && ftruncate(fd, sizeof(struct shim_ring_s)) == -1)) {
+    close(fd);
+    return shim_fail("ring %s: %s", path, strerror(errno));
+  }
+  ring = (struct shim_ring_s *)mmap(NULL, sizeof(struct shim_ring_s),
+      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED) {
+    return shim_fail("mmap(%s): %s", path, strerror(errno));
+  }
+  /* A new file is all zeros, which is an empty ring. */
+  ring->magic = SHIM_MAGIC;
+  ring->num_slots = SHIM_RING_SLOTS;
+
+  *ringp = ring;
+  return LBM_OK;
+}  /* shim_ring_map */
+
+
+/* Single writer (the topic's only source). */
+static void shim_ring_write(struct shim_ring_s *ring, struct shim_hdr_s *hdr, const char *data, size_t len)
+{
+  uint64_t pos = ring->head;  /* Only this thread writes it. */
+  struct shim_slot_s *slot = &ring->slots[pos & (SHIM_RING_SLOTS - 1)];
+
+  /* Seqlock: readers that see the slot change under them drop the copy. */
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  slot->hdr = *hdr;
+  slot->len = (uint32_t)len;
+  memcpy(slot->data, data, len);
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->head, pos + 1, __ATOMIC_RELEASE);
+}  /* shim_ring_write */
+
+
+static int shim_src_create(lbm_src_t **srcp, lbm_topic_t *topic)
+{
+  lbm_src_t *src;
+
+  shim_read_env();
+  src = (lbm_src_t *)calloc(1, sizeof(lbm_src_t));
+  if (src == NULL) {
+    return shim_fail("source: out of memory");
+  }
+  src->topic = topic;
+  src->sock = -1;
+  src->hdr.magic = SHIM_MAGIC;
+  src->hdr.topic_hash = topic->hash;
+  src->hdr.src_id = ((uint64_t)getpid() << 20) | (uint64_t)__atomic_add_fetch(&shim_num_srcs, 1, __ATOMIC_RELAXED);
+  src->hdr.type = SHIM_HDR_DATA;
+
+  if (shim_transport == SHIM_SHM) {
+    if (shim_ring_map(topic, &src->ring) != LBM_OK) {
+      free(src);
+      return LBM_FAILURE;
+    }
+    uint64_t cur_src_id = __atomic_load_n(&src->ring->src_id, __ATOMIC_ACQUIRE);
+    if (cur_src_id != 0 && kill((pid_t)(cur_src_id >> 20), 0) == 0) {
+      munmap(src->ring, sizeof(struct shim_ring_s));
+      free(src);
+      return shim_fail("topic '%s' already has a shm source", topic->name);
+    }
+    __atomic_store_n(&src->ring->src_id, src->hdr.src_id, __ATOMIC_RELEASE);
+  }
+  else {
+    unsigned char loop = 1;
+    unsigned char ttl = 0;  /* Stay on this host. */
+    src->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (src->sock == -1) {
+      free(src);
+      return shim_fail("socket: %s", strerror(errno));
+    }
+    if (IN_MULTICAST(ntohl(shim_addr.s_addr))) {
+      if (setsockopt(src->sock, IPPROTO_IP, IP_MULTICAST_IF, &shim_interface, sizeof(shim_interface)) == -1
+          || setsockopt(src->sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) == -1
+          || setsockopt(src->sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) == -1) {
+        close(src->sock);
+        free(src);
+        return shim_fail("multicast setsockopt: %s", strerror(errno));
+      }
+    }
+    src->dest.sin_family = AF_INET;
+    src->dest.sin_addr = shim_addr;
+    src->dest.sin_port = htons(shim_topic_port(topic));
+  }
+
+  *srcp = src;
+  return LBM_OK;
+}  /* shim_src_create */
+
+
+static int shim_src_send(lbm_src_t *src, const char *msg, size_t len)
+{
+  if (len > LBM_SHIM_MAX_MSG_LEN) {
+    return shim_fail("send: message length %d > %d", (int)len, LBM_SHIM_MAX_MSG_LEN);
+  }
+
+  if (src->ring != NULL) {
+    shim_ring_write(src->ring, &src->hdr, msg, len);
+  }
+  else {
+    struct iovec iov[2];
+    struct msghdr msghdr;
+    iov[0].iov_base = &src->hdr;
+    iov[0].iov_len = sizeof(src->hdr);
+    iov[1].iov_base = (void *)msg;
+    iov[1].iov_len = len;
+    memset(&msghdr, 0, sizeof(msghdr));
+    msghdr.msg_name = &src->dest;
+    msghdr.msg_namelen = sizeof(src->dest);
+    msghdr.msg_iov = iov;
+    msghdr.msg_iovlen = 2;
+    if (sendmsg(src->sock, &msghdr, 0) == -1) {
+      return shim_fail("sendmsg: %s", strerror(errno));
+    }
+  }
+  src->hdr.seq++;
+  return LBM_OK;
+}  /* shim_src_send */
+
+
+/* Tell the receivers that the source is gone (EOS). */
+static int shim_src_delete(lbm_src_t *src)
+{
+  src->hdr.type = SHIM_HDR_EOS;
+  int e = shim_src_send(src, NULL, 0);
+
+  if (src->ring != NULL) {
+    __atomic_store_n(&src->ring->src_id, 0, __ATOMIC_RELEASE);
+    munmap(src->ring, sizeof(struct shim_ring_s));
+  }
+  if (src->sock != -1) {
+    close(src->sock);
+  }
+  free(src);
+  return e;
+}  /* shim_src_delete */
+
+
+int lbm_src_create(lbm_src_t **srcp, lbm_context_t *ctx, lbm_topic_t *topic, lbm_src_cb_proc proc, void *clientd, lbm_event_queue_t *evq)
+{
+  return shim_src_create(srcp, topic);
+}  /* lbm_src_create */
+
+
+int lbm_src_delete(lbm_src_t *src)
+{
+  return shim_src_delete(src);
+}  /* lbm_src_delete */
+
+
+int lbm_src_send(lbm_src_t *src, const char *msg, size_t len, int flags)
+{
+  return shim_src_send(src, msg, len);
+}  /* lbm_src_send */
+
+
+int lbm_ssrc_create(lbm_ssrc_t **ssrcp, lbm_context_t *ctx, lbm_topic_t *topic, lbm_ssrc_cb_proc proc, void *clientd, lbm_event_queue_t *evq)
+{
+  return shim_src_create(ssrcp, topic);
+}  /* lbm_ssrc_create */
+
+
+int lbm_ssrc_delete(lbm_ssrc_t *ssrc)
+{
+  return shim_src_delete(ssrc);
+}  /* lbm_ssrc_delete */
+
+
+/* The buffers are ordinary memory; sending copies them. */
+int lbm_ssrc_buff_get(lbm_ssrc_t *ssrc, char **bp, int flags)
+{
+  char *buff = (char *)calloc(1, LBM_SHIM_MAX_MSG_LEN);
+  if (buff == NULL) {
+    return shim_fail("lbm_ssrc_buff_get: out of memory");
+  }
+  *bp = buff;
+  return LBM_OK;
+}  /* lbm_ssrc_buff_get */
+
+
+int lbm_ssrc_buff_put(lbm_ssrc_t *ssrc, char *buff)
+{
+  free(buff);
+  return LBM_OK;
+}  /* lbm_ssrc_buff_put */
+
+
+int lbm_ssrc_send_ex(lbm_ssrc_t *ssrc, char *buff, size_t len, int flags, lbm_ssrc_send_ex_info_t *info)
+{
+  return shim_src_send(ssrc, buff, len);
+}  /* lbm_ssrc_send_ex */
+
+
+/*
+ * Messages. Each receiver has a pool; a message that the application
+ * retained is skipped until it is deleted.
+ */
+
+static lbm_msg_t *shim_msg_get(lbm_rcv_t *rcv)
+{
+  int i;
+  lbm_msg_t *msg;
+
+  for (i = 0; i < SHIM_MSG_POOL; i++) {
+    msg = &rcv->pool[rcv->pool_next];
+    rcv->pool_next = (rcv->pool_next + 1) & (SHIM_MSG_POOL - 1);
+    if (__atomic_load_n(&msg->refcnt, __ATOMIC_ACQUIRE) == 0) {
+      return msg;
+    }
+  }
+
+  /* All retained (e.g. a slow reflector thread); use the heap. */
+  msg = (lbm_msg_t *)calloc(1, sizeof(lbm_msg_t));
+  CPRT_ASSERT(msg != NULL);
+  msg->buf = (char *)malloc(LBM_SHIM_MAX_MSG_LEN);
+  CPRT_ASSERT(msg->buf != NULL);
+  msg->from_heap = 1;
+  return msg;
+}  /* shim_msg_get */
+
+
+static void shim_msg_free(lbm_msg_t *msg)
+{
+  if (msg->from_heap) {
+    free(msg->buf);
+    free(msg);
+  }
+}  /* shim_msg_free */
+
+
+int lbm_msg_retain(lbm_msg_t *msg)
+{
+  __atomic_add_fetch(&msg->refcnt, 1, __ATOMIC_RELAXED);
+  return LBM_OK;
+}  /* lbm_msg_retain */
+
+
+int lbm_msg_delete(lbm_msg_t *msg)
+{
+  if (__atomic_sub_fetch(&msg->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+    shim_msg_free(msg);
+  }
+  return LBM_OK;
+}  /* lbm_msg_delete */
+
+
+/* Call the receiver callback with "msg"; fields other than the source's
+ * are already set. */
+static void shim_deliver(lbm_rcv_t *rcv, struct shim_rcv_source_s *source, lbm_msg_t *msg, int type, uint32_t seq)
+{
+  strcpy(msg->source, source->name);
+  msg->topic_name = rcv->topic->name;
+  msg->data = msg->buf;
+  msg->type = type;
+  msg->sequence_number = seq;
+  msg->flags = 0;
+  msg->source_clientd = source->source_clientd;
+  __atomic_store_n(&msg->refcnt, 1, __ATOMIC_RELAXED);
+
+  (*rcv->proc)(rcv, msg, rcv->clientd);
+
+  lbm_msg_delete(msg);
+}  /* shim_deliver */
+
+
+/* Handle one message: find its source (delivering BOS for a new one),
+ * deliver loss for any sequence gap, then deliver the message itself. */
+static void shim_rcv_msg(lbm_rcv_t *rcv, struct shim_hdr_s *hdr, lbm_msg_t *msg)
+{
+  struct shim_rcv_source_s *source = &rcv->sources[rcv->last_source];
+  int i;
+
+  if (hdr->magic != SHIM_MAGIC || hdr->topic_hash != rcv->topic->hash) {
+    shim_msg_free(msg);  /* Another topic on the same port. */
+    return;
+  }
+
+  if (rcv->num_sources == 0 || source->src_id != hdr->src_id) {
+    for (i = 0; i < rcv->num_sources; i++) {
+      if (rcv->sources[i].src_id == hdr->src_id) {
+        break;
+      }
+    }
+    if (i == rcv->num_sources) {
+      /* New source. */
+      if (hdr->type == SHIM_HDR_EOS || rcv->num_sources == SHIM_MAX_SOURCES) {
+        shim_msg_free(msg);
+        return;
+      }
+      source = &rcv->sources[i];
+      rcv->num_sources++;
+      source->src_id = hdr->src_id;
+      source->next_seq = hdr->seq;
+      snprintf(source->name, sizeof(source->name), "SHIM-%s:%d:%d",
+          (rcv->ring != NULL) ? "SHM" : "UDP",
+          (int)(hdr->src_id >> 20), (int)(hdr->src_id & 0xfffff));
+      source->source_clientd = NULL;
+      if (rcv->topic->attr.src_notification.create_func != NULL) {
+        source->source_clientd = (*rcv->topic->attr.src_notification.create_func)(
+            source->name, rcv->topic->attr.src_notification.clientd);
+      }
+      msg->len = 0;
+      shim_deliver(rcv, source, msg, LBM_MSG_BOS, hdr->seq);
+      msg = shim_msg_get(rcv);
+    }
+    rcv->last_source = i;
+    source = &rcv->sources[i];
+  }
+
+  while (source->next_seq != hdr->seq) {
+    lbm_msg_t *loss_msg = shim_msg_get(rcv);
+    loss_msg->len = 0;
+    shim_deliver(rcv, source, loss_msg, LBM_MSG_UNRECOVERABLE_LOSS, source->next_seq);
+    source->next_seq++;
+  }
+  source->next_seq++;
+
+  if (hdr->type == SHIM_HDR_EOS) {
+    msg->len = 0;
+    shim_deliver(rcv, source, msg, LBM_MSG_EOS, hdr->seq);
+    if (rcv->topic->attr.src_notification.delete_func != NULL) {
+      (*rcv->topic->attr.src_notification.delete_func)(source->name,
+          rcv->topic->attr.src_notification.clientd, source->source_clientd);
+    }
+    /* Forget the source (it can't come back with the same src_id). */
+    rcv->num_sources--;
+    rcv->sources[rcv->last_source] = rcv->sources[rcv->num_sources];
+    rcv->last_source = 0;
+  }
+  else {
+    shim_deliver(rcv, source, msg, LBM_MSG_DATA, hdr->seq);
+  }
+}  /* shim_rcv_msg */
+
+
+/* Deliver what is waiting for one receiver. Returns the number of messages. */
+static int shim_rcv_poll(lbm_rcv_t *rcv)
+{
+  int num_msgs = 0;
+
+  if (rcv->ring != NULL) {
+    struct shim_ring_s *ring = rcv->ring;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (head - rcv->ring_next > SHIM_RING_SLOTS) {
+      /* Fell behind; the sequence gap shows up as loss. */
+      rcv->ring_next = head - SHIM_RING_SLOTS;
+    }
+    while (rcv->ring_next < head && num_msgs < SHIM_RCV_BATCH) {
+      uint64_t pos = rcv->ring_next++;
+      struct shim_slot_s *slot = &ring->slots[pos & (SHIM_RING_SLOTS - 1)];
+      if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+        continue;  /* Overwritten. */
+      }
+      lbm_msg_t *msg = shim_msg_get(rcv);
+      struct shim_hdr_s hdr = slot->hdr;
+      uint32_t len = slot->len;
+      if (len > LBM_SHIM_MAX_MSG_LEN) {
+        len = LBM_SHIM_MAX_MSG_LEN;  /* Torn; dropped below. */
+      }
+      memcpy(msg->buf, slot->data, len);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != pos + 1) {
+        shim_msg_free(msg);
+        continue;  /* Overwritten while copying. */
+      }
+      msg->len = len;
+      shim_rcv_msg(rcv, &hdr, msg);
+      num_msgs++;
+    }
+  }
+  else {
+    while (num_msgs < SHIM_RCV_BATCH) {
+      struct shim_hdr_s hdr;
+      struct iovec iov[2];
+      struct msghdr msghdr;
+      lbm_msg_t *msg = shim_msg_get(rcv);
+      iov[0].iov_base = &hdr;
+      iov[0].iov_len = sizeof(hdr);
+      iov[1].iov_base = msg->buf;
+      iov[1].iov_len = LBM_SHIM_MAX_MSG_LEN;
+      memset(&msghdr, 0, sizeof(msghdr));
+      msghdr.msg_iov = iov;
+      msghdr.msg_iovlen = 2;
+      ssize_t n = recvmsg(rcv->sock, &msghdr, MSG_DONTWAIT);
+      if (n < (ssize_t)sizeof(hdr)) {
+        shim_msg_free(msg);
+        if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+          shim_log("lbm_shim: recvmsg: %s", strerror(errno));
+        }
+        break;
+      }
+      msg->len = (size_t)n - sizeof(hdr);
+      shim_rcv_msg(rcv, &hdr, msg);
+      num_msgs++;
+    }
+  }
+
+  return num_msgs;
+}  /* shim_rcv_poll */
+
+
+int lbm_rcv_create(lbm_rcv_t **rcvp, lbm_context_t *ctx, lbm_topic_t *topic, lbm_rcv_cb_proc proc, void *clientd, lbm_event_queue_t *evq)
+{
+  int i;
+  lbm_rcv_t *rcv = (lbm_rcv_t *)calloc(1, sizeof(lbm_rcv_t));
+  if (rcv == NULL) {
+    return shim_fail("lbm_rcv_create: out of memory");
+  }
+  shim_read_env();
+  rcv->topic = topic;
+  rcv->proc = proc;
+  rcv->clientd = clientd;
+  rcv->sock = -1;
+  rcv->pool = (lbm_msg_t *)calloc(SHIM_MSG_POOL, sizeof(lbm_msg_t));
+  rcv->pool_bufs = (char *)malloc((size_t)SHIM_MSG_POOL * LBM_SHIM_MAX_MSG_LEN);
+  if (rcv->pool == NULL || rcv->pool_bufs == NULL) {
+    return shim_fail("lbm_rcv_create: out of memory");
+  }
+  for (i = 0; i < SHIM_MSG_POOL; i++) {
+    rcv->pool[i].buf = &rcv->pool_bufs[(size_t)i * LBM_SHIM_MAX_MSG_LEN];
+  }
+
+  if (shim_transport == SHIM_SHM) {
+    if (shim_ring_map(topic, &rcv->ring) != LBM_OK) {
+      return LBM_FAILURE;
+    }
+    /* Start with the next message. */
+    rcv->ring_next = __atomic_load_n(&rcv->ring->head, __ATOMIC_ACQUIRE);
+  }
+  else {
+    int opt = 1;
+    struct sockaddr_in bind_addr;
+    rcv->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rcv->sock == -1) {
+      return shim_fail("socket: %s", strerror(errno));
+    }
+    /* Several receivers (processes) per topic. */
+    setsockopt(rcv->sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    opt = SHIM_SOCKET_BUFFER;
+    setsockopt(rcv->sock, SOL_SOCKET, SO_RCVBUF, &opt, sizeof(opt));
+    memset(&bind_addr, 0, sizeof(bind_addr));
+    bind_addr.sin_family = AF_INET;
+    bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    bind_addr.sin_port = htons(shim_topic_port(topic));
+    if (bind(rcv->sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) == -1) {
+      return shim_fail("bind(%d): %s", shim_topic_port(topic), strerror(errno));
+    }
+    if (IN_MULTICAST(ntohl(shim_addr.s_addr))) {
+      struct ip_mreq mreq;
+      mreq.imr_multiaddr = shim_addr;
+      mreq.imr_interface = shim_interface;
+      if (setsockopt(rcv->sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == -1) {
+        return shim_fail("IP_ADD_MEMBERSHIP: %s", strerror(errno));
+      }
+    }
+  }
+
+  /* UM maps each transport session when it is joined; the shim's topics are
+   * their own sessions, so map now. */
+  rcv->evq = ctx;
+  if (ctx->attr.mapping.mapping_func != NULL) {
+    lbm_new_transport_info_t transp_info;
+    memset(&transp_info, 0, sizeof(transp_info));
+    size_t len = strlen(topic->name);
+    if (len >= sizeof(transp_info.source)) {
+      len = sizeof(transp_info.source) - 1;
+    }
+    memcpy(transp_info.source, topic->name, len);
+    lbm_xsp_t *xsp = (*ctx->attr.mapping.mapping_func)(ctx, &transp_info, ctx->attr.mapping.clientd);
+    if (xsp != NULL) {
+      rcv->evq = xsp;
+    }
+  }
+
+  CPRT_MUTEX_LOCK(rcv->evq->lock);
+  if (rcv->evq->num_rcvs == SHIM_MAX_RCVS) {
+    CPRT_MUTEX_UNLOCK(rcv->evq->lock);
+    return shim_fail("lbm_rcv_create: more than %d receivers", SHIM_MAX_RCVS);
+  }
+  rcv->evq->rcvs[rcv->evq->num_rcvs++] = rcv;
+  CPRT_MUTEX_UNLOCK(rcv->evq->lock);
+  lbm_context_unblock(rcv->evq);  /* Its thread should poll the new socket. */
+
+  *rcvp = rcv;
+  return LBM_OK;
+}  /* lbm_rcv_create */
+
+
+int lbm_rcv_delete(lbm_rcv_t *rcv)
+{
+  int i;
+  lbm_context_t *evq = rcv->evq;
+
+  CPRT_MUTEX_LOCK(evq->lock);
+  for (i = 0; i < evq->num_rcvs; i++) {
+    if (evq->rcvs[i] == rcv) {
+      evq->rcvs[i] = evq->rcvs[--evq->num_rcvs];
+      break;
+    }
+  }
+  CPRT_MUTEX_UNLOCK(evq->lock);
+
+  if (rcv->ring != NULL) {
+    munmap(rcv->ring, sizeof(struct shim_ring_s));
+  }
+  if (rcv->sock != -1) {
+    close(rcv->sock);
+  }
+  /* The pool is not freed; the application might still hold messages. */
+  return LBM_OK;
+}  /* lbm_rcv_delete */
+
+
+/*
+ * Contexts and XSPs.
+ */
+
+/* One event loop for a context or XSP: poll its receivers until "msec" has
+ * passed (0=once) or it is unblocked. */
+static int shim_process_events(lbm_context_t *evq, lbm_ulong_t msec)
+{
+  struct timespec start_ts, now_ts;
+  struct pollfd fds[SHIM_MAX_RCVS + 1];
+  int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &start_ts);
+  while (1) {
+    int num_msgs = 0;
+    int num_fds = 0;
+    int has_ring = 0;
+
+    CPRT_MUTEX_LOCK(evq->lock);
+    for (i = 0; i < evq->num_rcvs; i++) {
+      lbm_rcv_t *rcv = evq->rcvs[i];
+      num_msgs += shim_rcv_poll(rcv);
+      if (rcv->ring != NULL) {
+        has_ring = 1;
+      }
+      else {
+        fds[num_fds].fd = rcv->sock;
+        fds[num_fds].events = POLLIN;
+        num_fds++;
+      }
+    }
+    CPRT_MUTEX_UNLOCK(evq->lock);
+
+    if (__atomic_load_n(&evq->unblock, __ATOMIC_ACQUIRE) || msec == 0) {
+      break;
+    }
+    if (num_msgs > 0) {
+      continue;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now_ts);
+    uint64_t elapsed_ms = (uint64_t)(now_ts.tv_sec - start_ts.tv_sec) * 1000
+        + (uint64_t)((now_ts.tv_nsec - start_ts.tv_nsec) / 1000000);
+    if (elapsed_ms >= msec) {
+      break;
+    }
+
+    if (evq->attr.busy_wait) {
+      CPRT_CPU_PAUSE();
+    }
+    else if (has_ring) {
+      CPRT_YIELD();  /* Nothing to block on. */
+    }
+    else {
+      fds[num_fds].fd = evq->wake_fd;
+      fds[num_fds].events = POLLIN;
+      num_fds++;
+      if (poll(fds, num_fds, (int)(msec - elapsed_ms)) > 0 && (fds[num_fds - 1].revents & POLLIN)) {
+        uint64_t count;
+        if (read(evq->wake_fd, &count, sizeof(count)) == -1) {
+          /* Already drained. */
+        }
+      }
+    }
+  }
+
+  __atomic_store_n(&evq->unblock, 0, __ATOMIC_RELEASE);
+  return LBM_OK;
+}  /* shim_process_events */
+
+
+static CPRT_THREAD_ENTRYPOINT shim_evq_thread(void *in_arg)
+{
+  lbm_context_t *evq = (lbm_context_t *)in_arg;
+
+  while (__atomic_load_n(&evq->running, __ATOMIC_ACQUIRE)) {
+    shim_process_events(evq, 100);
+  }
+
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* shim_evq_thread */
+
+
+static int shim_evq_create(lbm_context_t **evqp, lbm_context_attr_t *attr)
+{
+  lbm_context_t *evq;
+
+  shim_read_env();
+  evq = (lbm_context_t *)calloc(1, sizeof(lbm_context_t));
+  if (evq == NULL) {
+    return shim_fail("context: out of memory");
+  }
+  if (attr != NULL) {
+    evq->attr = *attr;
+  }
+  CPRT_MUTEX_INIT(evq->lock);
+  evq->wake_fd = eventfd(0, EFD_NONBLOCK);
+  if (evq->wake_fd == -1) {
+    free(evq);
+    return shim_fail("eventfd: %s", strerror(errno));
+  }
+
+  if (! evq->attr.sequential) {
+    evq->running = 1;
+    CPRT_THREAD_CREATE(evq->thread_id, shim_evq_thread, evq);
+  }
+
+  *evqp = evq;
+  return LBM_OK;
+}  /* shim_evq_create */
+
+
+static int shim_evq_delete(lbm_context_t *evq)
+{
+  if (evq->running) {
+    __atomic_store_n(&evq->running, 0, __ATOMIC_RELEASE);
+    lbm_context_unblock(evq);
+    CPRT_THREAD_JOIN(evq->thread_id);
+  }
+  close(evq->wake_fd);
+  CPRT_MUTEX_DELETE(evq->lock);
+  free(evq);
+  return LBM_OK;
+}  /* shim_evq_delete */
+
+
+int lbm_context_create(lbm_context_t **ctxp, lbm_context_attr_t *attr, void *proc, void *clientd)
+{
+  return shim_evq_create(ctxp, attr);
+}  /* lbm_context_create */
+
+
+int lbm_context_delete(lbm_context_t *ctx)
+{
+  return shim_evq_delete(ctx);
+}  /* lbm_context_delete */
+
+
+int lbm_context_process_events(lbm_context_t *ctx, lbm_ulong_t msec)
+{
+  return shim_process_events(ctx, msec);
+}  /* lbm_context_process_events */
+
+
+int lbm_context_unblock(lbm_context_t *ctx)
+{
+  uint64_t one = 1;
+  __atomic_store_n(&ctx->unblock, 1, __ATOMIC_RELEASE);
+  if (write(ctx->wake_fd, &one, sizeof(one)) == -1) {
+    /* Counter full; poll() will wake anyway. */
+  }
+  return LBM_OK;
+}  /* lbm_context_unblock */
+
+
+/* The context attributes given to the XSP (not the parent's) decide its
+ * operational mode and fd management. */
+int lbm_xsp_create(lbm_xsp_t **xspp, lbm_context_t *ctx, lbm_context_attr_t *cattr, void *xattr)
+{
+  return shim_evq_create(xspp, cattr);
+}  /* lbm_xsp_create */
+
+
+int lbm_xsp_delete(lbm_xsp_t *xsp)
+{
+  return shim_evq_delete(xsp);
+}  /* lbm_xsp_delete */
+
+
+int lbm_xsp_process_events(lbm_xsp_t *xsp, lbm_ulong_t msec)
+{
+  return shim_process_events(xsp, msec);
+}  /* lbm_xsp_process_events */
+
+
+int lbm_xsp_unblock(lbm_xsp_t *xsp)
+{
+  return lbm_context_unblock(xsp);
+}  /* lbm_xsp_unblock */
@@ -31,6 +31,7 @@ extern "C" {
 #include <pthread.h>
 #include <sched.h>
 #include <inttypes.h>
+#include <stddef.h>
 
 /* Simple error handling macros:
  * E() - for UM API calls. Checks for error (return != 0). If error, prints
@@ -72,9 +73,48 @@ extern "C" {
 
 struct perf_msg_s {
   struct timespec send_ts;
+  /* The fields below are optional. A field is only present if the message
+   * length (-m) is large enough to hold it; see PERF_MSG_HAS(). */
+  uint64_t seq;  /* Set by ping, starting at 1. */
+  struct timespec intended_ts;  /* Scheduled send time (ping -C). */
+  struct timespec pong_rcv_ts;  /* Set by pong when message received. */
+  struct timespec pong_send_ts;  /* Set by pong just before reflecting. */
+  struct timespec pong_handoff_ts;  /* Set by pong's reflector thread when
+                                     * it takes the message (pong -D). */
 };
 typedef struct perf_msg_s perf_msg_t;
 
+/* Record written for each received message by um_lat_ping -f. The file is
+ * a flat array of these (native byte order), e.g. for numpy:
+ *   np.dtype([('sequence','<u8'),('send_ns','<u8'),('rcv_ns','<u8'),
+ *             ('flags','<u4'),('reserved','<u4')])
+ */
+struct raw_sample_s {
+  uint64_t sequence;  /* UM sequence number of the reflected message. */
+  uint64_t send_ns;  /* Ping's send timestamp (CLOCK_MONOTONIC ns). */
+  uint64_t rcv_ns;  /* Ping's receive timestamp (CLOCK_MONOTONIC ns). */
+  uint32_t flags;  /* UM message flags (e.g. LBM_MSG_FLAG_RETRANSMIT). */
+  uint32_t reserved;
+};
+typedef struct raw_sample_s raw_sample_t;
+
+/* Convert a struct timespec to nanoseconds. */
+#define TS_TO_NS(ts_) ((uint64_t)(ts_).tv_sec * 1000000000ull + (uint64_t)(ts_).tv_nsec)
+
+/* Minimum message length that holds "field_" (and everything before it). */
+#define PERF_MSG_LEN_THROUGH(field_) \
+  (offsetof(perf_msg_t, field_) + sizeof(((perf_msg_t *)0)->field_))
+
+/* True if a message of length "len_" is long enough to hold "field_". */
+#define PERF_MSG_HAS(len_, field_) ((size_t)(len_) >= PERF_MSG_LEN_THROUGH(field_))
+
+/* Add nanoseconds to a struct timespec. */
+#define TS_ADD_NS(ts_add_result_, ts_add_start_, ts_add_ns_) do { \
+  uint64_t ts_add_sum_ns_ = (uint64_t)(ts_add_start_).tv_nsec + (ts_add_ns_); \
+  (ts_add_result_).tv_sec = (ts_add_start_).tv_sec + (time_t)(ts_add_sum_ns_ / 1000000000ull); \
+  (ts_add_result_).tv_nsec = (long)(ts_add_sum_ns_ % 1000000000ull); \
+} while (0)  /* TS_ADD_NS */
+
 #if defined(__cplusplus)
 }
 #endif
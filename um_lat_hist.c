@@ -0,0 +1,258 @@
+/* um_lat_hist.c - log-linear latency histogram shared by the um_lat tools.
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#include "cprt.h"
+#include <stdio.h>
+#include <string.h>
+#if ! defined(_WIN32)
+  #include <stdlib.h>
+  #include <unistd.h>
+#endif
+
+#include "um_lat.h"
+#include "um_lat_hist.h"
+
+
+hist_t *hist_create(int sig_digits, uint64_t max_ns)
+{
+  ASSRT(sig_digits >= 1 && sig_digits <= 5);
+  ASSRT(max_ns >= 2);
+
+  hist_t *hist = (hist_t *)malloc(sizeof(hist_t));
+  ASSRT(hist != NULL);
+  memset(hist, 0, sizeof(hist_t));
+  hist->sig_digits = sig_digits;
+  hist->max_ns = max_ns;
+
+  /* Enough linear sub-buckets per power of two to resolve "sig_digits"
+   * decimal digits (e.g. 2 digits needs 200, rounded up to 256). */
+  uint64_t largest_single_unit = 2;
+  int i;
+  for (i = 0; i < sig_digits; i++) {
+    largest_single_unit *= 10;
+  }
+  int sub_bucket_count_magnitude = 0;
+  while ((1ull << sub_bucket_count_magnitude) < largest_single_unit) {
+    sub_bucket_count_magnitude++;
+  }
+  uint64_t sub_bucket_count = 1ull << sub_bucket_count_magnitude;
+  hist->sub_bucket_half_count_magnitude = sub_bucket_count_magnitude - 1;
+  hist->sub_bucket_half_count = (int)(sub_bucket_count / 2);
+  hist->sub_bucket_mask = sub_bucket_count - 1;
+
+  /* Number of power-of-two groups needed to reach max_ns. */
+  uint64_t smallest_untrackable = sub_bucket_count;
+  int bucket_groups = 1;
+  while (smallest_untrackable <= max_ns) {
+    ASSRT(smallest_untrackable < (1ull << 62));
+    smallest_untrackable <<= 1;
+    bucket_groups++;
+  }
+  hist->num_buckets = (bucket_groups + 1) * hist->sub_bucket_half_count;
+
+  hist->buckets = (uint64_t *)malloc(hist->num_buckets * sizeof(uint64_t));
+  ASSRT(hist->buckets != NULL);
+
+  hist_init(hist);
+
+  return hist;
+}  /* hist_create */
+
+
+void hist_delete(hist_t *hist)
+{
+  free(hist->buckets);
+  free(hist);
+}  /* hist_delete */
+
+
+void hist_init(hist_t *hist)
+{
+  /* Re-initialize the data. */
+  hist->min_sample = UINT64_MAX;
+  hist->max_sample = 0;
+  hist->overflows = 0;
+  hist->num_samples = 0;
+  hist->sample_sum = 0;
+
+  /* Init histogram (also makes sure it is mapped to physical memory. */
+  int i;
+  for (i = 0; i < hist->num_buckets; i++) {
+    hist->buckets[i] = 0;
+  }
+}  /* hist_init */
+
+
+/* Called in the time-critical path: no allocation, no loops. */
+void hist_input(hist_t *hist, uint64_t in_sample)
+{
+  hist->num_samples++;
+  hist->sample_sum += in_sample;
+
+  if (in_sample > hist->max_sample) {
+    hist->max_sample = in_sample;
+  }
+  if (in_sample < hist->min_sample) {
+    hist->min_sample = in_sample;
+  }
+
+  /* Power-of-two group, then linear sub-bucket within the group. */
+  int bucket_group = 64 - __builtin_clzll(in_sample | hist->sub_bucket_mask)
+      - (hist->sub_bucket_half_count_magnitude + 1);
+  uint64_t sub_bucket = in_sample >> bucket_group;
+  uint64_t bucket = ((uint64_t)(bucket_group + 1) << hist->sub_bucket_half_count_magnitude)
+      + (sub_bucket - hist->sub_bucket_half_count);
+
+  if (bucket >= hist->num_buckets) {
+    hist->overflows++;
+  }
+  else {
+    hist->buckets[bucket]++;
+  }
+}  /* hist_input */
+
+
+/* Add the samples of "src" into "dst". Both must have been created with
+ * the same parameters. Not for the time-critical path. */
+void hist_merge(hist_t *dst, hist_t *src)
+{
+  int i;
+  ASSRT(dst->num_buckets == src->num_buckets);
+  ASSRT(dst->sig_digits == src->sig_digits);
+
+  for (i = 0; i < dst->num_buckets; i++) {
+    dst->buckets[i] += src->buckets[i];
+  }
+  if (src->num_samples > 0) {
+    if (src->min_sample < dst->min_sample) {
+      dst->min_sample = src->min_sample;
+    }
+    if (src->max_sample > dst->max_sample) {
+      dst->max_sample = src->max_sample;
+    }
+  }
+  dst->overflows += src->overflows;
+  dst->num_samples += src->num_samples;
+  dst->sample_sum += src->sample_sum;
+}  /* hist_merge */
+
+
+/* Highest value (in ns) that lands in the given bucket. */
+static uint64_t hist_bucket_top(hist_t *hist, int bucket)
+{
+  int bucket_group = (bucket >> hist->sub_bucket_half_count_magnitude) - 1;
+  uint64_t sub_bucket = (bucket & (hist->sub_bucket_half_count - 1))
+      + hist->sub_bucket_half_count;
+  if (bucket_group < 0) {
+    sub_bucket -= hist->sub_bucket_half_count;
+    bucket_group = 0;
+  }
+
+  return ((sub_bucket + 1) << bucket_group) - 1;
+}  /* hist_bucket_top */
+
+
+/* Get the latency (in ns) which "percentile" percent of samples are at or
+ * below. The result is the top of the bucket, limited to the largest value
+ * actually seen, so it is never an under-estimate.
+ * Returns -1 if not calculable (i.e. too many overflows). */
+int64_t hist_percentile(hist_t *hist, double percentile)
+{
+  int i;
+  uint64_t needed_samples = (uint64_t)((double)hist->num_samples * percentile / 100.0);
+  uint64_t found_samples = 0;
+
+  if (hist->num_samples == 0) {
+    return -1;
+  }
+  if (needed_samples >= hist->num_samples) {
+    needed_samples = hist->num_samples - 1;
+  }
+
+  for (i = 0; i < hist->num_buckets; i++) {
+    found_samples += hist->buckets[i];
+    if (found_samples > needed_samples) {
+      uint64_t top = hist_bucket_top(hist, i);
+      if (top > hist->max_sample) {
+        top = hist->max_sample;
+      }
+      return (int64_t)top;
+    }
+  }
+
+  return -1;
+}  /* hist_percentile */
+
+
+void hist_print(hist_t *hist)
+{
+  int i;
+  /* Only print non-empty buckets, as "bucket_top_ns,count". */
+  for (i = 0; i < hist->num_buckets; i++) {
+    if (hist->buckets[i] > 0) {
+      printf("%"PRIu64",%"PRIu64"\n", hist_bucket_top(hist, i), hist->buckets[i]);
+    }
+  }
+  printf("hist_sig_digits=%d, hist_max_ns=%"PRIu64", hist_overflows=%"PRIu64", hist_min_sample=%"PRIu64", hist_max_sample=%"PRIu64",\n",
+      hist->sig_digits, hist->max_ns, hist->overflows,
+      (hist->num_samples > 0) ? hist->min_sample : 0, hist->max_sample);
+  uint64_t average_sample = 0;
+  if (hist->num_samples > 0) {
+    average_sample = hist->sample_sum / hist->num_samples;
+  }
+  printf("hist_num_samples=%"PRIu64", average_sample=%"PRIu64",\n",
+      hist->num_samples, average_sample);
+
+  printf("Percentiles: 90=%"PRId64", 99=%"PRId64", 99.9=%"PRId64", 99.99=%"PRId64", 99.999=%"PRId64", 99.9999=%"PRId64", 100=%"PRId64"\n",
+      hist_percentile(hist, 90.0), hist_percentile(hist, 99.0),
+      hist_percentile(hist, 99.9), hist_percentile(hist, 99.99),
+      hist_percentile(hist, 99.999), hist_percentile(hist, 99.9999),
+      hist_percentile(hist, 100.0));
+}  /* hist_print */
+
+
+/* Print the percentiles of several histograms side by side, one line per
+ * percentile. Each line starts with "label" and has one "name=ns" value per
+ * histogram, e.g. "CO: percentile=99, service_ns=25000, response_ns=31000, ". */
+void hist_print_compare(char *label, int num_hists, hist_t **hists, char **names)
+{
+  static double percentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99, 99.999, 99.9999, 100.0 };
+  int p, h;
+
+  printf("%s percentile=average", label);
+  for (h = 0; h < num_hists; h++) {
+    uint64_t average_sample = 0;
+    if (hists[h]->num_samples > 0) {
+      average_sample = hists[h]->sample_sum / hists[h]->num_samples;
+    }
+    printf(", %s=%"PRIu64, names[h], average_sample);
+  }
+  printf(", \n");
+
+  for (p = 0; p < sizeof(percentiles) / sizeof(percentiles[0]); p++) {
+    printf("%s percentile=%g", label, percentiles[p]);
+    for (h = 0; h < num_hists; h++) {
+      printf(", %s=%"PRId64, names[h], hist_percentile(hists[h], percentiles[p]));
+    }
+    printf(", \n");
+  }
+}  /* hist_print_compare */
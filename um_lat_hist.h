@@ -0,0 +1,69 @@
+/* um_lat_hist.h - log-linear latency histogram shared by the um_lat tools.
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#ifndef UM_LAT_HIST_H
+#define UM_LAT_HIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+
+/* Log-linear ("HDR"-style) histogram. Values from 0 to (at least)
+ * hist_max_ns are recorded with "sig_digits" decimal digits of precision.
+ * The buckets are grouped in powers of two; each group has the same number
+ * of linear sub-buckets, so the bucket width grows with the value.
+ * For example, "-H 2,60" records 1 ns to 60 seconds with 1% precision
+ * in 30 KB.
+ */
+struct hist_s {
+  uint64_t *buckets;
+  int num_buckets;
+  int sig_digits;
+  uint64_t max_ns;
+  int sub_bucket_half_count_magnitude;
+  int sub_bucket_half_count;
+  uint64_t sub_bucket_mask;
+
+  uint64_t min_sample;
+  uint64_t max_sample;
+  uint64_t overflows;  /* Number of values above the last bucket. */
+  uint64_t num_samples;
+  uint64_t sample_sum;
+};
+typedef struct hist_s hist_t;
+
+hist_t *hist_create(int sig_digits, uint64_t max_ns);
+void hist_delete(hist_t *hist);
+void hist_init(hist_t *hist);
+void hist_input(hist_t *hist, uint64_t in_sample);
+int64_t hist_percentile(hist_t *hist, double percentile);
+void hist_merge(hist_t *dst, hist_t *src);
+void hist_print(hist_t *hist);
+void hist_print_compare(char *label, int num_hists, hist_t **hists, char **names);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  /* UM_LAT_HIST_H */
@@ -20,6 +20,8 @@
   THE LIKELIHOOD OF SUCH DAMAGES.
 */
 
+/* This is needed for sendmmsg() and recvmmsg(). */
+#define _GNU_SOURCE
 #include "cprt.h"
 #include <stdio.h>
 #include <string.h>
@@ -33,21 +35,104 @@
 #endif
 
 #include "um_lat.h"
+#include "um_lat_hist.h"
+#include "um_lat_proc.h"
+#include "um_lat_uring.h"
 
 
 /* Command-line options and their defaults */
+static int o_all_cpus = 0;  /* -A */
 static int o_affinity_cpu = -1;
+static int o_max_batch = 0;  /* -B */
+static int o_sqpoll_cpu = -1;  /* -Q */
+static int o_gap_ns = 1000;  /* -G */
 static char *o_group = NULL;
 static char *o_histogram = NULL;  /* -H */
 static char *o_interface = NULL;
+static int o_max_gaps = 0;  /* -R */
+static int o_rate = 100000;  /* -r */
+static int o_uring = 0;  /* -u */
+static char *o_msg_sizes = NULL;  /* -S */
+static char *o_time_source = NULL;  /* -t */
 
 /* Parameters parsed out from command-line options. */
-int hist_num_buckets;
-int hist_ns_per_bucket;
+int hist_sig_digits;
+int hist_max_sec;
+int use_tsc = 0;
 struct in_addr iface_in;
 struct in_addr group_in;
-
-char usage_str[] = "Usage: um_lat_jitter [-h] [-g group] [-a affinity_cpu] [-H hist_num_buckets,hist_ns_per_bucket] [-i interface]";
+hist_t *jitter_hist = NULL;
+#define MAX_SIZES 16
+int msg_sizes[MAX_SIZES];  /* -S */
+int num_sizes = 0;
+
+/* With -B, the sendmmsg()/recvmmsg() test (and with -u, the same test with
+ * io_uring). Each message carries the time it was produced and the test
+ * phase it belongs to. The receiver accounts each batch to the phase of
+ * its first message. */
+#define MAX_BATCH 1024
+#define BATCH_MSG_LEN 64
+#define BATCH_PORT 12001
+#define MAX_PHASES 64
+#define STOP_PHASE -1  /* Tells the receive thread to exit. */
+enum batch_engine_enum {
+  ENGINE_MMSG,  /* sendmmsg() and recvmmsg(). */
+  ENGINE_URING  /* io_uring WRITE_FIXED and READ_FIXED. */
+};
+struct batch_msg_s {
+  struct timespec produce_ts;
+  int phase;
+};
+struct phase_s {
+  int batch;
+  uint64_t num_sent;
+  uint64_t num_rcv;
+  uint64_t send_ns;  /* Sender's elapsed time. */
+  uint64_t send_cpu_ns;  /* Sender's CPU time. */
+  uint64_t rcv_cpu_ns;  /* Receiver's CPU time. */
+  hist_t *latency_hist;  /* Produced to received (latency phases). */
+};
+struct phase_s phases[MAX_PHASES];
+int cur_batch = 1;  /* Receiver's batch size. */
+int rcv_done = 0;
+uring_t *send_uring = NULL;
+
+/* With -R, each gap of at least o_gap_ns is recorded in its CPU's ring
+ * (the most recent o_max_gaps are kept). */
+struct gap_s {
+  uint64_t start_ns;  /* Since test_start_ts. */
+  uint64_t duration_ns;
+  int cpu;
+};
+
+/* One per CPU measured. With -A, each runs jitter_loop() in its own thread
+ * at the same time as the others. */
+#define MAX_CORES 1024
+struct core_s {
+  int cpu;
+  CPRT_THREAD_T thread_id;
+  hist_t *hist;
+  uint64_t ts_min_ns;
+  uint64_t ts_max_ns;
+  uint64_t num_gaps;  /* Timestamp gaps of at least o_gap_ns. */
+  uint64_t duration_ns;
+  struct gap_s *gaps;  /* Ring of o_max_gaps (-R), or NULL. */
+  /* With -S, the duration of each sendmsg() call, per message size. */
+  hist_t *send_hists[MAX_SIZES];
+  uint64_t num_sends[MAX_SIZES];
+};
+struct core_s cores[MAX_CORES];
+int num_cores = 0;
+int cores_ready = 0;  /* Core threads pinned and waiting to start. */
+int cores_go = 0;
+struct timespec test_start_ts;
+
+/* Snapshots taken before the test (-R). */
+proc_counts_t *irq_before = NULL;
+proc_counts_t *softirq_before = NULL;
+proc_schedstat_t *sched_before = NULL;
+
+char usage_str[] = "Usage: um_lat_jitter [-h] [-A] [-B max_batch] [-g group] [-a affinity_cpu] [-G gap_ns] [-H hist_sig_digits,hist_max_sec] [-i interface] [-Q sqpoll_cpu] [-R max_gaps] [-r rate] [-S msg_sizes] [-t time_source] [-u]";
 
 void usage(char *msg) {
   if (msg) fprintf(stderr, "%s\n", msg);
@@ -59,11 +144,20 @@ void help() {
   fprintf(stderr, "%s\n", usage_str);
   fprintf(stderr, "where:\n"
       "  -h : print help\n"
+      "  -A : measure all allowed CPUs at once, one pinned thread each\n"
       "  -a affinity_cpu : bitmap for CPU affinity for send thread [%d]\n"
+      "  -B max_batch : sendmmsg()/recvmmsg() test, batch sizes 1,2,4..max_batch [%d]\n"
+      "  -G gap_ns : timestamp gaps of at least this are counted as interruptions [%d]\n"
       "  -g group : multicast group address [%s]\n"
-      "  -H hist_num_buckets,hist_ns_per_bucket : send time histogram [%s]\n"
+      "  -H hist_sig_digits,hist_max_sec : timestamp gap histogram [%s]\n"
       "  -i interface : interface for multicast bind [%s]\n"
-      , o_affinity_cpu, o_group, o_histogram, o_interface
+      "  -Q sqpoll_cpu : with -u, CPU for the kernel's SQ polling thread (-1=none) [%d]\n"
+      "  -R max_gaps : record the last max_gaps gaps per CPU, with /proc snapshots [%d]\n"
+      "  -r rate : messages per second for the -B latency test [%d]\n"
+      "  -S msg_sizes : comma-separated message sizes to time each sendmsg() [%s]\n"
+      "  -t time_source : '' (empty)=CLOCK_MONOTONIC, 't'=invariant TSC [%s]\n"
+      "  -u : with -B, also test io_uring\n"
+      , o_affinity_cpu, o_max_batch, o_gap_ns, o_group, o_histogram, o_interface, o_sqpoll_cpu, o_max_gaps, o_rate, o_msg_sizes, o_time_source
   );
   exit(0);
 }
@@ -75,37 +169,84 @@ void get_my_opts(int argc, char **argv)
 
   /* Set defaults for string options. */
   o_group = CPRT_STRDUP("");
-  o_histogram = CPRT_STRDUP("0,0");
+  o_histogram = CPRT_STRDUP("2,60");
   o_interface = CPRT_STRDUP("");
+  o_msg_sizes = CPRT_STRDUP("");
+  o_time_source = CPRT_STRDUP("");
 
-  while ((opt = cprt_getopt(argc, argv, "ha:g:H:i:")) != EOF) {
+  while ((opt = cprt_getopt(argc, argv, "hAa:B:G:g:H:i:Q:R:r:S:t:u")) != EOF) {
     switch (opt) {
       case 'h': help(); break;
+      case 'A': o_all_cpus = 1; break;
       case 'a': CPRT_ATOI(cprt_optarg, o_affinity_cpu); break;
+      case 'B': CPRT_ATOI(cprt_optarg, o_max_batch); break;
+      case 'G': CPRT_ATOI(cprt_optarg, o_gap_ns); break;
       case 'g': free(o_group); o_group = CPRT_STRDUP(cprt_optarg); break;
       case 'H': free(o_histogram); o_histogram = CPRT_STRDUP(cprt_optarg); break;
       case 'i': free(o_interface); o_interface = CPRT_STRDUP(cprt_optarg); break;
+      case 'Q': CPRT_ATOI(cprt_optarg, o_sqpoll_cpu); break;
+      case 'R': CPRT_ATOI(cprt_optarg, o_max_gaps); break;
+      case 'r': CPRT_ATOI(cprt_optarg, o_rate); break;
+      case 'S': free(o_msg_sizes); o_msg_sizes = CPRT_STRDUP(cprt_optarg); break;
+      case 't': free(o_time_source); o_time_source = CPRT_STRDUP(cprt_optarg); break;
+      case 'u': o_uring = 1; break;
       default: usage(NULL);
     }  /* switch opt */
   }  /* while getopt */
 
   char *strtok_context;
 
-  /* Parse the histogram option: "hist_num_buckets,hist_ns_per_bucket". */
+  /* Parse the histogram option: "hist_sig_digits,hist_max_sec". */
   char *work_str = CPRT_STRDUP(o_histogram);
-  char *hist_num_buckets_str = CPRT_STRTOK(work_str, ",", &strtok_context);
-  ASSRT(hist_num_buckets_str != NULL);
-  CPRT_ATOI(hist_num_buckets_str, hist_num_buckets);
+  char *hist_sig_digits_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+  ASSRT(hist_sig_digits_str != NULL);
+  CPRT_ATOI(hist_sig_digits_str, hist_sig_digits);
 
-  char *hist_ns_per_bucket_str = CPRT_STRTOK(NULL, ",", &strtok_context);
-  ASSRT(hist_ns_per_bucket_str != NULL);
-  CPRT_ATOI(hist_ns_per_bucket_str, hist_ns_per_bucket);
+  char *hist_max_sec_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+  ASSRT(hist_max_sec_str != NULL);
+  CPRT_ATOI(hist_max_sec_str, hist_max_sec);
 
   ASSRT(CPRT_STRTOK(NULL, ",", &strtok_context) == NULL);
   free(work_str);
   /* It doesn't make sense to not use histogram with a latency tool. */
-  ASSRT(hist_num_buckets > 0);
-  ASSRT(hist_ns_per_bucket > 0);
+  ASSRT(hist_sig_digits >= 1 && hist_sig_digits <= 5);
+  ASSRT(hist_max_sec > 0);
+  ASSRT(o_gap_ns > 0);
+  ASSRT(o_max_gaps >= 0);
+  if (o_all_cpus && o_affinity_cpu > -1) {
+    usage("-A and -a are mutually exclusive");
+  }
+  ASSRT(o_max_batch >= 0 && o_max_batch <= MAX_BATCH);
+  ASSRT(o_rate > 0);
+  if (o_all_cpus && o_max_batch > 0) {
+    usage("-A and -B are mutually exclusive");
+  }
+  if (o_uring && o_max_batch == 0) {
+    usage("-u requires -B");
+  }
+  if (o_sqpoll_cpu > -1 && ! o_uring) {
+    usage("-Q requires -u");
+  }
+  if (o_sqpoll_cpu > -1 && o_sqpoll_cpu == o_affinity_cpu) {
+    usage("-Q must be a different CPU than -a (the SQ polling thread busy-loops)");
+  }
+
+  /* Parse the message sizes option: "size,size,...". */
+  if (strlen(o_msg_sizes) > 0) {
+    if (o_all_cpus) {
+      usage("-A and -S are mutually exclusive");
+    }
+    work_str = CPRT_STRDUP(o_msg_sizes);
+    char *size_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+    while (size_str != NULL) {
+      ASSRT(num_sizes < MAX_SIZES);
+      CPRT_ATOI(size_str, msg_sizes[num_sizes]);
+      ASSRT(msg_sizes[num_sizes] > 0 && msg_sizes[num_sizes] <= 65507);
+      num_sizes++;
+      size_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+    }
+    free(work_str);
+  }
 
   /* Parse the group option. */
   ASSRT(strlen(o_group) > 0);
@@ -117,98 +258,20 @@ void get_my_opts(int argc, char **argv)
   memset((char *)&iface_in, 0, sizeof(iface_in));
   ASSRT(inet_aton(o_interface, &iface_in) != 0);
 
-  if (cprt_optind != argc) { usage("Unexpected positional parameter(s)"); }
-}  /* get_my_opts */
-
-
-/* Histogram. */
-uint64_t *hist_buckets = NULL;
-uint64_t hist_min_sample = 999999999;
-uint64_t hist_max_sample = 0;
-int hist_overflows = 0;  /* Number of values above the last bucket. */
-int hist_num_samples = 0;
-uint64_t hist_sample_sum = 0;
-
-void hist_init()
-{
-  /* Re-initialize the data. */
-  hist_min_sample = 999999999;
-  hist_max_sample = 0;
-  hist_overflows = 0;  /* Number of values above the last bucket. */
-  hist_num_samples = 0;
-  hist_sample_sum = 0;
-
-  /* Init histogram (also makes sure it is mapped to physical memory. */
-  int i;
-  for (i = 0; i < hist_num_buckets; i++) {
-    hist_buckets[i] = 0;
+  /* Parse the time source option. */
+  if (strcasecmp(o_time_source, "t") == 0) {
+    use_tsc = 1;
+  } else if (strcasecmp(o_time_source, "") != 0) {
+    usage("-t value must be '' or 't'");
   }
-}  /* hist_init */
-
-void hist_create()
-{
-  hist_buckets = (uint64_t *)malloc(hist_num_buckets * sizeof(uint64_t));
-
-  hist_init();
-}  /* hist_create */
-
-void hist_input(uint64_t in_sample)
-{
-  ASSRT(hist_buckets != NULL);
-
-  hist_num_samples++;
-  hist_sample_sum += in_sample;
-
-  if (in_sample > hist_max_sample) {
-    hist_max_sample = in_sample;
-  }
-  if (in_sample < hist_min_sample) {
-    hist_min_sample = in_sample;
+  /* The first TSC selection calibrates it (about 50 ms) if it is invariant. */
+  if (use_tsc && ! cprt_tsc_select(1)) {
+    printf("WARNING: TSC is not invariant, using CLOCK_MONOTONIC\n");
+    use_tsc = 0;
   }
 
-  uint64_t bucket = in_sample / hist_ns_per_bucket;
-  if (bucket >= hist_num_buckets) {
-    hist_overflows++;
-  }
-  else {
-    hist_buckets[bucket]++;
-  }
-}  /* hist_input */
-
-/* Get the latency (in ns) which "percentile" percent of samples are below.
- * Returns -1 if not calculable (i.e. too many overflows). */
-int hist_percentile(double percentile)
-{
-  int i;
-  int needed_samples = (int)((double)hist_num_samples * percentile / 100.0);
-  int found_samples = 0;
-
-  for (i = 0; i < hist_num_buckets; i++) {
-    found_samples += hist_buckets[i];
-    if (found_samples > needed_samples) {
-      return (i+1) * hist_ns_per_bucket;
-    }
-  }
-
-  return -1.0;
-}  /* hist_percentile */
-
-void hist_print()
-{
-  int i;
-  for (i = 0; i < hist_num_buckets; i++) {
-    printf("%"PRIu64"\n", hist_buckets[i]);
-  }
-  printf("o_histogram=%s, hist_overflows=%d, hist_min_sample=%"PRIu64", hist_max_sample=%"PRIu64",\n",
-      o_histogram, hist_overflows, hist_min_sample, hist_max_sample);
-  uint64_t average_sample = hist_sample_sum / (uint64_t)hist_num_samples;
-  printf("hist_num_samples=%d, average_sample=%d,\n",
-      hist_num_samples, (int)average_sample);
-
-  printf("Percentiles: 90=%d, 99=%d, 99.9=%d, 99.99=%d, 99.999=%d\n",
-      hist_percentile(90.0), hist_percentile(99.0), hist_percentile(99.9),
-      hist_percentile(99.99), hist_percentile(99.999));
-}  /* hist_print */
+  if (cprt_optind != argc) { usage("Unexpected positional parameter(s)"); }
+}  /* get_my_opts */
 
 
 void init_sock(int sock)
@@ -223,10 +286,11 @@ void init_sock(int sock)
 
 
 /* Measure the minimum and maximum duration of a timestamp. */
-void jitter_loop()
+void jitter_loop(struct core_s *core)
 {
   uint64_t ts_min_ns = 999999999;
   uint64_t ts_max_ns = 0;
+  uint64_t num_gaps = 0;
   struct timespec ts1;
   struct timespec ts2;
 
@@ -248,26 +312,236 @@ void jitter_loop()
     CPRT_GETTIME(&ts2);
 
     CPRT_DIFF_TS(ts_this_ns, ts2, ts1);
-    hist_input((int)ts_this_ns);
+    hist_input(core->hist, ts_this_ns);
     /* Track maximum and minimum. */
     if (ts_this_ns < ts_min_ns) ts_min_ns = ts_this_ns;
     if (ts_this_ns > ts_max_ns) ts_max_ns = ts_this_ns;
+    if (ts_this_ns >= o_gap_ns) {
+      if (core->gaps != NULL) {
+        struct gap_s *gap = &core->gaps[num_gaps % o_max_gaps];
+        CPRT_DIFF_TS(gap->start_ns, ts1, test_start_ts);
+        gap->duration_ns = ts_this_ns;
+        gap->cpu = core->cpu;
+      }
+      num_gaps++;
+    }
 
     CPRT_DIFF_TS(ts_this_ns, ts2, start_ts);
   }
 
-  hist_print();
-  printf("ts_min_ns=%"PRIu64", ts_max_ns=%"PRIu64", \n",
-      ts_min_ns, ts_max_ns);
+  core->ts_min_ns = ts_min_ns;
+  core->ts_max_ns = ts_max_ns;
+  core->num_gaps = num_gaps;
+  core->duration_ns = ts_this_ns;
 }  /* jitter_loop */
 
 
-/* Return number of sock writes accomplished. */
-uint64_t sock_loop(int sock, uint64_t duration_ns)
+void core_print(struct core_s *core)
+{
+  printf("cpu=%d, num_samples=%"PRIu64", ts_min_ns=%"PRIu64", ts_max_ns=%"PRIu64", num_gaps=%"PRIu64", gaps_per_sec=%.1f, \n",
+      core->cpu, core->hist->num_samples, core->ts_min_ns, core->ts_max_ns,
+      core->num_gaps, (double)core->num_gaps * 1000000000.0 / (double)core->duration_ns);
+}  /* core_print */
+
+
+/* Allocate (and touch) the gap ring before the test. */
+void core_gaps_init(struct core_s *core)
+{
+  if (o_max_gaps > 0) {
+    core->gaps = (struct gap_s *)malloc(o_max_gaps * sizeof(struct gap_s));
+    ASSRT(core->gaps != NULL);
+    memset(core->gaps, 0, o_max_gaps * sizeof(struct gap_s));
+  }
+}  /* core_gaps_init */
+
+
+/* Take the "before" snapshots (-R), then mark the start of the test. */
+void timeline_start()
+{
+  if (o_max_gaps > 0) {
+    irq_before = proc_counts_read("/proc/interrupts");
+    softirq_before = proc_counts_read("/proc/softirqs");
+    sched_before = proc_schedstat_read();
+  }
+  CPRT_GETTIME(&test_start_ts);
+}  /* timeline_start */
+
+
+static int gap_compare(const void *a, const void *b)
+{
+  const struct gap_s *gap_a = (const struct gap_s *)a;
+  const struct gap_s *gap_b = (const struct gap_s *)b;
+  if (gap_a->start_ns < gap_b->start_ns) return -1;
+  if (gap_a->start_ns > gap_b->start_ns) return 1;
+  return 0;
+}  /* gap_compare */
+
+
+/* Print the recorded gaps of all CPUs in time order, then what the kernel
+ * counted on each CPU during the test: interrupts (by IRQ line, including
+ * "LOC" timer ticks), softirqs (by type), and scheduler activity. */
+void timeline_print()
+{
+  proc_counts_t *irq_after = proc_counts_read("/proc/interrupts");
+  proc_counts_t *softirq_after = proc_counts_read("/proc/softirqs");
+  proc_schedstat_t *sched_after = proc_schedstat_read();
+  int i;
+
+  uint64_t num_recorded = 0;
+  for (i = 0; i < num_cores; i++) {
+    num_recorded += (cores[i].num_gaps < o_max_gaps) ? cores[i].num_gaps : o_max_gaps;
+  }
+  struct gap_s *gaps = (struct gap_s *)malloc((num_recorded + 1) * sizeof(struct gap_s));
+  ASSRT(gaps != NULL);
+  uint64_t g = 0;
+  for (i = 0; i < num_cores; i++) {
+    uint64_t n = (cores[i].num_gaps < o_max_gaps) ? cores[i].num_gaps : o_max_gaps;
+    memcpy(&gaps[g], cores[i].gaps, n * sizeof(struct gap_s));
+    g += n;
+    if (cores[i].num_gaps > o_max_gaps) {
+      printf("Gaps: cpu=%d, num_gaps=%"PRIu64", num_dropped=%"PRIu64", \n",
+          cores[i].cpu, cores[i].num_gaps, cores[i].num_gaps - o_max_gaps);
+    }
+  }
+  qsort(gaps, num_recorded, sizeof(struct gap_s), gap_compare);
+  for (g = 0; g < num_recorded; g++) {
+    printf("Gap: start_ns=%"PRIu64", cpu=%d, duration_ns=%"PRIu64", \n",
+        gaps[g].start_ns, gaps[g].cpu, gaps[g].duration_ns);
+  }
+  free(gaps);
+
+  if (irq_before == NULL || irq_after == NULL) {
+    printf("WARNING: could not read /proc/interrupts\n");
+  }
+  if (softirq_before == NULL || softirq_after == NULL) {
+    printf("WARNING: could not read /proc/softirqs\n");
+  }
+  if (sched_before == NULL || sched_after == NULL) {
+    printf("WARNING: could not read /proc/schedstat\n");
+  }
+  for (i = 0; i < num_cores; i++) {
+    if (irq_before != NULL && irq_after != NULL) {
+      proc_counts_print_delta("Irq:", irq_before, irq_after, cores[i].cpu);
+    }
+    if (softirq_before != NULL && softirq_after != NULL) {
+      proc_counts_print_delta("Softirq:", softirq_before, softirq_after, cores[i].cpu);
+    }
+    if (sched_before != NULL && sched_after != NULL) {
+      proc_schedstat_print_delta(sched_before, sched_after, cores[i].cpu);
+    }
+  }
+
+  if (irq_before != NULL) proc_counts_delete(irq_before);
+  if (irq_after != NULL) proc_counts_delete(irq_after);
+  if (softirq_before != NULL) proc_counts_delete(softirq_before);
+  if (softirq_after != NULL) proc_counts_delete(softirq_after);
+  if (sched_before != NULL) proc_schedstat_delete(sched_before);
+  if (sched_after != NULL) proc_schedstat_delete(sched_after);
+}  /* timeline_print */
+
+
+static CPRT_THREAD_ENTRYPOINT core_thread(void *in_arg)
+{
+  struct core_s *core = (struct core_s *)in_arg;
+
+  cprt_set_affinity_cpu(core->cpu);
+  /* Create the histogram after pinning so it is local to the CPU. */
+  core->hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  core_gaps_init(core);
+
+  /* Start all the CPUs together. */
+  __atomic_add_fetch(&cores_ready, 1, __ATOMIC_RELEASE);
+  while (! __atomic_load_n(&cores_go, __ATOMIC_ACQUIRE)) {
+    CPRT_CPU_PAUSE();
+  }
+
+  jitter_loop(core);
+
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* core_thread */
+
+
+/* Run jitter_loop() on every allowed CPU at the same time. */
+void all_cpus_loop()
+{
+  int cpus[MAX_CORES];
+  char *names[MAX_CORES];
+  hist_t *hists[MAX_CORES];
+  int i;
+
+  num_cores = cprt_allowed_cpus(cpus, MAX_CORES);
+  ASSRT(num_cores > 0);
+  printf("num_cores=%d, \n", num_cores);
+  fflush(stdout);
+
+  for (i = 0; i < num_cores; i++) {
+    cores[i].cpu = cpus[i];
+    CPRT_THREAD_CREATE(cores[i].thread_id, core_thread, &cores[i]);
+  }
+  while (__atomic_load_n(&cores_ready, __ATOMIC_ACQUIRE) < num_cores) {
+    CPRT_SLEEP_MS(1);
+  }
+  timeline_start();
+  __atomic_store_n(&cores_go, 1, __ATOMIC_RELEASE);
+  for (i = 0; i < num_cores; i++) {
+    CPRT_THREAD_JOIN(cores[i].thread_id);
+  }
+
+  /* Per-core report, then all the cores' samples together. */
+  for (i = 0; i < num_cores; i++) {
+    core_print(&cores[i]);
+  }
+  for (i = 0; i < num_cores; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "cpu%d", cores[i].cpu);
+    names[i] = CPRT_STRDUP(name);
+    hists[i] = cores[i].hist;
+    hist_merge(jitter_hist, cores[i].hist);
+  }
+  hist_print_compare("Cores:", num_cores, hists, names);
+  hist_print(jitter_hist);
+
+  if (o_max_gaps > 0) {
+    timeline_print();
+  }
+
+  for (i = 0; i < num_cores; i++) {
+    free(names[i]);
+    hist_delete(cores[i].hist);
+    free(cores[i].gaps);
+  }
+}  /* all_cpus_loop */
+
+
+/* Run jitter_loop() on this thread's CPU, cores[0].cpu. */
+void single_cpu_loop()
+{
+  num_cores = 1;
+  cores[0].hist = jitter_hist;
+  core_gaps_init(&cores[0]);
+
+  timeline_start();
+  jitter_loop(&cores[0]);
+
+  hist_print(jitter_hist);
+  core_print(&cores[0]);
+  if (o_max_gaps > 0) {
+    timeline_print();
+  }
+  free(cores[0].gaps);
+}  /* single_cpu_loop */
+
+
+/* Return number of sock writes accomplished. If "hist" is not NULL, each
+ * sendmsg() call is timed and recorded in it (including the cost of one
+ * timestamp). */
+uint64_t sock_loop(int sock, uint64_t duration_ns, char *buf, int len, hist_t *hist)
 {
   struct sockaddr_in dest_sin;
   struct msghdr message_hdr;
   struct iovec message_iov;
+  struct timespec ts1;
   struct timespec ts2;
 
   /* Set up destination group:port. */
@@ -277,8 +551,8 @@ uint64_t sock_loop(int sock, uint64_t duration_ns)
   dest_sin.sin_port = htons(12000);
 
   /* Set up outgoing message buffer. */
-  message_iov.iov_base = "um_lat_jitter";
-  message_iov.iov_len = strlen(message_iov.iov_base);
+  message_iov.iov_base = buf;
+  message_iov.iov_len = len;
 
   /* Set up call to sendmsg(). */
   message_hdr.msg_name = &dest_sin;
@@ -298,20 +572,517 @@ uint64_t sock_loop(int sock, uint64_t duration_ns)
 
   uint64_t ts_this_ns = 0;
   uint64_t num_sends = 0;
-  /* Loop for 2 seconds. */
-  while (ts_this_ns < duration_ns) {
-    CPRT_EM1(sendmsg(sock, &message_hdr, 0));
-    CPRT_EM1(sendmsg(sock, &message_hdr, 0));
-    num_sends += 2;
-
+  if (hist == NULL) {
+    while (ts_this_ns < duration_ns) {
+      CPRT_EM1(sendmsg(sock, &message_hdr, 0));
+      CPRT_EM1(sendmsg(sock, &message_hdr, 0));
+      num_sends += 2;
+
+      CPRT_GETTIME(&ts2);
+      CPRT_DIFF_TS(ts_this_ns, ts2, start_ts);
+    }
+  }
+  else {
     CPRT_GETTIME(&ts2);
-    CPRT_DIFF_TS(ts_this_ns, ts2, start_ts);
+    while (ts_this_ns < duration_ns) {
+      ts1 = ts2;
+      CPRT_EM1(sendmsg(sock, &message_hdr, 0));
+      num_sends++;
+
+      CPRT_GETTIME(&ts2);
+      uint64_t send_ns;
+      CPRT_DIFF_TS(send_ns, ts2, ts1);
+      hist_input(hist, send_ns);
+      CPRT_DIFF_TS(ts_this_ns, ts2, start_ts);
+    }
   }
 
   return num_sends;
 }  /* sock_loop */
 
 
+/* CPU time used by the calling thread. */
+uint64_t thread_cpu_ns()
+{
+  struct timespec ts;
+  CPRT_EM1(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts));
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}  /* thread_cpu_ns */
+
+
+/* Account received messages to their phase. Returns 0 if told to stop. */
+int batch_rcv_msgs(struct batch_msg_s **msgs, int num_msgs, struct timespec rcv_ts,
+    uint64_t cpu_ns)
+{
+  int i;
+
+  if (num_msgs == 0) {
+    return 1;
+  }
+  if (msgs[0]->phase == STOP_PHASE) {
+    return 0;
+  }
+  ASSRT(msgs[0]->phase >= 0 && msgs[0]->phase < MAX_PHASES);
+  struct phase_s *phase = &phases[msgs[0]->phase];
+  phase->rcv_cpu_ns += cpu_ns;
+  phase->num_rcv += num_msgs;
+  if (phase->latency_hist != NULL) {
+    for (i = 0; i < num_msgs; i++) {
+      uint64_t latency_ns;
+      CPRT_DIFF_TS(latency_ns, rcv_ts, msgs[i]->produce_ts);
+      hist_input(phase->latency_hist, latency_ns);
+    }
+  }
+
+  return 1;
+}  /* batch_rcv_msgs */
+
+
+static CPRT_THREAD_ENTRYPOINT batch_mmsg_rcv_thread(void *in_arg)
+{
+  int sock = *(int *)in_arg;
+  struct mmsghdr *mmsgs = (struct mmsghdr *)malloc(o_max_batch * sizeof(struct mmsghdr));
+  struct iovec *iovs = (struct iovec *)malloc(o_max_batch * sizeof(struct iovec));
+  char *bufs = (char *)malloc(o_max_batch * BATCH_MSG_LEN);
+  ASSRT(mmsgs != NULL && iovs != NULL && bufs != NULL);
+  memset(mmsgs, 0, o_max_batch * sizeof(struct mmsghdr));
+  struct batch_msg_s *msgs[MAX_BATCH];
+  int i;
+  for (i = 0; i < o_max_batch; i++) {
+    iovs[i].iov_base = &bufs[i * BATCH_MSG_LEN];
+    iovs[i].iov_len = BATCH_MSG_LEN;
+    mmsgs[i].msg_hdr.msg_iov = &iovs[i];
+    mmsgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i] = (struct batch_msg_s *)iovs[i].iov_base;
+  }
+
+  uint64_t last_cpu_ns = thread_cpu_ns();
+  int running = 1;
+  while (running) {
+    int batch = __atomic_load_n(&cur_batch, __ATOMIC_ACQUIRE);
+    /* Wait for at least one, then take what is there (up to batch). */
+    int num_rcv = recvmmsg(sock, mmsgs, batch, MSG_WAITFORONE, NULL);
+    if (num_rcv == -1) {
+      ASSRT(errno == EINTR);
+      continue;
+    }
+    struct timespec rcv_ts;
+    CPRT_GETTIME(&rcv_ts);
+    uint64_t cpu_ns = thread_cpu_ns();
+
+    running = batch_rcv_msgs(msgs, num_rcv, rcv_ts, cpu_ns - last_cpu_ns);
+    last_cpu_ns = cpu_ns;
+  }
+  __atomic_store_n(&rcv_done, 1, __ATOMIC_RELEASE);
+
+  free(mmsgs);
+  free(iovs);
+  free(bufs);
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* batch_mmsg_rcv_thread */
+
+
+/* Queue a read of one datagram into buffer "slot" (a registered buffer). */
+void batch_uring_read(uring_t *ring, int sock, char *bufs, int slot)
+{
+  struct io_uring_sqe *sqe = uring_get_sqe(ring);
+  ASSRT(sqe != NULL);
+  sqe->opcode = IORING_OP_READ_FIXED;
+  sqe->fd = sock;
+  sqe->addr = (uint64_t)(uintptr_t)&bufs[slot * BATCH_MSG_LEN];
+  sqe->len = BATCH_MSG_LEN;
+  sqe->buf_index = 0;
+  sqe->user_data = slot;
+}  /* batch_uring_read */
+
+
+/* Keep "batch" reads outstanding; each wait collects all that completed
+ * and re-queues them, to be submitted with the next wait. */
+static CPRT_THREAD_ENTRYPOINT batch_uring_rcv_thread(void *in_arg)
+{
+  int sock = *(int *)in_arg;
+  char *bufs = (char *)malloc(o_max_batch * BATCH_MSG_LEN);
+  ASSRT(bufs != NULL);
+  memset(bufs, 0, o_max_batch * BATCH_MSG_LEN);
+  struct batch_msg_s *msgs[MAX_BATCH];
+  int slots[MAX_BATCH];
+
+  /* With -Q, share the sender's SQ polling thread. */
+  uring_t *ring = uring_create(o_max_batch, o_sqpoll_cpu, (o_sqpoll_cpu > -1) ? send_uring : NULL);
+  uring_register_buffer(ring, bufs, o_max_batch * BATCH_MSG_LEN);
+
+  int num_outstanding = 0;
+  uint64_t last_cpu_ns = thread_cpu_ns();
+  int running = 1;
+  while (running) {
+    /* The batch size only grows during a test. */
+    int batch = __atomic_load_n(&cur_batch, __ATOMIC_ACQUIRE);
+    while (num_outstanding < batch) {
+      batch_uring_read(ring, sock, bufs, num_outstanding);
+      num_outstanding++;
+    }
+    uring_submit(ring, 1);
+    struct timespec rcv_ts;
+    CPRT_GETTIME(&rcv_ts);
+    uint64_t cpu_ns = thread_cpu_ns();
+
+    int num_rcv = 0;
+    struct io_uring_cqe *cqe;
+    while ((cqe = uring_peek_cqe(ring)) != NULL) {
+      int slot = (int)cqe->user_data;
+      if (cqe->res < 0) {
+        errno = -cqe->res;
+        CPRT_PERRNO("io_uring READ_FIXED");
+        CPRT_ERR_EXIT;
+      }
+      uring_cqe_seen(ring);
+      slots[num_rcv] = slot;
+      msgs[num_rcv] = (struct batch_msg_s *)&bufs[slot * BATCH_MSG_LEN];
+      num_rcv++;
+    }
+
+    running = batch_rcv_msgs(msgs, num_rcv, rcv_ts, cpu_ns - last_cpu_ns);
+    last_cpu_ns = cpu_ns;
+    int i;
+    for (i = 0; i < num_rcv; i++) {
+      batch_uring_read(ring, sock, bufs, slots[i]);
+    }
+  }
+  __atomic_store_n(&rcv_done, 1, __ATOMIC_RELEASE);
+
+  uring_delete(ring);  /* Cancels the outstanding reads. */
+  free(bufs);
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* batch_uring_rcv_thread */
+
+
+/* Send one batch with io_uring: one WRITE_FIXED per message, submitted
+ * together, then wait for them all (the buffers are reused). Without SQ
+ * polling, submitting and waiting is one system call; with it, none. */
+void batch_uring_send(int sock, int batch, char *bufs)
+{
+  int i;
+
+  for (i = 0; i < batch; i++) {
+    struct io_uring_sqe *sqe = uring_get_sqe(send_uring);
+    ASSRT(sqe != NULL);
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = sock;
+    sqe->addr = (uint64_t)(uintptr_t)&bufs[i * BATCH_MSG_LEN];
+    sqe->len = BATCH_MSG_LEN;
+    sqe->buf_index = 0;
+    sqe->user_data = i;
+  }
+  uring_submit(send_uring, send_uring->sqpoll ? 0 : batch);
+
+  int num_done = 0;
+  while (num_done < batch) {
+    struct io_uring_cqe *cqe = uring_peek_cqe(send_uring);
+    if (cqe == NULL) {
+      CPRT_CPU_PAUSE();  /* SQ polling: the kernel thread is sending. */
+      continue;
+    }
+    if (cqe->res < 0) {
+      errno = -cqe->res;
+      CPRT_PERRNO("io_uring WRITE_FIXED");
+      CPRT_ERR_EXIT;
+    }
+    uring_cqe_seen(send_uring);
+    num_done++;
+  }
+}  /* batch_uring_send */
+
+
+/* Send messages "batch" at a time for 1 second. If "rate" is 0, send as
+ * fast as possible (throughput). Otherwise, produce messages at "rate" per
+ * second; each waits for its batch to fill before it is sent (latency). */
+void batch_send_loop(int sock, enum batch_engine_enum engine, int phase_num,
+    int batch, int rate, struct mmsghdr *mmsgs, char *bufs)
+{
+  struct phase_s *phase = &phases[phase_num];
+  struct timespec start_ts;
+  struct timespec cur_ts;
+  uint64_t elapsed_ns = 0;
+  uint64_t num_produced = 0;
+  int i;
+
+  for (i = 0; i < batch; i++) {
+    ((struct batch_msg_s *)&bufs[i * BATCH_MSG_LEN])->phase = phase_num;
+  }
+
+  uint64_t start_cpu_ns = thread_cpu_ns();
+  CPRT_GETTIME(&start_ts);
+  while (elapsed_ns < 1000000000) {
+    for (i = 0; i < batch; i++) {
+      if (rate > 0) {
+        /* Wait until this message is due. */
+        uint64_t due_ns = (num_produced * 1000000000ull) / rate;
+        do {
+          CPRT_GETTIME(&cur_ts);
+          CPRT_DIFF_TS(elapsed_ns, cur_ts, start_ts);
+        } while (elapsed_ns < due_ns);
+      }
+      CPRT_GETTIME(&((struct batch_msg_s *)&bufs[i * BATCH_MSG_LEN])->produce_ts);
+      num_produced++;
+    }
+    if (engine == ENGINE_URING) {
+      batch_uring_send(sock, batch, bufs);
+    }
+    else {
+      int num_sent = 0;
+      while (num_sent < batch) {
+        int n = sendmmsg(sock, &mmsgs[num_sent], batch - num_sent, 0);
+        CPRT_EM1(n);
+        num_sent += n;
+      }
+    }
+    phase->num_sent += batch;
+
+    CPRT_GETTIME(&cur_ts);
+    CPRT_DIFF_TS(elapsed_ns, cur_ts, start_ts);
+  }
+  phase->send_ns = elapsed_ns;
+  phase->send_cpu_ns = thread_cpu_ns() - start_cpu_ns;
+}  /* batch_send_loop */
+
+
+/* For each engine and batch size: a throughput phase and a latency phase
+ * (at -r). Phase number is ((engine * num_batches) + batch index) * 2,
+ * plus 1 for latency. */
+void batch_test()
+{
+  struct sockaddr_in dest_sin;
+  int batches[MAX_PHASES];
+  int num_batches = 0;
+  int num_engines = o_uring ? 2 : 1;
+  static char *engine_names[] = { "sendmmsg", "io_uring" };
+  static char *engine_short_names[] = { "mmsg", "uring" };
+  int b, e, i;
+
+  for (b = 1; b < o_max_batch; b *= 2) {
+    batches[num_batches++] = b;
+  }
+  batches[num_batches++] = o_max_batch;
+  ASSRT(num_engines * num_batches * 2 <= MAX_PHASES);
+
+  /* Receive socket, joined to the group if multicast. */
+  int rcv_sock = socket(PF_INET, SOCK_DGRAM, 0);
+  ASSRT(rcv_sock != -1);
+  int opt = 1;
+  CPRT_EOK0(setsockopt(rcv_sock, SOL_SOCKET, SO_REUSEADDR, (char *)&opt, sizeof(opt)));
+  opt = 8 * 1024 * 1024;
+  CPRT_EOK0(setsockopt(rcv_sock, SOL_SOCKET, SO_RCVBUF, (char *)&opt, sizeof(opt)));
+  struct sockaddr_in bind_sin;
+  memset(&bind_sin, 0, sizeof(bind_sin));
+  bind_sin.sin_family = AF_INET;
+  bind_sin.sin_addr.s_addr = htonl(INADDR_ANY);
+  bind_sin.sin_port = htons(BATCH_PORT);
+  CPRT_EOK0(bind(rcv_sock, (struct sockaddr *)&bind_sin, sizeof(bind_sin)));
+  if (IN_MULTICAST(ntohl(group_in.s_addr))) {
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = group_in;
+    mreq.imr_interface = iface_in;
+    CPRT_EOK0(setsockopt(rcv_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char *)&mreq, sizeof(mreq)));
+  }
+
+  /* Send socket, connected so that io_uring writes need no address. */
+  int send_sock = socket(PF_INET, SOCK_DGRAM, 0);
+  ASSRT(send_sock != -1);
+  init_sock(send_sock);
+  memset(&dest_sin, 0, sizeof(dest_sin));
+  dest_sin.sin_family = AF_INET;
+  dest_sin.sin_addr.s_addr = group_in.s_addr;
+  dest_sin.sin_port = htons(BATCH_PORT);
+  CPRT_EOK0(connect(send_sock, (struct sockaddr *)&dest_sin, sizeof(dest_sin)));
+
+  struct mmsghdr *mmsgs = (struct mmsghdr *)malloc(o_max_batch * sizeof(struct mmsghdr));
+  struct iovec *iovs = (struct iovec *)malloc(o_max_batch * sizeof(struct iovec));
+  char *bufs = (char *)malloc(o_max_batch * BATCH_MSG_LEN);
+  ASSRT(mmsgs != NULL && iovs != NULL && bufs != NULL);
+  memset(mmsgs, 0, o_max_batch * sizeof(struct mmsghdr));
+  memset(bufs, 0, o_max_batch * BATCH_MSG_LEN);
+  for (i = 0; i < o_max_batch; i++) {
+    iovs[i].iov_base = &bufs[i * BATCH_MSG_LEN];
+    iovs[i].iov_len = BATCH_MSG_LEN;
+    mmsgs[i].msg_hdr.msg_iov = &iovs[i];
+    mmsgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  if (o_uring) {
+    send_uring = uring_create(o_max_batch, o_sqpoll_cpu, NULL);
+    uring_register_buffer(send_uring, bufs, o_max_batch * BATCH_MSG_LEN);
+  }
+
+  memset(phases, 0, sizeof(phases));
+  for (i = 0; i < num_engines * num_batches; i++) {
+    phases[i * 2].batch = batches[i % num_batches];
+    phases[i * 2 + 1].batch = batches[i % num_batches];
+    phases[i * 2 + 1].latency_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  }
+
+  for (e = 0; e < num_engines; e++) {
+    CPRT_THREAD_T rcv_thread_id;
+    __atomic_store_n(&cur_batch, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&rcv_done, 0, __ATOMIC_RELEASE);
+    if (e == ENGINE_URING) {
+      CPRT_THREAD_CREATE(rcv_thread_id, batch_uring_rcv_thread, &rcv_sock);
+    }
+    else {
+      CPRT_THREAD_CREATE(rcv_thread_id, batch_mmsg_rcv_thread, &rcv_sock);
+    }
+    CPRT_SLEEP_MS(100);  /* Let the receiver get ready. */
+
+    for (b = 0; b < num_batches; b++) {
+      int phase_num = ((e * num_batches) + b) * 2;
+      __atomic_store_n(&cur_batch, batches[b], __ATOMIC_RELEASE);
+      batch_send_loop(send_sock, e, phase_num, batches[b], 0, mmsgs, bufs);
+      CPRT_SLEEP_MS(100);  /* Let the receiver drain. */
+      batch_send_loop(send_sock, e, phase_num + 1, batches[b], o_rate, mmsgs, bufs);
+      CPRT_SLEEP_MS(100);
+    }
+
+    /* Tell the receiver to exit (repeat in case of loss). */
+    struct batch_msg_s stop_msg;
+    memset(&stop_msg, 0, sizeof(stop_msg));
+    stop_msg.phase = STOP_PHASE;
+    while (! __atomic_load_n(&rcv_done, __ATOMIC_ACQUIRE)) {
+      CPRT_EM1(send(send_sock, &stop_msg, sizeof(stop_msg), 0));
+      CPRT_SLEEP_MS(10);
+    }
+    CPRT_THREAD_JOIN(rcv_thread_id);
+    /* Discard extra stop messages. */
+    char drain_buf[BATCH_MSG_LEN];
+    while (recv(rcv_sock, drain_buf, sizeof(drain_buf), MSG_DONTWAIT) > 0) {
+    }
+  }
+
+  /* Leave "comma space" at end of line to make parsing output easier. */
+  uint64_t base_latency_ns = 0;
+  char *names[MAX_PHASES];
+  hist_t *hists[MAX_PHASES];
+  for (i = 0; i < num_engines * num_batches; i++) {
+    struct phase_s *tput = &phases[i * 2];
+    struct phase_s *lat = &phases[i * 2 + 1];
+    e = i / num_batches;
+    uint64_t latency_ns = 0;
+    if (lat->latency_hist->num_samples > 0) {
+      latency_ns = lat->latency_hist->sample_sum / lat->latency_hist->num_samples;
+    }
+    if (i == 0) {
+      base_latency_ns = latency_ns;  /* sendmmsg with batch 1 (i.e. sendmsg). */
+    }
+    printf("Batch: engine=%s, batch=%d, send_pps=%.0f, rcv_pps=%.0f, num_lost=%"PRIu64", send_cpu_ns_per_msg=%.1f, rcv_cpu_ns_per_msg=%.1f, latency_avg_ns=%"PRIu64", added_latency_ns=%"PRId64", latency_num_lost=%"PRIu64", \n",
+        engine_names[e], tput->batch,
+        (double)tput->num_sent * 1000000000.0 / (double)tput->send_ns,
+        (double)tput->num_rcv * 1000000000.0 / (double)tput->send_ns,
+        tput->num_sent - tput->num_rcv,
+        (double)tput->send_cpu_ns / (double)tput->num_sent,
+        (tput->num_rcv > 0) ? (double)tput->rcv_cpu_ns / (double)tput->num_rcv : 0.0,
+        latency_ns, (int64_t)(latency_ns - base_latency_ns),
+        lat->num_sent - lat->num_rcv);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%s%d", engine_short_names[e], tput->batch);
+    names[i] = CPRT_STRDUP(name);
+    hists[i] = lat->latency_hist;
+  }
+  hist_print_compare("Batchlat:", num_engines * num_batches, hists, names);
+
+  for (i = 0; i < num_engines * num_batches; i++) {
+    free(names[i]);
+    hist_delete(phases[i * 2 + 1].latency_hist);
+  }
+  if (send_uring != NULL) {
+    uring_delete(send_uring);
+    send_uring = NULL;
+  }
+  free(mmsgs);
+  free(iovs);
+  free(bufs);
+  close(send_sock);
+  close(rcv_sock);
+}  /* batch_test */
+
+
+/* Time each sendmsg() for each -S message size on this thread's CPU. */
+void send_profile_loop(int sock, struct core_s *core)
+{
+  int max_size = 0;
+  int s;
+  for (s = 0; s < num_sizes; s++) {
+    if (msg_sizes[s] > max_size) max_size = msg_sizes[s];
+  }
+  char *buf = (char *)malloc(max_size);
+  ASSRT(buf != NULL);
+  memset(buf, 'x', max_size);
+
+  for (s = 0; s < num_sizes; s++) {
+    core->send_hists[s] = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+    sock_loop(sock, 20000000, buf, msg_sizes[s], NULL);  /* .02 sec "warmup". */
+    core->num_sends[s] = sock_loop(sock, 200000000, buf, msg_sizes[s], core->send_hists[s]);
+  }
+
+  free(buf);
+}  /* send_profile_loop */
+
+
+/* Print each CPU's sendmsg() times, then a table per message size with
+ * one column per CPU. Return the CPU with the lowest tail: the smallest
+ * 99.9th percentile, taking each CPU's worst message size. */
+int send_profile_print()
+{
+  char *names[MAX_CORES];
+  hist_t *hists[MAX_CORES];
+  int best_cpu = -1;
+  int64_t best_tail_ns = 0;
+  int i, s;
+
+  for (i = 0; i < num_cores; i++) {
+    struct core_s *core = &cores[i];
+    int64_t tail_ns = 0;
+    for (s = 0; s < num_sizes; s++) {
+      hist_t *hist = core->send_hists[s];
+      int64_t p999_ns = hist_percentile(hist, 99.9);
+      /* Leave "comma space" at end of line to make parsing output easier. */
+      printf("Sendmsg: cpu=%d, msg_len=%d, num_sends=%"PRIu64", average_ns=%"PRIu64", p99_ns=%"PRId64", p999_ns=%"PRId64", max_ns=%"PRIu64", \n",
+          core->cpu, msg_sizes[s], core->num_sends[s], hist->sample_sum / hist->num_samples,
+          hist_percentile(hist, 99.0), p999_ns, hist->max_sample);
+      if (p999_ns > tail_ns) tail_ns = p999_ns;
+    }
+    if (best_cpu == -1 || tail_ns < best_tail_ns) {
+      best_cpu = core->cpu;
+      best_tail_ns = tail_ns;
+    }
+  }
+
+  for (i = 0; i < num_cores; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "cpu%d", cores[i].cpu);
+    names[i] = CPRT_STRDUP(name);
+  }
+  for (s = 0; s < num_sizes; s++) {
+    char label[32];
+    snprintf(label, sizeof(label), "Sendmsg%d:", msg_sizes[s]);
+    for (i = 0; i < num_cores; i++) {
+      hists[i] = cores[i].send_hists[s];
+    }
+    hist_print_compare(label, num_cores, hists, names);
+  }
+  printf("best_cpu=%d, best_p999_ns=%"PRId64", \n", best_cpu, best_tail_ns);
+
+  for (i = 0; i < num_cores; i++) {
+    free(names[i]);
+    for (s = 0; s < num_sizes; s++) {
+      hist_delete(cores[i].send_hists[s]);
+      cores[i].send_hists[s] = NULL;
+    }
+  }
+
+  return best_cpu;
+}  /* send_profile_print */
+
+
 int main(int argc, char **argv)
 {
   int sock;
@@ -322,23 +1093,55 @@ int main(int argc, char **argv)
 
   get_my_opts(argc, argv);
 
-  if (hist_num_buckets > 0) {
-    hist_create();
-  }
+  jitter_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
 
   /* Leave "comma space" at end of line to make parsing output easier. */
-  printf("o_affinity_cpu=%d, o_histogram=%s, \n",
-      o_affinity_cpu, o_histogram);
+  printf("o_all_cpus=%d, o_affinity_cpu=%d, o_max_batch=%d, o_gap_ns=%d, o_histogram=%s, o_sqpoll_cpu=%d, o_max_gaps=%d, o_rate=%d, o_msg_sizes=%s, o_time_source='%s', o_uring=%d, use_tsc=%d, tsc_ghz=%f, \n",
+      o_all_cpus, o_affinity_cpu, o_max_batch, o_gap_ns, o_histogram, o_sqpoll_cpu, o_max_gaps, o_rate, o_msg_sizes, o_time_source, o_uring, use_tsc, cprt_tsc_ghz());
 
   sock = socket(PF_INET,SOCK_DGRAM,0);
   ASSRT(sock != -1);
   init_sock(sock);
 
-  if (o_affinity_cpu > -1) {
+  if (o_max_batch > 0) {
+    if (o_affinity_cpu > -1) {
+      CPRT_CPU_ZERO(&cpuset);
+      CPRT_CPU_SET(o_affinity_cpu, &cpuset);
+      cprt_set_affinity(cpuset);
+    }
+    batch_test();
+  }
+  else if (o_all_cpus) {
+    all_cpus_loop();
+  }
+  else if (o_affinity_cpu > -1) {
     CPRT_CPU_ZERO(&cpuset);
     CPRT_CPU_SET(o_affinity_cpu, &cpuset);
     cprt_set_affinity(cpuset);
-    jitter_loop();
+    cores[0].cpu = o_affinity_cpu;
+    if (num_sizes > 0) {
+      num_cores = 1;
+      send_profile_loop(sock, &cores[0]);
+      send_profile_print();
+    }
+    single_cpu_loop();
+  }
+  else if (num_sizes > 0) {
+    /* Choose the CPU for the jitter test by the sendmsg() tail. */
+    int cpus[MAX_CORES];
+    int i;
+    num_cores = cprt_allowed_cpus(cpus, MAX_CORES);
+    ASSRT(num_cores > 0);
+    for (i = 0; i < num_cores; i++) {
+      cores[i].cpu = cpus[i];
+      cprt_set_affinity_cpu(cpus[i]);
+      send_profile_loop(sock, &cores[i]);
+    }
+    int best_cpu = send_profile_print();
+
+    cprt_set_affinity_cpu(best_cpu);
+    cores[0].cpu = best_cpu;
+    single_cpu_loop();
   }
   else {
     int max_loops = 0;
@@ -352,8 +1155,8 @@ int main(int argc, char **argv)
         break;
       }
 
-      uint64_t num_sends = sock_loop(sock, 100000000);  /* .1 sec "warmup". */
-      num_sends = sock_loop(sock, 1000000000);  /* 1 sec test. */
+      uint64_t num_sends = sock_loop(sock, 100000000, "um_lat_jitter", 13, NULL);  /* .1 sec "warmup". */
+      num_sends = sock_loop(sock, 1000000000, "um_lat_jitter", 13, NULL);  /* 1 sec test. */
       printf("cpu=%d, num_sends=%"PRIu64"\n", cpu, num_sends);
       if (num_sends > max_loops) {
         max_loops = num_sends;
@@ -365,7 +1168,8 @@ int main(int argc, char **argv)
     CPRT_CPU_SET(max_cpu, &cpuset);
     cprt_set_affinity(cpuset);
 
-    jitter_loop();
+    cores[0].cpu = max_cpu;
+    single_cpu_loop();
   }
 
 
@@ -23,21 +23,29 @@
 #include "cprt.h"
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #if ! defined(_WIN32)
   #include <stdlib.h>
   #include <unistd.h>
+  #include <fcntl.h>
+  #include <sys/mman.h>
 #endif
 
 #include "lbm/lbm.h"
 #include "um_lat.h"
+#include "um_lat_hist.h"
 
 enum persist_mode_enum { STREAMING, RPP, SPP };
 enum rcv_thread_enum { MAIN_CTX, XSP };
 enum spin_method_enum { NO_SPIN, FD_MGT_BUSY };
+enum seq_spin_enum { SEQ_NO_SPIN, SEQ_PAUSE, SEQ_YIELD };
+enum load_profile_enum { EVEN, POISSON, BURST, RATE_FILE };
 
 /* Forward declarations. */
 lbm_xsp_t *my_xsp_mapper_callback(lbm_context_t *ctx, lbm_new_transport_info_t *transp_info, void *clientd);
 int my_rcv_cb(lbm_rcv_t *rcv, lbm_msg_t *msg, void *clientd);
+struct sender_s;
+void closed_loop_reply(struct sender_s *sender);
 
 
 /* Command-line options and their defaults. String defaults are set
@@ -46,60 +54,245 @@ int my_rcv_cb(lbm_rcv_t *rcv, lbm_msg_t *msg, void *clientd);
 int o_affinity_src = -1;  /* -A */
 int o_affinity_rcv = -1;
 char *o_config = NULL;
+int o_co_correct = 0;  /* -C */
+char *o_raw_file = NULL;  /* -f */
 int o_generic_src = 0;
 char *o_histogram = NULL;  /* -H */
+int o_topic_index = 0;  /* -I */
+int o_interval_ms = 0;  /* -i */
+int o_local_clock = 0;  /* -L */
 int o_linger_ms = 1000;
 int o_msg_len = 0;
 int o_num_msgs = 0;
+int o_num_responders = 1;  /* -N */
+int o_window = 0;  /* -O */
+char *o_load_profile = NULL;  /* -P */
 char *o_persist_mode = NULL;
 char *o_rcv_thread = NULL; /* -R */
 int o_rate = 0;
 char *o_spin_method = NULL;
+char *o_sequential = NULL;  /* -S */
+int o_num_threads = 1;  /* -T */
+char *o_time_source = NULL;  /* -t */
+char *o_sweep = NULL;  /* -W */
 char *o_warmup = NULL;
 char *o_xml_config = NULL;
 
 /* Parameters parsed out from command-line options. */
 char *app_name = "um_perf";
-int hist_num_buckets = 0;
-int hist_ns_per_bucket = 0;
+int hist_sig_digits = 2;
+int hist_max_sec = 60;
+enum load_profile_enum load_profile = EVEN;
+int burst_size = 0;
+int burst_gap_us = 0;
+char *rate_file = NULL;
 enum persist_mode_enum persist_mode = STREAMING;
 enum rcv_thread_enum rcv_thread = MAIN_CTX;
+int num_xsps = 0;
 enum spin_method_enum spin_method = NO_SPIN;
+int sequential = 0;
+int seq_timeout_ms = 0;
+enum seq_spin_enum seq_spin = SEQ_NO_SPIN;
+int use_tsc = 0;
+int sweep_start_rate = 0;
+int sweep_step_rate = 0;
+int sweep_end_rate = 0;
+int sweep_dwell_ms = 0;
+int sweep_num_steps = 0;  /* 0 = no sweep. */
 int warmup_loops = 0;
 int warmup_rate = 0;
 
+/* Each sender thread (-T) has its own source, receiver and statistics.
+ * Sender 0 uses "topic1" and "topic2", sender N uses "topic1.N" and
+ * "topic2.N" (N offset by -I). The fields written by the sending thread and
+ * those written by the receive thread are in separate cache lines. */
+#define MAX_SENDERS 64
+struct CPRT_CACHE_ALIGN sender_s {
+  int id;
+  char src_topic[32];
+  char rcv_topic[32];
+  lbm_src_t *src;  /* Used if o_generic_src is 1. */
+  lbm_ssrc_t *ssrc;  /* Used if o_generic_src is 0. */
+  char *ssrc_buff;
+  char *msg_buf;  /* Not used by SmartSource. */
+  perf_msg_t *perf_msg;
+  lbm_rcv_t *rcv;
+  hist_t *rtt_hist;
+  CPRT_THREAD_T thread_id;
+
+  /* Written by the sending thread. */
+  CPRT_CACHE_ALIGN uint64_t next_seq;  /* Written to perf_msg->seq. */
+  uint64_t num_measured_sends;  /* Compared to num_rcv_msgs. */
+  uint64_t max_outstanding;  /* Most round trips in progress at once. */
+  int max_tight_sends;
+  int actual_sends;
+  uint64_t duration_ns;
+
+  /* Written by the receive thread. */
+  CPRT_CACHE_ALIGN uint64_t num_rcv_msgs;
+  uint64_t last_rcv_seq;
+  int rcv_thread_id;  /* Which receive thread (-R x:N) gets the replies. */
+};
+struct sender_s senders[MAX_SENDERS];
+
 /* Globals. */
-char *msg_buf = NULL;
-perf_msg_t *perf_msg = NULL;
 int global_max_tight_sends = 0;
 int registration_complete = 0;
 int cur_flight_size = 0;
 int max_flight_size = 0;
+uint64_t max_outstanding = 0;  /* Largest of the senders' max_outstanding. */
+uint64_t *schedule_ns = NULL;  /* Intended send times for -P, from start. */
+hist_t *rtt_hist = NULL;  /* Service time, all senders (merged at end). */
+hist_t *response_hist = NULL;  /* Response time: from intended send time (-C). */
+struct sweep_step_s {
+  int rate;
+  int sends;
+  uint64_t duration_ns;
+  int max_tight_sends;
+  int max_flight_size;
+  uint64_t max_outstanding;
+};
+struct sweep_step_s *sweep_steps = NULL;  /* One per -W step. */
+hist_t **sweep_hists = NULL;  /* One per -W step. */
+hist_t *sweep_hist = NULL;  /* Current step's histogram, or NULL. */
+hist_t *turnaround_hist = NULL;  /* Pong's receive to its reflect. */
+hist_t *out_leg_hist = NULL;  /* Ping send to pong receive (-L). */
+hist_t *back_leg_hist = NULL;  /* Pong reflect to ping receive (-L). */
+hist_t *handoff_hist = NULL;  /* Pong's receive to its reflector thread (pong -D). */
+uint64_t num_rcv_msgs = 0;
+uint64_t num_rx_msgs = 0;
+uint64_t num_unrec_loss = 0;
+uint64_t num_seq_gaps = 0;  /* Messages skipped over in the seq sequence. */
+uint64_t num_seq_backward = 0;  /* Messages received out of seq order. */
+
+/* Each receive thread (the context thread, or one per XSP with -R x:N)
+ * records into its own slot, claimed the first time it calls my_rcv_cb.
+ * The totals above are merged from the slots after the test. */
+#define MAX_XSPS 16
+#define MAX_RCV_THREADS (MAX_XSPS + 1)
+struct CPRT_CACHE_ALIGN rcv_thread_s {
+  int id;
+  int ready;  /* Set (release) once the histograms are created. */
+  uint64_t num_rcv_msgs;
+  uint64_t num_rx_msgs;
+  uint64_t num_unrec_loss;
+  uint64_t num_seq_gaps;
+  uint64_t num_seq_backward;
+  hist_t *response_hist;
+  hist_t *turnaround_hist;
+  hist_t *out_leg_hist;
+  hist_t *back_leg_hist;
+  hist_t *handoff_hist;
+};
+struct rcv_thread_s rcv_threads[MAX_RCV_THREADS];
+int num_rcv_threads = 0;
+__thread struct rcv_thread_s *cur_rcv_thread = NULL;
+
+/* Fan-out (-N): every pong that subscribes to "topic2" reflects each
+ * message, so each message gets one reply per responder. Each pong's source
+ * gets its own slot (found through the receiver's source notification
+ * callback, so no lookup per message). All written by the single receive
+ * thread. */
+#define MAX_RESPONDERS 64
+struct CPRT_CACHE_ALIGN responder_s {
+  int id;
+  char source[LBM_MSG_MAX_SOURCE_LEN];
+  uint64_t num_rcv_msgs;
+  uint64_t num_rx_msgs;
+  uint64_t num_unrec_loss;
+  uint64_t num_seq_gaps;
+  uint64_t num_seq_backward;
+  uint64_t last_rcv_seq;
+  uint64_t num_last;  /* Messages for which this responder was the last. */
+  hist_t *rtt_hist;
+};
+struct responder_s responders[MAX_RESPONDERS];
+int num_responders = 0;  /* Joined so far. */
+
+/* Replies so far for a message, indexed by seq. A slot is reused after
+ * FANOUT_SLOTS messages, so a message that has not completed by then never
+ * completes. */
+#define FANOUT_SLOTS 65536
+struct fanout_slot_s {
+  uint64_t seq;
+  int num_replies;
+};
+struct fanout_slot_s *fanout_slots = NULL;
+hist_t *fanout_hist = NULL;  /* Send to the last reply of a message. */
+uint64_t num_fanout_complete = 0;
+
+/* Closed loop (-O): after the main thread sends the first "o_window"
+ * messages, the receive thread sends one message per reply. The lock only
+ * matters while the main thread is filling the window, since replies can
+ * already be arriving. */
+char closed_loop_lock = 0;
+int closed_loop_to_send = 0;  /* Only accessed with the lock held. */
+int closed_loop_done = 0;
+struct timespec closed_loop_end_ts;
+#define CLOSED_LOOP_LOCK() do { \
+  while (__atomic_test_and_set(&closed_loop_lock, __ATOMIC_ACQUIRE)) { } \
+} while (0)
+#define CLOSED_LOOP_UNLOCK() __atomic_clear(&closed_loop_lock, __ATOMIC_RELEASE)
 
 
 void help() {
-  fprintf(stderr, "Usage: um_lat_ping [-h] [-A affinity_src] [-a affinity_rcv] [-c config]\n  [-g] -H hist_num_buckets,hist_ns_per_bucket [-l linger_ms] -m msg_len\n  -n num_msgs [-p persist_mode] [-R rcv_thread] -r rate [-s spin_method]\n  [-w warmup_loops,warmup_rate] [-x xml_config]\n");
+  fprintf(stderr, "Usage: um_lat_ping [-h] [-A affinity_src] [-a affinity_rcv] [-C] [-c config]\n  [-f raw_file] [-g] [-H hist_sig_digits,hist_max_sec] [-I topic_index] [-i interval_ms] [-L] [-l linger_ms]\n  -m msg_len [-N num_responders] -n num_msgs [-O window] [-P load_profile] [-p persist_mode] [-R rcv_thread] -r rate\n  [-S seq_timeout_ms[,seq_spin]] [-s spin_method] [-T num_threads] [-t time_source]\n  [-W start_rate,step_rate,end_rate,dwell_ms] [-w warmup_loops,warmup_rate] [-x xml_config]\n");
   fprintf(stderr, "Where (those marked with 'R' are required):\n"
       "  -h : print help\n"
-      "  -A affinity_src : CPU number (0..N-1) for send thread (-1=none)\n"
+      "  -A affinity_src : CPU number (0..N-1) for send thread (-1=none);\n"
+      "       sender thread N uses affinity_src+N\n"
       "  -a affinity_rcv : CPU number (0..N-1) for receive thread (-1=none)\n"
+      "  -C : coordinated-omission correction; also report response time\n"
+      "       from intended send time (requires msg_len >= %d)\n"
       "  -c config : configuration file; can be repeated\n"
+      "  -f raw_file : write every round trip to raw_file (see raw_sample_t)\n"
       "  -g : generic source\n"
-      "R -H hist_num_buckets,hist_ns_per_bucket : round-trip time histogram\n"
+      "  -H hist_sig_digits,hist_max_sec : round-trip time histogram precision and range\n"
+      "  -I topic_index : sender N uses topic pair topic_index+N (0=\"topic1\",\n"
+      "       N=\"topic1.N\"); lets several ping processes share one pong -T\n"
+      "  -i interval_ms : print latency stats every interval_ms (0=none)\n"
+      "  -L : local clock; ping and pong share CLOCK_MONOTONIC (same host),\n"
+      "       so also report the one-way legs (requires msg_len >= %d)\n"
       "  -l linger_ms : linger time before source delete\n"
       "R -m msg_len : message length\n"
-      "R -n num_msgs : number of messages to send\n"
+      "  -N num_responders : fan-out; wait for and measure num_responders\n"
+      "       pongs, each with its own stats (requires msg_len >= %d)\n"
+      "R -n num_msgs : number of messages to send (unless -W)\n"
+      "  -O window : closed loop; keep at most window messages in flight\n"
+      "       (1=classic ping-pong); replaces -r\n"
+      "  -P load_profile : '' (empty)=evenly spaced, 'p'=Poisson,\n"
+      "       'b,burst_size,burst_gap_us'=bursts, 'f,rate_file'=rate profile;\n"
+      "       implies -C\n"
       "  -p persist_mode : '' (empty)=streaming, 'r'=RPP, 's'=SPP\n"
-      "  -R rcv_thread : '' (empty)=main context, 'x'=XSP\n"
-      "R -r rate : messages per second to send\n"
+      "  -R rcv_thread : '' (empty)=main context, 'x'=XSP, 'x:N'=N XSPs\n"
+      "       (receive thread N uses affinity_rcv+N)\n"
+      "R -r rate : messages per second to send (unless -W or -O)\n"
+      "  -S seq_timeout_ms[,seq_spin] : sequential context and XSPs, run by\n"
+      "       application threads calling process_events with seq_timeout_ms\n"
+      "       (0=poll); between calls seq_spin: '' (empty)=none, 'p'=pause,\n"
+      "       'y'=yield\n"
       "  -s spin_method : '' (empty)=no spin, 'f'=fd mgt busy\n"
+      "  -T num_threads : number of sender threads, each with its own topic\n"
+      "  -t time_source : '' (empty)=CLOCK_MONOTONIC, 't'=invariant TSC\n"
+      "  -W start_rate,step_rate,end_rate,dwell_ms : rate sweep; replaces\n"
+      "       -r and -n\n"
       "  -w warmup_loops,warmup_rate : messages to send before measurement\n"
-      "  -x xml_config : XML configuration file\n");
+      "  -x xml_config : XML configuration file\n",
+      (int)PERF_MSG_LEN_THROUGH(intended_ts), (int)PERF_MSG_LEN_THROUGH(pong_send_ts),
+      (int)PERF_MSG_LEN_THROUGH(seq));
   CPRT_NET_CLEANUP;
   exit(0);
 }
 
 
+/* Number of messages sent during step "step" of the -W sweep. */
+int sweep_msgs(int step)
+{
+  uint64_t rate = sweep_start_rate + (uint64_t)step * sweep_step_rate;
+  return (int)((rate * sweep_dwell_ms) / 1000 + 1);
+}  /* sweep_msgs */
+
+
 /* Process command-line options. */
 void get_my_opts(int argc, char **argv)
 {
@@ -107,45 +300,93 @@ void get_my_opts(int argc, char **argv)
 
   /* Set defaults for string options. */
   o_config = CPRT_STRDUP("");
-  o_histogram = CPRT_STRDUP("0,0");
+  o_raw_file = CPRT_STRDUP("");
+  o_histogram = CPRT_STRDUP("2,60");
+  o_load_profile = CPRT_STRDUP("");
   o_persist_mode = CPRT_STRDUP("");
   o_rcv_thread = CPRT_STRDUP("");
   o_spin_method = CPRT_STRDUP("");
+  o_sequential = CPRT_STRDUP("");
+  o_time_source = CPRT_STRDUP("");
+  o_sweep = CPRT_STRDUP("");
   o_warmup = CPRT_STRDUP("0,0");
   o_xml_config = CPRT_STRDUP("");
 
-  while ((opt = cprt_getopt(argc, argv, "hA:a:c:gH:l:L:m:n:p:R:r:s:w:x:")) != EOF) {
+  while ((opt = cprt_getopt(argc, argv, "hA:a:Cc:f:gH:I:i:Ll:m:N:n:O:P:p:R:r:S:s:T:t:W:w:x:")) != EOF) {
     switch (opt) {
       case 'h': help(); break;
       case 'A': CPRT_ATOI(cprt_optarg, o_affinity_src); break;
       case 'a': CPRT_ATOI(cprt_optarg, o_affinity_rcv); break;
+      case 'C': o_co_correct = 1; break;
       /* Allow -c to be repeated, loading each config file in succession. */
       case 'c':
         free(o_config);
         o_config = CPRT_STRDUP(cprt_optarg);
         E(lbm_config(o_config));
         break;
+      case 'f':
+        free(o_raw_file);
+        o_raw_file = CPRT_STRDUP(cprt_optarg);
+        break;
       case 'g': o_generic_src = 1; break;
       case 'H': {
         free(o_histogram);
         o_histogram = CPRT_STRDUP(cprt_optarg);
         char *work_str = CPRT_STRDUP(o_histogram);
         char *strtok_context;
-        char *hist_num_buckets_str = CPRT_STRTOK(work_str, ",", &strtok_context);
-        ASSRT(hist_num_buckets_str != NULL);
-        CPRT_ATOI(hist_num_buckets_str, hist_num_buckets);
+        char *hist_sig_digits_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(hist_sig_digits_str != NULL);
+        CPRT_ATOI(hist_sig_digits_str, hist_sig_digits);
 
-        char *hist_ns_per_bucket_str = CPRT_STRTOK(NULL, ",", &strtok_context);
-        ASSRT(hist_num_buckets_str != NULL);
-        CPRT_ATOI(hist_ns_per_bucket_str, hist_ns_per_bucket);
+        char *hist_max_sec_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        ASSRT(hist_max_sec_str != NULL);
+        CPRT_ATOI(hist_max_sec_str, hist_max_sec);
 
         ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
         free(work_str);
         break;
       }
+      case 'I': CPRT_ATOI(cprt_optarg, o_topic_index); break;
+      case 'i': CPRT_ATOI(cprt_optarg, o_interval_ms); break;
+      case 'L': o_local_clock = 1; break;
       case 'l': CPRT_ATOI(cprt_optarg, o_linger_ms); break;
       case 'm': CPRT_ATOI(cprt_optarg, o_msg_len); break;
+      case 'N': CPRT_ATOI(cprt_optarg, o_num_responders); break;
       case 'n': CPRT_ATOI(cprt_optarg, o_num_msgs); break;
+      case 'O': CPRT_ATOI(cprt_optarg, o_window); break;
+      case 'P': {
+        free(o_load_profile);
+        o_load_profile = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_load_profile);
+        char *strtok_context;
+        char *kind_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        if (kind_str == NULL) {
+          load_profile = EVEN;
+        } else if (strcasecmp(kind_str, "p") == 0) {
+          load_profile = POISSON;
+        } else if (strcasecmp(kind_str, "b") == 0) {
+          load_profile = BURST;
+          char *burst_size_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+          ASSRT(burst_size_str != NULL);
+          CPRT_ATOI(burst_size_str, burst_size);
+          char *burst_gap_us_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+          ASSRT(burst_gap_us_str != NULL);
+          CPRT_ATOI(burst_gap_us_str, burst_gap_us);
+          ASSRT(burst_size > 0);
+          ASSRT(burst_gap_us >= 0);
+        } else if (strcasecmp(kind_str, "f") == 0) {
+          load_profile = RATE_FILE;
+          char *rate_file_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+          ASSRT(rate_file_str != NULL);
+          free(rate_file);
+          rate_file = CPRT_STRDUP(rate_file_str);
+        } else {
+          FATAL_ERROR("-P value must be '', 'p', 'b,burst_size,burst_gap_us', or 'f,rate_file'\n");
+        }
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        free(work_str);
+        break;
+      }
       case 'p':
         free(o_persist_mode);
         o_persist_mode = CPRT_STRDUP(cprt_optarg);
@@ -167,13 +408,47 @@ void get_my_opts(int argc, char **argv)
         o_rcv_thread = CPRT_STRDUP(cprt_optarg);
         if (strcasecmp(o_rcv_thread, "") == 0) {
           rcv_thread = MAIN_CTX;
-        } else if (strcasecmp(o_rcv_thread, "x") == 0) {
+          num_xsps = 0;
+        } else if (strncasecmp(o_rcv_thread, "x", 1) == 0) {
           rcv_thread = XSP;
+          num_xsps = 1;
+          if (o_rcv_thread[1] == ':') {
+            CPRT_ATOI(&o_rcv_thread[2], num_xsps);
+          } else if (o_rcv_thread[1] != '\0') {
+            FATAL_ERROR("-R value must be '', 'x', or 'x:N'\n");
+          }
+          ASSRT(num_xsps >= 1 && num_xsps <= MAX_XSPS);
         } else {
-          FATAL_ERROR("-R value must be '' or 'x'\n");
+          FATAL_ERROR("-R value must be '', 'x', or 'x:N'\n");
         }
         break;
       case 'r': CPRT_ATOI(cprt_optarg, o_rate); break;
+      case 'S': {
+        free(o_sequential);
+        o_sequential = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_sequential);
+        char *strtok_context;
+        char *seq_timeout_ms_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(seq_timeout_ms_str != NULL);
+        CPRT_ATOI(seq_timeout_ms_str, seq_timeout_ms);
+        ASSRT(seq_timeout_ms >= 0);
+        sequential = 1;
+
+        char *seq_spin_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        if (seq_spin_str == NULL) {
+          seq_spin = SEQ_NO_SPIN;
+        } else if (strcasecmp(seq_spin_str, "p") == 0) {
+          seq_spin = SEQ_PAUSE;
+        } else if (strcasecmp(seq_spin_str, "y") == 0) {
+          seq_spin = SEQ_YIELD;
+        } else {
+          FATAL_ERROR("-S seq_spin must be '', 'p', or 'y'\n");
+        }
+
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        free(work_str);
+        break;
+      }
       case 's':
         free(o_spin_method);
         o_spin_method = CPRT_STRDUP(cprt_optarg);
@@ -185,6 +460,48 @@ void get_my_opts(int argc, char **argv)
           FATAL_ERROR("-s value must be '' or 'f'\n");
         }
         break;
+      case 'T': CPRT_ATOI(cprt_optarg, o_num_threads); break;
+      case 't':
+        free(o_time_source);
+        o_time_source = CPRT_STRDUP(cprt_optarg);
+        if (strcasecmp(o_time_source, "") == 0) {
+          use_tsc = 0;
+        } else if (strcasecmp(o_time_source, "t") == 0) {
+          use_tsc = 1;
+        } else {
+          FATAL_ERROR("-t value must be '' or 't'\n");
+        }
+        break;
+      case 'W': {
+        free(o_sweep);
+        o_sweep = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_sweep);
+        char *strtok_context;
+        char *start_rate_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(start_rate_str != NULL);
+        CPRT_ATOI(start_rate_str, sweep_start_rate);
+
+        char *step_rate_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        ASSRT(step_rate_str != NULL);
+        CPRT_ATOI(step_rate_str, sweep_step_rate);
+
+        char *end_rate_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        ASSRT(end_rate_str != NULL);
+        CPRT_ATOI(end_rate_str, sweep_end_rate);
+
+        char *dwell_ms_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        ASSRT(dwell_ms_str != NULL);
+        CPRT_ATOI(dwell_ms_str, sweep_dwell_ms);
+
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        ASSRT(sweep_start_rate > 0);
+        ASSRT(sweep_step_rate > 0);
+        ASSRT(sweep_end_rate >= sweep_start_rate);
+        ASSRT(sweep_dwell_ms > 0);
+        sweep_num_steps = (sweep_end_rate - sweep_start_rate) / sweep_step_rate + 1;
+        free(work_str);
+        break;
+      }
       case 'w': {
         free(o_warmup);
         o_warmup = CPRT_STRDUP(cprt_optarg);
@@ -218,108 +535,74 @@ void get_my_opts(int argc, char **argv)
 
   ASSRT(cprt_optind == argc);  /* No further command-line parameters allowed. */
 
+  if (sweep_num_steps > 0) {
+    /* The sweep determines the rates and message counts. */
+    int step;
+    ASSRT(load_profile == EVEN);
+    o_num_msgs = 0;
+    for (step = 0; step < sweep_num_steps; step++) {
+      o_num_msgs += sweep_msgs(step);
+    }
+    o_rate = sweep_end_rate;
+  }
+
+  if (o_window > 0) {
+    /* Closed loop: replies pace the sends. */
+    ASSRT(o_window <= o_num_msgs);
+    ASSRT(sweep_num_steps == 0);
+    ASSRT(load_profile == EVEN);
+    ASSRT(o_num_threads == 1);
+    ASSRT(! o_co_correct);  /* No schedule to be late for. */
+    if (o_rate == 0) {
+      o_rate = 1;  /* Not used. */
+    }
+  }
+
   /* Must supply certain required "options". */
   ASSRT(o_rate > 0);
   ASSRT(o_num_msgs > 0);
-  ASSRT(o_msg_len >= sizeof(perf_msg_t));
-  ASSRT(hist_num_buckets > 0);
-  ASSRT(hist_ns_per_bucket > 0);
-
-  /* Waited to read xml config (if any) so that app_name is set up right. */
-  if (strlen(o_xml_config) > 0) {
-    E(lbm_config_xml_file(o_xml_config, app_name));
+  ASSRT(PERF_MSG_HAS(o_msg_len, send_ts));
+  if (load_profile != EVEN) {
+    o_co_correct = 1;  /* Report latency from the intended send times. */
   }
-}  /* get_my_opts */
-
-
-/* Histogram. */
-uint64_t *hist_buckets = NULL;
-uint64_t hist_min_sample = 999999999;
-uint64_t hist_max_sample = 0;
-int hist_overflows = 0;  /* Number of values above the last bucket. */
-int hist_num_samples = 0;
-uint64_t hist_sample_sum = 0;
-
-void hist_init()
-{
-  /* Re-initialize the data. */
-  hist_min_sample = 999999999;
-  hist_max_sample = 0;
-  hist_overflows = 0;  /* Number of values above the last bucket. */
-  hist_num_samples = 0;
-  hist_sample_sum = 0;
-
-  /* Init histogram (also makes sure it is mapped to physical memory. */
-  int i;
-  for (i = 0; i < hist_num_buckets; i++) {
-    hist_buckets[i] = 0;
+  if (o_co_correct) {
+    ASSRT(PERF_MSG_HAS(o_msg_len, intended_ts));
   }
-}  /* hist_init */
-
-void hist_create()
-{
-  hist_buckets = (uint64_t *)malloc(hist_num_buckets * sizeof(uint64_t));
-
-  hist_init();
-}  /* hist_create */
-
-void hist_input(uint64_t in_sample)
-{
-  ASSRT(hist_buckets != NULL);
-
-  hist_num_samples++;
-  hist_sample_sum += in_sample;
-
-  if (in_sample > hist_max_sample) {
-    hist_max_sample = in_sample;
+  if (o_local_clock) {
+    ASSRT(PERF_MSG_HAS(o_msg_len, pong_send_ts));
   }
-  if (in_sample < hist_min_sample) {
-    hist_min_sample = in_sample;
+  ASSRT(hist_sig_digits >= 1 && hist_sig_digits <= 5);
+  ASSRT(hist_max_sec > 0);
+  ASSRT(o_interval_ms >= 0);
+  ASSRT(o_num_threads >= 1 && o_num_threads <= MAX_SENDERS);
+  ASSRT(o_topic_index >= 0);
+  if (o_num_threads > 1) {
+    ASSRT(sweep_num_steps == 0);  /* Sweep is single-threaded. */
   }
-
-  uint64_t bucket = in_sample / hist_ns_per_bucket;
-  if (bucket >= hist_num_buckets) {
-    hist_overflows++;
+  ASSRT(o_num_responders >= 1 && o_num_responders <= MAX_RESPONDERS);
+  if (o_num_responders > 1) {
+    /* Replies are matched to their message by seq. */
+    ASSRT(PERF_MSG_HAS(o_msg_len, seq));
+    ASSRT(o_num_threads == 1);
+    ASSRT(num_xsps <= 1);  /* Responders are tracked by one receive thread. */
   }
-  else {
-    hist_buckets[bucket]++;
+  if (num_xsps > 1 && o_num_threads > 1) {
+    /* Replies can arrive on several threads at once. */
+    ASSRT(o_interval_ms == 0);
+    ASSRT(strlen(o_raw_file) == 0);
   }
-}  /* hist_input */
-
-/* Get the latency (in ns) which "percentile" percent of samples are below.
- * Returns -1 if not calculable (i.e. too many overflows). */
-int hist_percentile(double percentile)
-{
-  int i;
-  int needed_samples = (int)((double)hist_num_samples * percentile / 100.0);
-  int found_samples = 0;
 
-  for (i = 0; i < hist_num_buckets; i++) {
-    found_samples += hist_buckets[i];
-    if (found_samples > needed_samples) {
-      return (i+1) * hist_ns_per_bucket;
-    }
+  /* The first TSC selection calibrates it (about 50 ms) if it is invariant. */
+  if (use_tsc && ! cprt_tsc_select(1)) {
+    printf("WARNING: TSC is not invariant, using CLOCK_MONOTONIC\n");
+    use_tsc = 0;
   }
 
-  return -1;
-}  /* hist_percentile */
-
-void hist_print()
-{
-  int i;
-  for (i = 0; i < hist_num_buckets; i++) {
-    printf("%"PRIu64"\n", hist_buckets[i]);
+  /* Waited to read xml config (if any) so that app_name is set up right. */
+  if (strlen(o_xml_config) > 0) {
+    E(lbm_config_xml_file(o_xml_config, app_name));
   }
-  printf("o_histogram=%s, hist_overflows=%d, hist_min_sample=%"PRIu64", hist_max_sample=%"PRIu64",\n",
-      o_histogram, hist_overflows, hist_min_sample, hist_max_sample);
-  uint64_t average_sample = hist_sample_sum / (uint64_t)hist_num_samples;
-  printf("hist_num_samples=%d, average_sample=%d,\n",
-      hist_num_samples, (int)average_sample);
-
-  printf("Percentiles: 90=%d, 99=%d, 99.9=%d, 99.99=%d, 99.999=%d\n",
-      hist_percentile(90.0), hist_percentile(99.0), hist_percentile(99.9),
-      hist_percentile(99.99), hist_percentile(99.999));
-}  /* hist_print */
+}  /* get_my_opts */
 
 
 /* Process source event. */
@@ -387,18 +670,99 @@ int my_src_event_cb(lbm_src_t *src, int event, void *extra_data, void *client_da
 }  /* my_src_event_cb */
 
 
+/* Sequential mode (-S): application threads run the UM event loops of the
+ * context and each XSP, instead of UM's own threads. */
+struct event_thread_s {
+  lbm_context_t *ctx;  /* Exactly one of ctx and xsp is set. */
+  lbm_xsp_t *xsp;
+  int affinity;  /* -1=none. */
+  int running;
+  CPRT_THREAD_T thread_id;
+};
+struct event_thread_s event_threads[MAX_XSPS + 1];
+int num_event_threads = 0;
+
+CPRT_THREAD_ENTRYPOINT event_thread(void *in_arg)
+{
+  struct event_thread_s *et = (struct event_thread_s *)in_arg;
+
+  if (et->affinity > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(et->affinity, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+
+  while (__atomic_load_n(&et->running, __ATOMIC_ACQUIRE)) {
+    if (et->xsp != NULL) {
+      E(lbm_xsp_process_events(et->xsp, seq_timeout_ms));
+    }
+    else {
+      E(lbm_context_process_events(et->ctx, seq_timeout_ms));
+    }
+    if (seq_spin == SEQ_PAUSE) {
+      CPRT_CPU_PAUSE();
+    }
+    else if (seq_spin == SEQ_YIELD) {
+      CPRT_YIELD();
+    }
+  }
+
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* event_thread */
+
+
+void event_thread_start(lbm_context_t *ctx, lbm_xsp_t *xsp, int affinity)
+{
+  ASSRT(num_event_threads < MAX_XSPS + 1);
+  struct event_thread_s *et = &event_threads[num_event_threads];
+  et->ctx = ctx;
+  et->xsp = xsp;
+  et->affinity = affinity;
+  et->running = 1;
+  CPRT_THREAD_CREATE(et->thread_id, event_thread, et);
+  num_event_threads++;
+}  /* event_thread_start */
+
+
+/* Stop the XSP threads, or (xsps_only=0) all of them. */
+void event_threads_stop(int xsps_only)
+{
+  int i;
+  for (i = 0; i < num_event_threads; i++) {
+    struct event_thread_s *et = &event_threads[i];
+    if (! et->running || (xsps_only && et->xsp == NULL)) {
+      continue;
+    }
+    __atomic_store_n(&et->running, 0, __ATOMIC_RELEASE);
+    if (et->xsp != NULL) {
+      E(lbm_xsp_unblock(et->xsp));
+    }
+    else {
+      E(lbm_context_unblock(et->ctx));
+    }
+    CPRT_THREAD_JOIN(et->thread_id);
+  }
+}  /* event_threads_stop */
+
+
 lbm_context_t *my_ctx = NULL;
-lbm_xsp_t *my_xsp = NULL;
+lbm_xsp_t *my_xsps[MAX_XSPS];
+int next_xsp = 0;  /* Only accessed by the context thread. */
 
 void create_context()
 {
   /* Create UM context. */
   lbm_context_attr_t *ctx_attr;
   E(lbm_context_attr_create(&ctx_attr));
+  if (sequential) {
+    E(lbm_context_attr_str_setopt(ctx_attr, "operational_mode", "sequential"));
+  }
 
   lbm_transport_mapping_func_t mapping_func;
   if (rcv_thread == XSP) {
-    /* Set all receive transport sessions to my_xsp. */
+    /* Spread receive transport sessions across my_xsps. */
     mapping_func.mapping_func = my_xsp_mapper_callback;
     mapping_func.clientd = NULL;
     E(lbm_context_attr_setopt(ctx_attr,
@@ -418,10 +782,18 @@ void create_context()
   /* Context thread inherits the initial CPU set of the process. */
   E(lbm_context_create(&my_ctx, ctx_attr, NULL, NULL));
   E(lbm_context_attr_delete(ctx_attr));
+  if (sequential) {
+    /* Without XSPs, the context thread is the receive thread. */
+    event_thread_start(my_ctx, NULL, (rcv_thread == XSP) ? -1 : o_affinity_rcv);
+  }
 
-  if (rcv_thread == XSP) {
+  int i;
+  for (i = 0; i < num_xsps; i++) {
     /* Xsp in use; create a fresh context attr (can't re-use parent's). */
     E(lbm_context_attr_create(&ctx_attr));
+    if (sequential) {
+      E(lbm_context_attr_str_setopt(ctx_attr, "operational_mode", "sequential"));
+    }
     /* Main context will host receivers; set desired options. */
     E(lbm_context_attr_str_setopt(ctx_attr,
         "ume_session_id", "0x6"));  /* Ping uses session ID 6. */
@@ -430,18 +802,17 @@ void create_context()
           "file_descriptor_management_behavior", "busy_wait"));
     }
 
-    E(lbm_xsp_create(&my_xsp, my_ctx, ctx_attr, NULL));
+    E(lbm_xsp_create(&my_xsps[i], my_ctx, ctx_attr, NULL));
     E(lbm_context_attr_delete(ctx_attr));
+    if (sequential) {
+      event_thread_start(NULL, my_xsps[i], (o_affinity_rcv > -1) ? o_affinity_rcv + i : -1);
+    }
   }
 
 }  /* create_context */
 
 
-lbm_src_t *my_src = NULL;  /* Used if o_generic_src is 1. */
-lbm_ssrc_t *my_ssrc = NULL;  /* Used if o_generic_src is 0. */
-char *my_ssrc_buff = NULL;
-
-void create_source(lbm_context_t *ctx)
+void create_source(lbm_context_t *ctx, struct sender_s *sender)
 {
   lbm_src_topic_attr_t *src_attr;
   lbm_topic_t *topic_obj;
@@ -449,17 +820,18 @@ void create_source(lbm_context_t *ctx)
   /* Set some options in code. */
   E(lbm_src_topic_attr_create(&src_attr));
 
-  /* The "ping" program sends messages to "topic1". */
-  E(lbm_src_topic_alloc(&topic_obj, ctx, "topic1", src_attr));
+  /* The "ping" program sends messages to "topic1" (and "topic1.N"). */
+  E(lbm_src_topic_alloc(&topic_obj, ctx, sender->src_topic, src_attr));
   if (o_generic_src) {
-    E(lbm_src_create(&my_src, ctx, topic_obj,
+    E(lbm_src_create(&sender->src, ctx, topic_obj,
         my_src_event_cb, NULL, NULL));
-    perf_msg = (perf_msg_t *)msg_buf;  /* Set up perf_msg once. */
+    sender->perf_msg = (perf_msg_t *)sender->msg_buf;  /* Set up perf_msg once. */
   }
   else {  /* Smart Src API. */
-    E(lbm_ssrc_create(&my_ssrc, ctx, topic_obj,
+    E(lbm_ssrc_create(&sender->ssrc, ctx, topic_obj,
         my_ssrc_event_cb, NULL, NULL));
-    E(lbm_ssrc_buff_get(my_ssrc, &my_ssrc_buff, 0));
+    E(lbm_ssrc_buff_get(sender->ssrc, &sender->ssrc_buff, 0));
+    memset(sender->ssrc_buff, 0, o_msg_len);  /* Pong timestamps start at 0. */
     /* Set up perf_msg before each send. */
   }
 
@@ -467,64 +839,274 @@ void create_source(lbm_context_t *ctx)
 }  /* create_source */
 
 
-void delete_source()
+void delete_source(struct sender_s *sender)
 {
   if (o_generic_src) {  /* If using smart src API */
-    E(lbm_src_delete(my_src));
+    E(lbm_src_delete(sender->src));
   }
   else {
-    E(lbm_ssrc_buff_put(my_ssrc, my_ssrc_buff));
-    E(lbm_ssrc_delete(my_ssrc));
+    E(lbm_ssrc_buff_put(sender->ssrc, sender->ssrc_buff));
+    E(lbm_ssrc_delete(sender->ssrc));
   }
 }  /* delete_source */
 
 
-lbm_rcv_t *my_rcv;
+/* Receiver source notification: called when a pong's source joins. The
+ * returned slot is delivered with each of its messages (msg->source_clientd). */
+void *responder_create_cb(const char *source_name, void *clientd)
+{
+  int id = __atomic_load_n(&num_responders, __ATOMIC_RELAXED);
+  if (id >= MAX_RESPONDERS) {
+    printf("WARNING: more than %d responders, ignoring '%s', \n", MAX_RESPONDERS, source_name);
+    return NULL;
+  }
+  struct responder_s *responder = &responders[id];
+  responder->id = id;
+  strncpy(responder->source, source_name, sizeof(responder->source) - 1);
+  responder->rtt_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  __atomic_store_n(&num_responders, id + 1, __ATOMIC_RELEASE);
+
+  printf("Responder joined: id=%d, source=%s, \n", id, source_name);
+  fflush(stdout);
+  return responder;
+}  /* responder_create_cb */
+
+
+int responder_delete_cb(const char *source_name, void *clientd, void *source_clientd)
+{
+  return 0;  /* Keep the slot; its stats are printed at the end. */
+}  /* responder_delete_cb */
+
+
+/* Zero the responders' statistics (e.g. after warmup). */
+void responders_init(uint64_t last_rcv_seq)
+{
+  int i;
+  int n = __atomic_load_n(&num_responders, __ATOMIC_ACQUIRE);
+  for (i = 0; i < n; i++) {
+    struct responder_s *responder = &responders[i];
+    responder->num_rcv_msgs = 0;
+    responder->num_rx_msgs = 0;
+    responder->num_unrec_loss = 0;
+    responder->num_seq_gaps = 0;
+    responder->num_seq_backward = 0;
+    responder->num_last = 0;
+    responder->last_rcv_seq = last_rcv_seq;
+    hist_init(responder->rtt_hist);
+  }
+  memset(fanout_slots, 0, FANOUT_SLOTS * sizeof(struct fanout_slot_s));
+  hist_init(fanout_hist);
+  num_fanout_complete = 0;
+}  /* responders_init */
+
 
-void create_receiver(lbm_context_t *ctx)
+/* Count a reply to a fan-out message. Returns 1 if it was the last of the
+ * o_num_responders replies. */
+int fanout_reply(struct responder_s *responder, uint64_t seq)
+{
+  struct fanout_slot_s *slot = &fanout_slots[seq & (FANOUT_SLOTS - 1)];
+  if (slot->seq != seq) {
+    slot->seq = seq;  /* First reply (or a slot taken over from an old seq). */
+    slot->num_replies = 0;
+  }
+  slot->num_replies++;
+  if (slot->num_replies == o_num_responders) {
+    responder->num_last++;
+    return 1;
+  }
+  return 0;
+}  /* fanout_reply */
+
+
+void create_receiver(lbm_context_t *ctx, struct sender_s *sender)
 {
   lbm_rcv_topic_attr_t *rcv_attr;
   E(lbm_rcv_topic_attr_create(&rcv_attr));
+  if (o_num_responders > 1) {
+    lbm_rcv_src_notification_func_t source_notification;
+    source_notification.create_func = responder_create_cb;
+    source_notification.delete_func = responder_delete_cb;
+    source_notification.clientd = NULL;
+    E(lbm_rcv_topic_attr_setopt(rcv_attr, "source_notification_function",
+        &source_notification, sizeof(source_notification)));
+  }
 
   /* Receive reflected messages from pong. */
   lbm_topic_t *topic_obj;
-  E(lbm_rcv_topic_lookup(&topic_obj, ctx, "topic2", rcv_attr));
-  E(lbm_rcv_create(&my_rcv, ctx, topic_obj, my_rcv_cb, NULL, NULL));
+  E(lbm_rcv_topic_lookup(&topic_obj, ctx, sender->rcv_topic, rcv_attr));
+  E(lbm_rcv_create(&sender->rcv, ctx, topic_obj, my_rcv_cb, sender, NULL));
+  E(lbm_rcv_topic_attr_delete(rcv_attr));
 }  /* create_receiver */
 
 
-uint64_t num_rcv_msgs;
-uint64_t num_rx_msgs;
-uint64_t num_unrec_loss;
+/* Return the calling receive thread's slot, claiming one on first use. */
+struct rcv_thread_s *rcv_thread_get()
+{
+  if (cur_rcv_thread == NULL) {
+    int id = __atomic_fetch_add(&num_rcv_threads, 1, __ATOMIC_RELAXED);
+    ASSRT(id < MAX_RCV_THREADS);
+    struct rcv_thread_s *rt = &rcv_threads[id];
+    uint64_t max_ns = (uint64_t)hist_max_sec * 1000000000ull;
+    rt->id = id;
+    rt->response_hist = hist_create(hist_sig_digits, max_ns);
+    rt->turnaround_hist = hist_create(hist_sig_digits, max_ns);
+    rt->out_leg_hist = hist_create(hist_sig_digits, max_ns);
+    rt->back_leg_hist = hist_create(hist_sig_digits, max_ns);
+    rt->handoff_hist = hist_create(hist_sig_digits, max_ns);
+    __atomic_store_n(&rt->ready, 1, __ATOMIC_RELEASE);
+    cur_rcv_thread = rt;
+  }
+  return cur_rcv_thread;
+}  /* rcv_thread_get */
+
+
+/* Zero the receive threads' statistics (e.g. after warmup). */
+void rcv_threads_init()
+{
+  int i;
+  for (i = 0; i < MAX_RCV_THREADS; i++) {
+    struct rcv_thread_s *rt = &rcv_threads[i];
+    if (! __atomic_load_n(&rt->ready, __ATOMIC_ACQUIRE)) {
+      continue;
+    }
+    rt->num_rcv_msgs = 0;
+    rt->num_rx_msgs = 0;
+    rt->num_unrec_loss = 0;
+    rt->num_seq_gaps = 0;
+    rt->num_seq_backward = 0;
+    hist_init(rt->response_hist);
+    hist_init(rt->turnaround_hist);
+    hist_init(rt->out_leg_hist);
+    hist_init(rt->back_leg_hist);
+    hist_init(rt->handoff_hist);
+  }
+}  /* rcv_threads_init */
+
+/* Raw sample capture (-f). The file is sized for the whole test and
+ * pre-faulted before the test, so recording a sample is just a few stores
+ * to sequential memory. */
+raw_sample_t *raw_samples = NULL;
+uint64_t raw_max_samples = 0;
+uint64_t raw_num_samples = 0;
+int raw_fd = -1;
+
+void raw_create()
+{
+  raw_max_samples = (uint64_t)o_num_msgs * o_num_threads * o_num_responders;
+  size_t raw_len = raw_max_samples * sizeof(raw_sample_t);
+
+  raw_fd = open(o_raw_file, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  CPRT_EM1(raw_fd);
+  /* Allocate the disk blocks now, not while the test is running. */
+  CPRT_EOK0(errno = posix_fallocate(raw_fd, 0, raw_len));
+
+  raw_samples = (raw_sample_t *)mmap(NULL, raw_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, raw_fd, 0);
+  ASSRT(raw_samples != MAP_FAILED);
+  /* Write every page so that no page faults happen during the test. */
+  memset(raw_samples, 0, raw_len);
+  raw_num_samples = 0;
+}  /* raw_create */
+
+/* Only call once the receivers are deleted; the receive callback does not
+ * synchronize with the unmap. */
+void raw_close()
+{
+  size_t raw_len = raw_max_samples * sizeof(raw_sample_t);
+  raw_sample_t *unmap_samples = raw_samples;
+
+  raw_samples = NULL;
+  CPRT_EOK0(munmap(unmap_samples, raw_len));
+  /* Trim the file to the samples actually recorded. */
+  CPRT_EOK0(ftruncate(raw_fd, raw_num_samples * sizeof(raw_sample_t)));
+  CPRT_EOK0(close(raw_fd));
+  raw_fd = -1;
+  printf("raw_file=%s, raw_num_samples=%"PRIu64", \n", o_raw_file, raw_num_samples);
+}  /* raw_close */
+
+/* Interval histograms (-i). Each sample belongs to the interval its
+ * receive time falls in, (rcv_ns - interval_start_ns) / interval_ns, and is
+ * recorded into interval_hists[interval % INTERVAL_HISTS]. To close an
+ * interval, interval_thread() advances interval_num_closed, waits for any
+ * receive thread still recording into that interval (interval_rcv_active),
+ * then prints and clears its histogram. A sample whose interval was already
+ * closed is counted in the oldest open one; one too far ahead (the interval
+ * thread is lagging) is counted in the newest interval whose buffer is not
+ * the one being reported. The receive thread never blocks or takes a lock. */
+#define INTERVAL_HISTS 4
+hist_t *interval_hists[INTERVAL_HISTS];
+uint64_t interval_start_ns = 0;
+uint64_t interval_ns = 0;
+uint64_t interval_num_closed = 0;
+uint64_t interval_rcv_active = 0;  /* Interval being recorded, plus 1 (0=none). */
+int interval_running = 0;
+CPRT_THREAD_T interval_thread_id;
+
+/* Record one sample into the histogram of the interval it was received in
+ * (see interval_thread). */
+void interval_input(uint64_t rcv_ns, uint64_t ns_rtt)
+{
+  uint64_t interval = 0;
+  uint64_t num_closed;
+
+  if (rcv_ns > interval_start_ns) {
+    interval = (rcv_ns - interval_start_ns) / interval_ns;
+  }
+  /* Announce the interval before checking it against interval_num_closed,
+   * so that interval_thread() either sees us or we see its update. */
+  for (;;) {
+    __atomic_store_n(&interval_rcv_active, interval + 1, __ATOMIC_SEQ_CST);
+    num_closed = __atomic_load_n(&interval_num_closed, __ATOMIC_SEQ_CST);
+    if (interval < num_closed) {
+      interval = num_closed;  /* Already reported; count it in the open one. */
+    }
+    else if (interval > num_closed + INTERVAL_HISTS - 2) {
+      /* Interval num_closed - 1 may still be being reported; don't wrap
+       * onto its buffer. */
+      interval = num_closed + INTERVAL_HISTS - 2;
+    }
+    else {
+      break;
+    }
+  }
+  hist_input(interval_hists[interval % INTERVAL_HISTS], ns_rtt);
+  __atomic_store_n(&interval_rcv_active, 0, __ATOMIC_RELEASE);
+}  /* interval_input */
+
 
 /* UM callback for receiver events, including received messages. */
 int my_rcv_cb(lbm_rcv_t *rcv, lbm_msg_t *msg, void *clientd)
 {
   struct timespec rcv_ts;
   CPRT_GETTIME(&rcv_ts);
+  struct rcv_thread_s *rt = rcv_thread_get();
 
   switch (msg->type) {
   case LBM_MSG_BOS:
+  {
+    struct sender_s *sender = (struct sender_s *)clientd;
     /* Assume receive thread is calling this; pin the time-critical thread
      * to the requested CPU. */
-    if (o_affinity_rcv > -1) {
+    if (o_affinity_rcv > -1 && ! sequential) {  /* -S threads pin themselves. */
       uint64_t cpuset;
       CPRT_CPU_ZERO(&cpuset);
-      CPRT_CPU_SET(o_affinity_rcv, &cpuset);
+      CPRT_CPU_SET(o_affinity_rcv + rt->id, &cpuset);
       cprt_set_affinity(cpuset);
     }
+    sender->rcv_thread_id = rt->id;
 
-    num_rcv_msgs = 0;
-    num_rx_msgs = 0;
-    num_unrec_loss = 0;
-    printf("rcv event BOS, topic_name='%s', source=%s, \n",
-      msg->topic_name, msg->source);
+    rt->num_rcv_msgs = 0;
+    rt->num_rx_msgs = 0;
+    rt->num_unrec_loss = 0;
+    printf("rcv event BOS, topic_name='%s', source=%s, rcv_thread_id=%d, \n",
+      msg->topic_name, msg->source, rt->id);
     fflush(stdout);
     break;
+  }
 
   case LBM_MSG_EOS:
-    printf("rcv event EOS, '%s', %s, num_rcv_msgs=%"PRIu64", num_rx_msgs=%"PRIu64", num_unrec_loss=%"PRIu64", \n",
-        msg->topic_name, msg->source, num_rcv_msgs, num_rx_msgs, num_unrec_loss);
+    printf("rcv event EOS, '%s', %s, rcv_thread_id=%d, num_rcv_msgs=%"PRIu64", num_rx_msgs=%"PRIu64", num_unrec_loss=%"PRIu64", \n",
+        msg->topic_name, msg->source, rt->id, rt->num_rcv_msgs, rt->num_rx_msgs, rt->num_unrec_loss);
     fflush(stdout);
     break;
 
@@ -537,25 +1119,118 @@ int my_rcv_cb(lbm_rcv_t *rcv, lbm_msg_t *msg, void *clientd)
 
   case LBM_MSG_UNRECOVERABLE_LOSS:
   {
-    num_unrec_loss++;
+    rt->num_unrec_loss++;
+    if (msg->source_clientd != NULL) {
+      ((struct responder_s *)msg->source_clientd)->num_unrec_loss++;
+    }
     break;
   }
 
   case LBM_MSG_DATA:
   {
+    struct sender_s *sender = (struct sender_s *)clientd;
     perf_msg_t *perf_msg = (perf_msg_t *)msg->data;
+    struct responder_s *responder = (struct responder_s *)msg->source_clientd;
+    int round_trip_done = 1;  /* With -N, only once all replies are in. */
 
-    num_rcv_msgs++;
+    rt->num_rcv_msgs++;
+    if (responder != NULL) {
+      responder->num_rcv_msgs++;
+      round_trip_done = fanout_reply(responder, perf_msg->seq);
+    }
+    if (round_trip_done) {
+      __atomic_store_n(&sender->num_rcv_msgs, sender->num_rcv_msgs + 1, __ATOMIC_RELAXED);
+    }
 
     if (perf_msg->send_ts.tv_sec != 0) {
       uint64_t ns_rtt;
       CPRT_DIFF_TS(ns_rtt, rcv_ts, perf_msg->send_ts);
-      hist_input((int)ns_rtt);
+      hist_input(sender->rtt_hist, ns_rtt);
+      if (responder != NULL) {
+        hist_input(responder->rtt_hist, ns_rtt);
+        if (round_trip_done) {
+          hist_input(fanout_hist, ns_rtt);
+          num_fanout_complete++;
+        }
+      }
+      if (sweep_hist != NULL) {
+        hist_input(sweep_hist, ns_rtt);
+      }
+
+      if (raw_samples != NULL && raw_num_samples < raw_max_samples) {
+        raw_sample_t *raw_sample = &raw_samples[raw_num_samples];
+        raw_sample->sequence = msg->sequence_number;
+        raw_sample->send_ns = TS_TO_NS(perf_msg->send_ts);
+        raw_sample->rcv_ns = TS_TO_NS(rcv_ts);
+        raw_sample->flags = msg->flags;
+        raw_num_samples++;
+      }
+
+      if (o_interval_ms > 0 && __atomic_load_n(&interval_running, __ATOMIC_ACQUIRE)) {
+        interval_input(TS_TO_NS(rcv_ts), ns_rtt);
+      }
+
+      if (o_co_correct) {
+        uint64_t ns_response;
+        CPRT_DIFF_TS(ns_response, rcv_ts, perf_msg->intended_ts);
+        hist_input(rt->response_hist, ns_response);
+      }
+
+      /* Pong only fills in its timestamps if the message has room. */
+      if (PERF_MSG_HAS(msg->len, pong_send_ts) && perf_msg->pong_rcv_ts.tv_sec != 0) {
+        uint64_t ns_turnaround;
+        CPRT_DIFF_TS(ns_turnaround, perf_msg->pong_send_ts, perf_msg->pong_rcv_ts);
+        hist_input(rt->turnaround_hist, ns_turnaround);
+
+        if (o_local_clock) {
+          uint64_t ns_out_leg, ns_back_leg;
+          CPRT_DIFF_TS(ns_out_leg, perf_msg->pong_rcv_ts, perf_msg->send_ts);
+          hist_input(rt->out_leg_hist, ns_out_leg);
+          CPRT_DIFF_TS(ns_back_leg, rcv_ts, perf_msg->pong_send_ts);
+          hist_input(rt->back_leg_hist, ns_back_leg);
+        }
+
+        /* Only set if pong handed the message to another thread. */
+        if (PERF_MSG_HAS(msg->len, pong_handoff_ts) && perf_msg->pong_handoff_ts.tv_sec != 0) {
+          uint64_t ns_handoff;
+          CPRT_DIFF_TS(ns_handoff, perf_msg->pong_handoff_ts, perf_msg->pong_rcv_ts);
+          hist_input(rt->handoff_hist, ns_handoff);
+        }
+      }
+    }
+
+    if (o_window > 0 && perf_msg->send_ts.tv_sec != 0 && round_trip_done) {
+      closed_loop_reply(sender);
+    }
+
+    if (responder != NULL) {
+      /* Each responder replies to every seq. */
+      if (perf_msg->seq > responder->last_rcv_seq) {
+        responder->num_seq_gaps += perf_msg->seq - responder->last_rcv_seq - 1;
+        rt->num_seq_gaps += perf_msg->seq - responder->last_rcv_seq - 1;
+        responder->last_rcv_seq = perf_msg->seq;
+      }
+      else {
+        responder->num_seq_backward++;
+        rt->num_seq_backward++;
+      }
+    }
+    else if (PERF_MSG_HAS(msg->len, seq)) {
+      if (perf_msg->seq > sender->last_rcv_seq) {
+        rt->num_seq_gaps += perf_msg->seq - sender->last_rcv_seq - 1;
+        sender->last_rcv_seq = perf_msg->seq;
+      }
+      else {
+        rt->num_seq_backward++;
+      }
     }
 
     /* Keep track of recovered messages. */
     if ((msg->flags & LBM_MSG_FLAG_RETRANSMIT) != 0) {
-      num_rx_msgs++;
+      rt->num_rx_msgs++;
+      if (responder != NULL) {
+        responder->num_rx_msgs++;
+      }
     }
     break;
   }
@@ -568,21 +1243,276 @@ int my_rcv_cb(lbm_rcv_t *rcv, lbm_msg_t *msg, void *clientd)
 }  /* my_rcv_cb */
 
 
+/* Called by the context thread for each new receive transport session. */
 lbm_xsp_t *my_xsp_mapper_callback(lbm_context_t *ctx, lbm_new_transport_info_t *transp_info, void *clientd)
 {
-  return my_xsp;
+  /* Round-robin, in the order the sessions are joined. */
+  lbm_xsp_t *xsp = my_xsps[next_xsp];
+  next_xsp = (next_xsp + 1) % num_xsps;
+  return xsp;
 }  /* my_xsp_mapper_callback */
 
 
-int send_loop(int num_sends, uint64_t sends_per_sec, int send_timestamp)
+/* Print one line of stats for a finished interval. */
+void interval_print(hist_t *hist, uint64_t t_ns, uint64_t len_ns)
+{
+  char time_str[32];
+  cprt_timestamp(time_str, sizeof(time_str), 0, 3);  /* Wall clock, for correlation. */
+
+  if (hist->num_samples == 0) {
+    printf("Interval: time=%s, t_ms=%"PRIu64", count=0, \n",
+        time_str, t_ns / 1000000);
+    fflush(stdout);
+    return;
+  }
+  double rate = 0.0;
+  if (len_ns > 0) {
+    rate = (double)hist->num_samples * 1000000000.0 / (double)len_ns;
+  }
+  printf("Interval: time=%s, t_ms=%"PRIu64", count=%"PRIu64", rate=%.0f, p50=%"PRId64", p99=%"PRId64", p99.9=%"PRId64", max=%"PRIu64", \n",
+      time_str, t_ns / 1000000, hist->num_samples, rate,
+      hist_percentile(hist, 50.0), hist_percentile(hist, 99.0),
+      hist_percentile(hist, 99.9), hist->max_sample);
+  fflush(stdout);
+}  /* interval_print */
+
+
+/* Close and report each interval as its end time passes. Intervals are
+ * fixed slots from interval_start_ns, so every sample is reported in
+ * exactly one of them regardless of when this thread gets to run. */
+CPRT_THREAD_ENTRYPOINT interval_thread(void *in_arg)
 {
   struct timespec cur_ts;
-  struct timespec start_ts;
+  uint64_t interval = 0;
+  uint64_t ns_so_far;
+  int stopping = 0;
+
+  while (! stopping) {
+    /* Sleep until the end of the interval (or the end of the test). */
+    uint64_t end_ns = (interval + 1) * interval_ns;
+    CPRT_GETTIME(&cur_ts);
+    ns_so_far = TS_TO_NS(cur_ts) - interval_start_ns;
+    if (ns_so_far < end_ns && __atomic_load_n(&interval_running, __ATOMIC_ACQUIRE)) {
+      uint64_t sleep_ms = (end_ns - ns_so_far) / 1000000;
+      CPRT_SLEEP_MS((sleep_ms > 0) ? ((sleep_ms > 100) ? 100 : sleep_ms) : 1);
+      continue;
+    }
+    stopping = ! __atomic_load_n(&interval_running, __ATOMIC_ACQUIRE);
+    if (stopping && ns_so_far < end_ns) {
+      end_ns = ns_so_far;  /* Final partial interval. */
+    }
+
+    /* Close the interval, then wait out a receive thread that was already
+     * recording into it (see interval_input). */
+    __atomic_store_n(&interval_num_closed, interval + 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&interval_rcv_active, __ATOMIC_SEQ_CST) == interval + 1) {
+      CPRT_CPU_PAUSE();
+    }
+
+    hist_t *hist = interval_hists[interval % INTERVAL_HISTS];
+    interval_print(hist, interval * interval_ns, end_ns - interval * interval_ns);
+    hist_init(hist);
+    interval++;
+  }
+
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* interval_thread */
+
+
+/* Load a rate profile file: one "rate,duration_ms" step per line; blank
+ * lines and lines starting with '#' are ignored. A rate of 0 is a silent
+ * gap. The profile repeats until all messages are scheduled. */
+int rate_file_load(int **rates, int **durations_ms)
+{
+  char line[256];
+  int num_steps = 0;
+  int max_steps = 0;
+  int have_sends = 0;
+  FILE *fp = fopen(rate_file, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "um_lat_ping: ERROR: cannot open rate file '%s'\n", rate_file);
+    exit(1);
+  }
+
+  *rates = NULL;
+  *durations_ms = NULL;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    char *strtok_context;
+    char *rate_str = CPRT_STRTOK(line, ", \t\r\n", &strtok_context);
+    if (rate_str == NULL || rate_str[0] == '#') {
+      continue;
+    }
+    char *duration_ms_str = CPRT_STRTOK(NULL, ", \t\r\n", &strtok_context);
+    ASSRT(duration_ms_str != NULL);
+
+    if (num_steps == max_steps) {
+      max_steps = (max_steps == 0) ? 64 : (max_steps * 2);
+      *rates = (int *)realloc(*rates, max_steps * sizeof(int));
+      *durations_ms = (int *)realloc(*durations_ms, max_steps * sizeof(int));
+      ASSRT(*rates != NULL && *durations_ms != NULL);
+    }
+    CPRT_ATOI(rate_str, (*rates)[num_steps]);
+    CPRT_ATOI(duration_ms_str, (*durations_ms)[num_steps]);
+    ASSRT((*rates)[num_steps] >= 0);
+    ASSRT((*durations_ms)[num_steps] > 0);
+    if ((*rates)[num_steps] > 0) {
+      have_sends = 1;
+    }
+    num_steps++;
+  }
+  fclose(fp);
+
+  if (! have_sends) {
+    FATAL_ERROR("rate file has no steps with non-zero rate\n");
+  }
+  return num_steps;
+}  /* rate_file_load */
+
+
+/* Precompute the intended send time (ns after the start of the send loop)
+ * of every message, so that the pacing loop only has to compare. */
+void schedule_create()
+{
+  double t_ns = 0.0;
+  int i;
+
+  schedule_ns = (uint64_t *)malloc(o_num_msgs * sizeof(uint64_t));
+  ASSRT(schedule_ns != NULL);
+
+  switch (load_profile) {
+  case POISSON: {
+    /* Exponentially-distributed gaps with mean 1/rate. Fixed seed so that
+     * runs are repeatable. */
+    unsigned short xsubi[3] = { 0x1234, 0x5678, 0x9abc };
+    for (i = 0; i < o_num_msgs; i++) {
+      schedule_ns[i] = (uint64_t)t_ns;
+      t_ns += -log(1.0 - erand48(xsubi)) * 1000000000.0 / (double)o_rate;
+    }
+    break;
+  }
+
+  case BURST:
+    /* Groups of burst_size messages at "-r rate", separated by the gap. */
+    for (i = 0; i < o_num_msgs; i++) {
+      schedule_ns[i] = (uint64_t)t_ns;
+      if (((i + 1) % burst_size) == 0) {
+        t_ns += (double)burst_gap_us * 1000.0;
+      }
+      else {
+        t_ns += 1000000000.0 / (double)o_rate;
+      }
+    }
+    break;
 
+  case RATE_FILE: {
+    int *rates;
+    int *durations_ms;
+    int num_steps = rate_file_load(&rates, &durations_ms);
+    int step = 0;
+    double step_end_ns = (double)durations_ms[0] * 1000000.0;
+    i = 0;
+    while (i < o_num_msgs) {
+      if (rates[step] > 0 && t_ns < step_end_ns) {
+        schedule_ns[i] = (uint64_t)t_ns;
+        i++;
+        t_ns += 1000000000.0 / (double)rates[step];
+      }
+      else {  /* Step is done; next one starts at its boundary. */
+        t_ns = step_end_ns;
+        step = (step + 1) % num_steps;
+        step_end_ns += (double)durations_ms[step] * 1000000.0;
+      }
+    }
+    free(rates);
+    free(durations_ms);
+    break;
+  }
+
+  default:
+    FATAL_ERROR("schedule_create: bad load_profile\n");
+  }  /* switch load_profile */
+
+  /* Leave "comma space" at end of line to make parsing output easier. */
+  uint64_t schedule_duration_ns = schedule_ns[o_num_msgs - 1];
+  printf("Schedule: load_profile=%d, schedule_duration_ns=%"PRIu64", schedule_rate=%f, \n",
+      load_profile, schedule_duration_ns,
+      (schedule_duration_ns > 0) ? (double)(o_num_msgs - 1) * 1000000000.0 / (double)schedule_duration_ns : 0.0);
+}  /* schedule_create */
+
+
+/* Construct and send one message. With -C, its intended send time is
+ * "intended_ns" after "start_ts". */
+void send_one(struct sender_s *sender, int send_timestamp, struct timespec *start_ts, uint64_t intended_ns)
+{
+  perf_msg_t *perf_msg = sender->perf_msg;
   int msg_send_flags = 0;
   if (o_generic_src) {
     msg_send_flags = LBM_SRC_NONBLOCK;
   }
+  else {  /* Smart Src API. */
+    /* Construct message in shared memory buffer. */
+    perf_msg = (perf_msg_t *)sender->ssrc_buff;
+  }
+
+  /* Construct message. */
+  if (PERF_MSG_HAS(o_msg_len, seq)) {
+    perf_msg->seq = sender->next_seq;
+  }
+  sender->next_seq++;
+  if (send_timestamp) {
+    if (o_co_correct) {
+      TS_ADD_NS(perf_msg->intended_ts, *start_ts, intended_ns);
+    }
+    CPRT_GETTIME(&(perf_msg->send_ts));
+  }
+  else {
+    perf_msg->send_ts.tv_sec = 0;
+    perf_msg->send_ts.tv_nsec = 0;
+  }
+
+  if (o_generic_src) {
+    /* Send message. */
+    int e = lbm_src_send(sender->src, (void *)perf_msg, o_msg_len, msg_send_flags);
+    if (e == -1) {
+      printf("next_seq=%"PRIu64", global_max_tight_sends=%d, max_flight_size=%d\n",
+          sender->next_seq, global_max_tight_sends, max_flight_size);
+    }
+    E(e);  /* If error, print message and fail. */
+  }
+  else {  /* Smart Src API. */
+    /* Send message and get next buffer from shared memory. */
+    int e = lbm_ssrc_send_ex(sender->ssrc, (char *)perf_msg, o_msg_len, msg_send_flags, NULL);
+    if (e == -1) {
+      printf("next_seq=%"PRIu64", global_max_tight_sends=%d, max_flight_size=%d\n",
+          sender->next_seq, global_max_tight_sends, max_flight_size);
+    }
+    E(e);  /* If error, print message and fail. */
+  }
+
+  int cur = __sync_fetch_and_add(&cur_flight_size, 1);
+  if (cur > max_flight_size) {
+    max_flight_size = cur;
+  }
+  if (send_timestamp) {
+    /* Round trips started but not yet completed. */
+    sender->num_measured_sends++;
+    /* Replies to unmeasured sends can outnumber the measured sends. */
+    int64_t outstanding = (int64_t)sender->num_measured_sends
+        - (int64_t)__atomic_load_n(&sender->num_rcv_msgs, __ATOMIC_RELAXED);
+    if (outstanding > 0 && (uint64_t)outstanding > sender->max_outstanding) {
+      sender->max_outstanding = (uint64_t)outstanding;
+    }
+  }
+}  /* send_one */
+
+
+/* If "schedule" is NULL, send evenly spaced at sends_per_sec; otherwise
+ * send message N at schedule[N] ns after the start of the loop. */
+int send_loop(struct sender_s *sender, int num_sends, uint64_t sends_per_sec, uint64_t *schedule, int send_timestamp)
+{
+  struct timespec cur_ts;
+  struct timespec start_ts;
 
   int max_tight_sends = 0;
 
@@ -594,10 +1524,19 @@ int send_loop(int num_sends, uint64_t sends_per_sec, int send_timestamp)
   do {  /* while num_sent < num_sends */
     uint64_t ns_so_far;
     CPRT_DIFF_TS(ns_so_far, cur_ts, start_ts);
-    /* The +1 is because we want to send, then pause. */
-    int should_have_sent = (int)((ns_so_far * sends_per_sec)/1000000000 + 1);
-    if (should_have_sent > num_sends) {
-      should_have_sent = num_sends;  // Don't send more than requested.
+    int should_have_sent;
+    if (schedule == NULL) {
+      /* The +1 is because we want to send, then pause. */
+      should_have_sent = (int)((ns_so_far * sends_per_sec)/1000000000 + 1);
+      if (should_have_sent > num_sends) {
+        should_have_sent = num_sends;  // Don't send more than requested.
+      }
+    }
+    else {
+      should_have_sent = num_sent;
+      while (should_have_sent < num_sends && schedule[should_have_sent] <= ns_so_far) {
+        should_have_sent++;
+      }
     }
     if ((should_have_sent - num_sent) > max_tight_sends) {
       max_tight_sends = should_have_sent - num_sent;
@@ -605,48 +1544,18 @@ int send_loop(int num_sends, uint64_t sends_per_sec, int send_timestamp)
 
     /* If we are behind where we should be, get caught up. */
     while (num_sent < should_have_sent) {
-      if (o_generic_src) {
-        /* Construct message. */
-        if (send_timestamp) {
-          CPRT_GETTIME(&(perf_msg->send_ts));
+      /* Message number "num_sent" was scheduled to go out this long
+       * after start_ts (see should_have_sent above). */
+      uint64_t intended_ns = 0;
+      if (o_co_correct) {
+        if (schedule == NULL) {
+          intended_ns = (num_sent * 1000000000ull) / sends_per_sec;
         }
         else {
-          perf_msg->send_ts.tv_sec = 0;
-          perf_msg->send_ts.tv_nsec = 0;
-        }
-
-        /* Send message. */
-        int e = lbm_src_send(my_src, (void *)perf_msg, o_msg_len, msg_send_flags);
-        if (e == -1) {
-          printf("num_sent=%"PRIu64", global_max_tight_sends=%d, max_flight_size=%d\n",
-              num_sent, global_max_tight_sends, max_flight_size);
+          intended_ns = schedule[num_sent];
         }
-        E(e);  /* If error, print message and fail. */
-      }
-      else {  /* Smart Src API. */
-        perf_msg = (perf_msg_t *)my_ssrc_buff;
-        /* Construct message in shared memory buffer. */
-        if (send_timestamp) {
-          CPRT_GETTIME(&(perf_msg->send_ts));
-        }
-        else {
-          perf_msg->send_ts.tv_sec = 0;
-          perf_msg->send_ts.tv_nsec = 0;
-        }
-
-        /* Send message and get next buffer from shared memory. */
-        int e = lbm_ssrc_send_ex(my_ssrc, (char *)perf_msg, o_msg_len, msg_send_flags, NULL);
-        if (e == -1) {
-          printf("num_sent=%"PRIu64", global_max_tight_sends=%d, max_flight_size=%d\n",
-              num_sent, global_max_tight_sends, max_flight_size);
-        }
-        E(e);  /* If error, print message and fail. */
-      }
-
-      int cur = __sync_fetch_and_add(&cur_flight_size, 1);
-      if (cur > max_flight_size) {
-        max_flight_size = cur;
       }
+      send_one(sender, send_timestamp, &start_ts, intended_ns);
 
       num_sent++;
     }  /* while num_sent < should_have_sent */
@@ -654,12 +1563,415 @@ int send_loop(int num_sends, uint64_t sends_per_sec, int send_timestamp)
     CPRT_GETTIME(&cur_ts);
   } while (num_sent < num_sends);
 
+  sender->max_tight_sends = max_tight_sends;
   global_max_tight_sends = max_tight_sends;
 
   return num_sent;
 }  /* send_loop */
 
 
+/* Run the -W rate ladder in one session: each step sends at its rate for
+ * dwell_ms, then lingers so that its round trips complete before the next
+ * step switches histograms. Returns the total number of messages sent. */
+int sweep_loop()
+{
+  int total_sends = 0;
+  int overall_max_tight_sends = 0;
+  int overall_max_flight_size = 0;
+  uint64_t overall_max_outstanding = 0;
+  int step;
+
+  for (step = 0; step < sweep_num_steps; step++) {
+    struct sweep_step_s *sweep_step = &sweep_steps[step];
+    struct timespec step_start_ts;
+    struct timespec step_end_ts;
+
+    sweep_step->rate = sweep_start_rate + step * sweep_step_rate;
+    max_flight_size = 0;
+    senders[0].max_outstanding = 0;
+    sweep_hist = sweep_hists[step];
+
+    CPRT_GETTIME(&step_start_ts);
+    sweep_step->sends = send_loop(&senders[0], sweep_msgs(step), sweep_step->rate, NULL, 1);
+    CPRT_GETTIME(&step_end_ts);
+    CPRT_DIFF_TS(sweep_step->duration_ns, step_end_ts, step_start_ts);
+
+    CPRT_SLEEP_MS(o_linger_ms);  /* Let this step's round trips complete. */
+
+    sweep_step->max_tight_sends = global_max_tight_sends;
+    sweep_step->max_flight_size = max_flight_size;
+    sweep_step->max_outstanding = senders[0].max_outstanding;
+    total_sends += sweep_step->sends;
+    if (global_max_tight_sends > overall_max_tight_sends) {
+      overall_max_tight_sends = global_max_tight_sends;
+    }
+    if (max_flight_size > overall_max_flight_size) {
+      overall_max_flight_size = max_flight_size;
+    }
+    if (sweep_step->max_outstanding > overall_max_outstanding) {
+      overall_max_outstanding = sweep_step->max_outstanding;
+    }
+
+    printf("Step: step=%d, rate=%d, sends=%d, p99=%"PRId64", \n", step,
+        sweep_step->rate, sweep_step->sends, hist_percentile(sweep_hist, 99.0));
+    fflush(stdout);
+  }
+  sweep_hist = NULL;
+
+  global_max_tight_sends = overall_max_tight_sends;
+  max_flight_size = overall_max_flight_size;
+  max_outstanding = overall_max_outstanding;
+
+  return total_sends;
+}  /* sweep_loop */
+
+
+/* Print the latency-vs-throughput table, and flag the knee: the first step
+ * where p99 exceeds twice the lowest p99 of the earlier steps, where the
+ * number of outstanding round trips (or, with persistence, the UM flight
+ * size) more than doubles relative to all earlier steps, or where the
+ * sender could not keep up with the requested rate. */
+void sweep_print()
+{
+  int64_t min_p99 = -1;
+  uint64_t prev_max_outstanding = 0;
+  int prev_max_flight_size = 0;
+  int knee_step = -1;
+  char *knee_reason = "none";
+  int step;
+
+  for (step = 0; step < sweep_num_steps; step++) {
+    struct sweep_step_s *sweep_step = &sweep_steps[step];
+    hist_t *hist = sweep_hists[step];
+    int64_t p99 = hist_percentile(hist, 99.0);
+    double actual_rate = 0.0;
+    if (sweep_step->duration_ns > 0 && sweep_step->sends > 1) {
+      actual_rate = (double)(sweep_step->sends - 1) * 1000000000.0
+          / (double)sweep_step->duration_ns;
+    }
+
+    int is_knee = 0;
+    if (knee_step == -1 && step > 0) {
+      if (min_p99 > 0 && p99 > 2 * min_p99) {
+        is_knee = 1;  knee_reason = "p99";
+      }
+      else if (sweep_step->max_outstanding > 4
+          && sweep_step->max_outstanding > 2 * prev_max_outstanding) {
+        is_knee = 1;  knee_reason = "max_outstanding";
+      }
+      else if (persist_mode != STREAMING && sweep_step->max_flight_size > 4
+          && sweep_step->max_flight_size > 2 * prev_max_flight_size) {
+        is_knee = 1;  knee_reason = "max_flight_size";
+      }
+      else if (actual_rate < 0.95 * (double)sweep_step->rate) {
+        is_knee = 1;  knee_reason = "actual_rate";
+      }
+      if (is_knee) {
+        knee_step = step;
+      }
+    }
+
+    /* Leave "comma space" at end of line to make parsing output easier. */
+    printf("Sweep: step=%d, rate=%d, actual_rate=%f, num_samples=%"PRIu64", p50=%"PRId64", p99=%"PRId64", p99.9=%"PRId64", max=%"PRId64", max_outstanding=%"PRIu64", max_flight_size=%d, max_tight_sends=%d, knee=%d, \n",
+        step, sweep_step->rate, actual_rate, hist->num_samples,
+        hist_percentile(hist, 50.0), p99, hist_percentile(hist, 99.9),
+        hist_percentile(hist, 100.0), sweep_step->max_outstanding,
+        sweep_step->max_flight_size, sweep_step->max_tight_sends, is_knee);
+
+    if (p99 > 0 && (min_p99 == -1 || p99 < min_p99)) {
+      min_p99 = p99;
+    }
+    if (sweep_step->max_outstanding > prev_max_outstanding) {
+      prev_max_outstanding = sweep_step->max_outstanding;
+    }
+    if (sweep_step->max_flight_size > prev_max_flight_size) {
+      prev_max_flight_size = sweep_step->max_flight_size;
+    }
+  }
+
+  printf("Sweep: knee_step=%d, knee_rate=%d, knee_reason=%s, \n", knee_step,
+      (knee_step == -1) ? 0 : sweep_steps[knee_step].rate, knee_reason);
+}  /* sweep_print */
+
+
+/* Called by the receive thread for each measured reply in closed-loop
+ * mode (-O): send the next message, keeping the window full. */
+void closed_loop_reply(struct sender_s *sender)
+{
+  CLOSED_LOOP_LOCK();
+  if (closed_loop_to_send > 0) {
+    closed_loop_to_send--;
+    send_one(sender, 1, NULL, 0);
+  }
+  CLOSED_LOOP_UNLOCK();
+
+  if (sender->num_rcv_msgs == o_num_msgs) {
+    CPRT_GETTIME(&closed_loop_end_ts);
+    __atomic_store_n(&closed_loop_done, 1, __ATOMIC_RELEASE);
+  }
+}  /* closed_loop_reply */
+
+
+/* Closed-loop measurement (-O): fill the window, then wait for the receive
+ * thread to finish the round trips. Gives up if replies stop arriving for
+ * linger_ms (e.g. a lost message). Returns the number of messages sent. */
+int closed_loop_run(struct sender_s *sender)
+{
+  struct timespec start_ts;
+  struct timespec cur_ts;
+  uint64_t last_num_rcv_msgs = 0;
+  int idle_ms = 0;
+  int i;
+
+  closed_loop_done = 0;
+  closed_loop_to_send = o_num_msgs - o_window;
+  CPRT_GETTIME(&start_ts);
+  for (i = 0; i < o_window; i++) {
+    CLOSED_LOOP_LOCK();
+    send_one(sender, 1, NULL, 0);
+    CLOSED_LOOP_UNLOCK();
+  }
+
+  while (! __atomic_load_n(&closed_loop_done, __ATOMIC_ACQUIRE)) {
+    CPRT_SLEEP_MS(1);
+    uint64_t cur_num_rcv_msgs = __atomic_load_n(&sender->num_rcv_msgs, __ATOMIC_RELAXED);
+    if (cur_num_rcv_msgs != last_num_rcv_msgs) {
+      last_num_rcv_msgs = cur_num_rcv_msgs;
+      idle_ms = 0;
+    }
+    else if (++idle_ms > o_linger_ms) {
+      printf("Closed: no replies for %d ms, giving up, \n", o_linger_ms);
+      break;
+    }
+  }
+
+  if (__atomic_load_n(&closed_loop_done, __ATOMIC_ACQUIRE)) {
+    cur_ts = closed_loop_end_ts;
+  }
+  else {
+    CPRT_GETTIME(&cur_ts);
+  }
+  CPRT_DIFF_TS(sender->duration_ns, cur_ts, start_ts);
+
+  CLOSED_LOOP_LOCK();  /* Stop the receive thread from sending. */
+  closed_loop_to_send = 0;
+  sender->actual_sends = (int)sender->num_measured_sends;
+  CLOSED_LOOP_UNLOCK();
+
+  /* Leave "comma space" at end of line to make parsing output easier. */
+  uint64_t round_trips = __atomic_load_n(&sender->num_rcv_msgs, __ATOMIC_RELAXED);
+  printf("Closed: window=%d, round_trips=%"PRIu64", duration_ns=%"PRIu64", round_trips_per_sec=%f, \n",
+      o_window, round_trips, sender->duration_ns,
+      (sender->duration_ns > 0) ? (double)round_trips * 1000000000.0 / (double)sender->duration_ns : 0.0);
+
+  return sender->actual_sends;
+}  /* closed_loop_run */
+
+
+/* Measured send loop of one sender, timed. */
+void sender_run(struct sender_s *sender)
+{
+  struct timespec start_ts;
+  struct timespec end_ts;
+
+  CPRT_GETTIME(&start_ts);
+  sender->actual_sends = send_loop(sender, o_num_msgs, o_rate, schedule_ns, 1);
+  CPRT_GETTIME(&end_ts);
+  CPRT_DIFF_TS(sender->duration_ns, end_ts, start_ts);
+}  /* sender_run */
+
+
+/* Thread for each sender when -T > 1. */
+CPRT_THREAD_ENTRYPOINT sender_thread(void *in_arg)
+{
+  struct sender_s *sender = (struct sender_s *)in_arg;
+
+  if (o_affinity_src > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(o_affinity_src + sender->id, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+
+  sender_run(sender);
+
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* sender_thread */
+
+
+/* Merge the senders' histograms into rtt_hist and combine their counters.
+ * With more than one sender, also print a line per sender. */
+void senders_merge()
+{
+  int i;
+
+  hist_init(rtt_hist);
+  for (i = 0; i < o_num_threads; i++) {
+    struct sender_s *sender = &senders[i];
+    hist_t *hist = sender->rtt_hist;
+
+    hist_merge(rtt_hist, hist);
+    if (sender->max_outstanding > max_outstanding) {
+      max_outstanding = sender->max_outstanding;
+    }
+    if (sender->max_tight_sends > global_max_tight_sends) {
+      global_max_tight_sends = sender->max_tight_sends;
+    }
+
+    if (o_num_threads > 1) {
+      double rate = 0.0;
+      if (sender->duration_ns > 0 && sender->actual_sends > 1) {
+        rate = (double)(sender->actual_sends - 1) * 1000000000.0
+            / (double)sender->duration_ns;
+      }
+      /* Leave "comma space" at end of line to make parsing output easier. */
+      printf("Sender: id=%d, topic=%s, actual_sends=%d, result_rate=%f, num_rcv_msgs=%"PRIu64", p50=%"PRId64", p99=%"PRId64", p99.9=%"PRId64", max=%"PRId64", max_tight_sends=%d, max_outstanding=%"PRIu64", \n",
+          sender->id, sender->src_topic, sender->actual_sends, rate,
+          sender->num_rcv_msgs, hist_percentile(hist, 50.0),
+          hist_percentile(hist, 99.0), hist_percentile(hist, 99.9),
+          hist_percentile(hist, 100.0), sender->max_tight_sends,
+          sender->max_outstanding);
+    }
+  }
+}  /* senders_merge */
+
+
+/* Merge the receive threads' statistics into the totals. With more than one
+ * receive thread, also print a line per thread. */
+void rcv_threads_merge()
+{
+  int i, s;
+  hist_t *thread_rtt_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+
+  hist_init(response_hist);
+  hist_init(turnaround_hist);
+  hist_init(out_leg_hist);
+  hist_init(back_leg_hist);
+  hist_init(handoff_hist);
+  num_rcv_msgs = 0;
+  num_rx_msgs = 0;
+  num_unrec_loss = 0;
+  num_seq_gaps = 0;
+  num_seq_backward = 0;
+
+  for (i = 0; i < MAX_RCV_THREADS; i++) {
+    struct rcv_thread_s *rt = &rcv_threads[i];
+    if (! __atomic_load_n(&rt->ready, __ATOMIC_ACQUIRE)) {
+      continue;
+    }
+    hist_merge(response_hist, rt->response_hist);
+    hist_merge(turnaround_hist, rt->turnaround_hist);
+    hist_merge(out_leg_hist, rt->out_leg_hist);
+    hist_merge(back_leg_hist, rt->back_leg_hist);
+    hist_merge(handoff_hist, rt->handoff_hist);
+    num_rcv_msgs += rt->num_rcv_msgs;
+    num_rx_msgs += rt->num_rx_msgs;
+    num_unrec_loss += rt->num_unrec_loss;
+    num_seq_gaps += rt->num_seq_gaps;
+    num_seq_backward += rt->num_seq_backward;
+
+    if (num_rcv_threads > 1) {
+      /* Round-trip times of the senders whose replies this thread got. */
+      int num_senders = 0;
+      hist_init(thread_rtt_hist);
+      for (s = 0; s < o_num_threads; s++) {
+        if (senders[s].rcv_thread_id == rt->id) {
+          hist_merge(thread_rtt_hist, senders[s].rtt_hist);
+          num_senders++;
+        }
+      }
+      /* Leave "comma space" at end of line to make parsing output easier. */
+      printf("RcvThread: id=%d, num_senders=%d, num_rcv_msgs=%"PRIu64", num_rx_msgs=%"PRIu64", num_unrec_loss=%"PRIu64", p50=%"PRId64", p99=%"PRId64", p99.9=%"PRId64", max=%"PRId64", \n",
+          rt->id, num_senders, rt->num_rcv_msgs, rt->num_rx_msgs,
+          rt->num_unrec_loss, hist_percentile(thread_rtt_hist, 50.0),
+          hist_percentile(thread_rtt_hist, 99.0),
+          hist_percentile(thread_rtt_hist, 99.9),
+          hist_percentile(thread_rtt_hist, 100.0));
+    }
+  }
+
+  hist_delete(thread_rtt_hist);
+}  /* rcv_threads_merge */
+
+
+/* Print service time (measured from the actual send time) and response
+ * time (measured from the intended send time) side by side. The difference
+ * is the queueing delay that the sender's schedule slip hides. */
+void co_print()
+{
+  hist_t *hists[2] = { rtt_hist, response_hist };
+  char *names[2] = { "service_ns", "response_ns" };
+
+  printf("CO: response_num_samples=%"PRIu64", response_overflows=%"PRIu64", \n",
+      response_hist->num_samples, response_hist->overflows);
+  hist_print_compare("CO:", 2, hists, names);
+}  /* co_print */
+
+
+/* Print each responder's stats (-N), then every reply's round-trip time
+ * next to the completion time (send to the last of the replies). The
+ * slowest responder is the one with the highest p99. */
+void fanout_print(int actual_sends)
+{
+  hist_t *hists[2] = { rtt_hist, fanout_hist };
+  char *names[2] = { "reply_ns", "completion_ns" };
+  int slowest_id = -1;
+  int64_t slowest_p99 = -1;
+  int i;
+
+  for (i = 0; i < num_responders; i++) {
+    struct responder_s *responder = &responders[i];
+    int64_t p99 = hist_percentile(responder->rtt_hist, 99.0);
+    if (p99 > slowest_p99) {
+      slowest_p99 = p99;
+      slowest_id = i;
+    }
+    /* Leave "comma space" at end of line to make parsing output easier. */
+    printf("Responder: id=%d, source=%s, num_rcv_msgs=%"PRIu64", num_rx_msgs=%"PRIu64", num_unrec_loss=%"PRIu64", num_seq_gaps=%"PRIu64", num_seq_backward=%"PRIu64", num_last=%"PRIu64", p50=%"PRId64", p99=%"PRId64", p99.9=%"PRId64", max=%"PRId64", \n",
+        responder->id, responder->source, responder->num_rcv_msgs,
+        responder->num_rx_msgs, responder->num_unrec_loss,
+        responder->num_seq_gaps, responder->num_seq_backward,
+        responder->num_last, hist_percentile(responder->rtt_hist, 50.0), p99,
+        hist_percentile(responder->rtt_hist, 99.9),
+        hist_percentile(responder->rtt_hist, 100.0));
+  }
+
+  printf("Fanout: num_responders=%d, num_complete=%"PRIu64", num_incomplete=%"PRIu64", slowest_id=%d, \n",
+      num_responders, num_fanout_complete,
+      (uint64_t)actual_sends - num_fanout_complete, slowest_id);
+  hist_print_compare("Fanout:", 2, hists, names);
+}  /* fanout_print */
+
+
+/* Print the decomposition of the round trip: ping->pong leg, pong
+ * turnaround, pong->ping leg. The legs are only meaningful when ping and
+ * pong share a clock (-L). */
+void legs_print()
+{
+  hist_t *hists[5];
+  char *names[5];
+  int num_hists = 0;
+
+  /* The handoff (pong -D) is part of the turnaround, so it goes next to it. */
+  if (o_local_clock) {
+    hists[num_hists] = rtt_hist; names[num_hists++] = "rtt_ns";
+    hists[num_hists] = out_leg_hist; names[num_hists++] = "out_leg_ns";
+  }
+  hists[num_hists] = turnaround_hist; names[num_hists++] = "turnaround_ns";
+  if (handoff_hist->num_samples > 0) {
+    hists[num_hists] = handoff_hist; names[num_hists++] = "handoff_ns";
+  }
+  if (o_local_clock) {
+    hists[num_hists] = back_leg_hist; names[num_hists++] = "back_leg_ns";
+  }
+
+  printf("Legs: turnaround_num_samples=%"PRIu64", handoff_num_samples=%"PRIu64", o_local_clock=%d, \n",
+      turnaround_hist->num_samples, handoff_hist->num_samples, o_local_clock);
+  hist_print_compare("Legs:", num_hists, hists, names);
+}  /* legs_print */
+
+
 int my_logger_cb(int level, const char *message, void *clientd)
 {
   /* A real application should include a high-precision time stamp and
@@ -676,6 +1988,7 @@ int main(int argc, char **argv)
   uint64_t duration_ns;
   int actual_sends;
   double result_rate;
+  int i;
   CPRT_NET_START;
 
   /* Set up callback for UM log messages. */
@@ -685,18 +1998,70 @@ int main(int argc, char **argv)
 
   get_my_opts(argc, argv);
 
-  hist_create();
+  rtt_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  response_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  turnaround_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  out_leg_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  back_leg_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  handoff_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  if (o_interval_ms > 0) {
+    for (i = 0; i < INTERVAL_HISTS; i++) {
+      interval_hists[i] = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+    }
+  }
+  if (o_num_responders > 1) {
+    fanout_slots = (struct fanout_slot_s *)malloc(FANOUT_SLOTS * sizeof(struct fanout_slot_s));
+    ASSRT(fanout_slots != NULL);
+    fanout_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  }
 
   /* Leave "comma space" at end of line to make parsing output easier. */
-  printf("o_affinity_src=%d, o_affinity_rcv=%d, o_config=%s, o_generic_src=%d, o_histogram=%s, o_linger_ms=%d, o_msg_len=%d, o_num_msgs=%d, o_persist_mode='%s', o_rcv_thread='%s', o_rate=%d, o_spin_method='%s', o_warmup=%s, o_xml_config=%s, \n",
-      o_affinity_src, o_affinity_rcv, o_config, o_generic_src, o_histogram,
-      o_linger_ms, o_msg_len, o_num_msgs, o_persist_mode, o_rcv_thread, o_rate,
-      o_spin_method, o_warmup, o_xml_config);
-  printf("app_name='%s', hist_num_buckets=%d, hist_ns_per_bucket=%d, persist_mode=%d, spin_method=%d, warmup_loops=%d, warmup_rate=%d, \n",
-      app_name, hist_num_buckets, hist_ns_per_bucket, persist_mode, spin_method,
-      warmup_loops, warmup_rate);
+  printf("o_affinity_src=%d, o_affinity_rcv=%d, o_co_correct=%d, o_config=%s, o_raw_file=%s, o_generic_src=%d, o_histogram=%s, o_topic_index=%d, o_interval_ms=%d, o_local_clock=%d, o_linger_ms=%d, o_load_profile='%s', o_msg_len=%d, o_num_responders=%d, o_num_msgs=%d, o_window=%d, o_persist_mode='%s', o_rcv_thread='%s', o_rate=%d, o_spin_method='%s', o_sequential='%s', o_sweep=%s, o_num_threads=%d, o_time_source='%s', o_warmup=%s, o_xml_config=%s, \n",
+      o_affinity_src, o_affinity_rcv, o_co_correct, o_config, o_raw_file, o_generic_src, o_histogram,
+      o_topic_index, o_interval_ms, o_local_clock, o_linger_ms, o_load_profile, o_msg_len, o_num_responders, o_num_msgs, o_window, o_persist_mode, o_rcv_thread, o_rate,
+      o_spin_method, o_sequential, o_sweep, o_num_threads, o_time_source, o_warmup, o_xml_config);
+  printf("app_name='%s', hist_sig_digits=%d, hist_max_sec=%d, persist_mode=%d, spin_method=%d, use_tsc=%d, tsc_ghz=%f, warmup_loops=%d, warmup_rate=%d, \n",
+      app_name, hist_sig_digits, hist_max_sec, persist_mode, spin_method,
+      use_tsc, cprt_tsc_ghz(), warmup_loops, warmup_rate);
+
+  for (i = 0; i < o_num_threads; i++) {
+    struct sender_s *sender = &senders[i];
+    memset(sender, 0, sizeof(*sender));
+    sender->id = i;
+    int topic_index = o_topic_index + i;
+    if (topic_index == 0) {
+      strcpy(sender->src_topic, "topic1");
+      strcpy(sender->rcv_topic, "topic2");
+    }
+    else {
+      snprintf(sender->src_topic, sizeof(sender->src_topic), "topic1.%d", topic_index);
+      snprintf(sender->rcv_topic, sizeof(sender->rcv_topic), "topic2.%d", topic_index);
+    }
+    sender->msg_buf = (char *)malloc(o_msg_len);  // Not used by SmartSource.
+    memset(sender->msg_buf, 0, o_msg_len);  /* Pong timestamps start at 0. */
+    sender->rtt_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+    sender->next_seq = 1;
+  }
+
+  if (strlen(o_raw_file) > 0) {
+    raw_create();
+  }
 
-  msg_buf = (char *)malloc(o_msg_len);  // Not used by SmartSource.
+  if (load_profile != EVEN) {
+    schedule_create();
+  }
+
+  if (sweep_num_steps > 0) {
+    int step;
+    sweep_steps = (struct sweep_step_s *)malloc(sweep_num_steps * sizeof(struct sweep_step_s));
+    ASSRT(sweep_steps != NULL);
+    memset(sweep_steps, 0, sweep_num_steps * sizeof(struct sweep_step_s));
+    sweep_hists = (hist_t **)malloc(sweep_num_steps * sizeof(hist_t *));
+    ASSRT(sweep_hists != NULL);
+    for (step = 0; step < sweep_num_steps; step++) {
+      sweep_hists[step] = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+    }
+  }
 
   create_context();
 
@@ -707,9 +2072,10 @@ int main(int argc, char **argv)
     cprt_set_affinity(cpuset);
   }
 
-  create_source(my_ctx);
-
-  create_receiver(my_ctx);
+  for (i = 0; i < o_num_threads; i++) {
+    create_source(my_ctx, &senders[i]);
+    create_receiver(my_ctx, &senders[i]);
+  }
 
   /* Ready to send "warmup" messages which should not be accumulated
    * in the histogram.
@@ -717,11 +2083,11 @@ int main(int argc, char **argv)
 
   if (persist_mode != STREAMING) {
     /* Wait for registration complete. */
-    while (registration_complete < 1) {
+    while (registration_complete < o_num_threads) {
       CPRT_SLEEP_SEC(1);
-      if (registration_complete < 1) {
+      if (registration_complete < o_num_threads) {
         printf("Waiting for %d store registrations.\n",
-            1 - registration_complete);
+            o_num_threads - registration_complete);
       }
     }
 
@@ -735,32 +2101,89 @@ int main(int argc, char **argv)
       /* Without persistence, need to initiate data on src.
        * NOTE: this message will NOT be received (head loss)
        * because topic resolution hasn't completed. */
-      send_loop(1, 999999999, 0);
+      for (i = 0; i < o_num_threads; i++) {
+        send_loop(&senders[i], 1, 999999999, NULL, 0);
+      }
       warmup_loops--;
     }
     /* Wait for topic resolution to complete. */
     CPRT_SLEEP_SEC(1);
   }
 
+  /* Fan-out: all the pongs must be reflecting before the test starts. */
+  while (o_num_responders > 1 &&
+      __atomic_load_n(&num_responders, __ATOMIC_ACQUIRE) < o_num_responders) {
+    printf("Waiting for %d responders.\n",
+        o_num_responders - __atomic_load_n(&num_responders, __ATOMIC_ACQUIRE));
+    CPRT_SLEEP_SEC(1);
+  }
+
   if (warmup_loops > 0) {
     /* Warmup loops to get CPU caches loaded. */
-    send_loop(warmup_loops, warmup_rate, 0);
+    for (i = 0; i < o_num_threads; i++) {
+      send_loop(&senders[i], warmup_loops, warmup_rate, NULL, 0);
+    }
     CPRT_SLEEP_MS(o_linger_ms);
   }
 
   /* Measure overall send rate by timing the main send loop. */
-  hist_init();  /* Zero out data from warmup period. */
-  num_rcv_msgs = 0;  /* Starting over. */
-  num_rx_msgs = 0;
-  num_unrec_loss = 0;
-
+  for (i = 0; i < o_num_threads; i++) {
+    struct sender_s *sender = &senders[i];
+    hist_init(sender->rtt_hist);  /* Zero out data from warmup period. */
+    sender->num_rcv_msgs = 0;
+    sender->num_measured_sends = 0;
+    sender->max_outstanding = 0;
+    sender->last_rcv_seq = sender->next_seq - 1;
+  }
+  rcv_threads_init();
+  if (o_num_responders > 1) {
+    responders_init(senders[0].next_seq - 1);
+  }
+  if (o_interval_ms > 0) {
+    struct timespec interval_start_ts;
+    for (i = 0; i < INTERVAL_HISTS; i++) {
+      hist_init(interval_hists[i]);
+    }
+    interval_ns = (uint64_t)o_interval_ms * 1000000;
+    interval_num_closed = 0;
+    CPRT_GETTIME(&interval_start_ts);
+    interval_start_ns = TS_TO_NS(interval_start_ts);
+    __atomic_store_n(&interval_running, 1, __ATOMIC_RELEASE);
+    CPRT_THREAD_CREATE(interval_thread_id, interval_thread, NULL);
+  }
   CPRT_GETTIME(&start_ts);
-  actual_sends = send_loop(o_num_msgs, o_rate, 1);
+  if (sweep_num_steps > 0) {
+    actual_sends = sweep_loop();
+  }
+  else if (o_window > 0) {
+    actual_sends = closed_loop_run(&senders[0]);
+  }
+  else if (o_num_threads == 1) {
+    sender_run(&senders[0]);  /* Main thread is already pinned. */
+    actual_sends = senders[0].actual_sends;
+  }
+  else {
+    for (i = 0; i < o_num_threads; i++) {
+      CPRT_THREAD_CREATE(senders[i].thread_id, sender_thread, &senders[i]);
+    }
+    actual_sends = 0;
+    for (i = 0; i < o_num_threads; i++) {
+      CPRT_THREAD_JOIN(senders[i].thread_id);
+      actual_sends += senders[i].actual_sends;
+    }
+  }
   CPRT_GETTIME(&end_ts);
   CPRT_DIFF_TS(duration_ns, end_ts, start_ts);
 
   CPRT_SLEEP_MS(o_linger_ms);
 
+  if (o_interval_ms > 0) {
+    /* Stop the interval thread; it reports the final partial interval. */
+    __atomic_store_n(&interval_running, 0, __ATOMIC_RELEASE);
+    CPRT_THREAD_JOIN(interval_thread_id);
+  }
+
+  rcv_threads_merge();
   ASSRT(num_rcv_msgs > 0);
 
   result_rate = (double)(duration_ns);
@@ -768,15 +2191,28 @@ int main(int argc, char **argv)
   /* Don't count initial message. */
   result_rate = (double)(actual_sends - 1) / result_rate;
 
-  hist_print();
+  senders_merge();
+  hist_print(rtt_hist);
+  if (o_co_correct) {
+    co_print();
+  }
+  if (sweep_num_steps > 0) {
+    sweep_print();
+  }
+  if (PERF_MSG_HAS(o_msg_len, pong_send_ts)) {
+    legs_print();
+  }
+  if (o_num_responders > 1) {
+    fanout_print(actual_sends);
+  }
 
   /* Leave "comma space" at end of line to make parsing output easier. */
-  printf("actual_sends=%d, duration_ns=%"PRIu64", result_rate=%f, global_max_tight_sends=%d, max_flight_size=%d, \n",
+  printf("actual_sends=%d, duration_ns=%"PRIu64", result_rate=%f, global_max_tight_sends=%d, max_flight_size=%d, max_outstanding=%"PRIu64", \n",
       actual_sends, duration_ns, result_rate, global_max_tight_sends,
-      max_flight_size);
+      max_flight_size, max_outstanding);
 
-  printf("Rcv: num_rcv_msgs=%"PRIu64", num_rx_msgs=%"PRIu64", num_unrec_loss=%"PRIu64", \n",
-      num_rcv_msgs, num_rx_msgs, num_unrec_loss);
+  printf("Rcv: num_rcv_msgs=%"PRIu64", num_rx_msgs=%"PRIu64", num_unrec_loss=%"PRIu64", num_seq_gaps=%"PRIu64", num_seq_backward=%"PRIu64", \n",
+      num_rcv_msgs, num_rx_msgs, num_unrec_loss, num_seq_gaps, num_seq_backward);
 
   if (persist_mode != STREAMING) {
     /* Wait for Store to get caught up. */
@@ -792,19 +2228,34 @@ int main(int argc, char **argv)
     }
   }
   ASSRT(num_unrec_loss == 0);
-  ASSRT(num_rcv_msgs == actual_sends);
+  ASSRT(num_rcv_msgs == (uint64_t)actual_sends * o_num_responders);
 
-  delete_source();
-
-  E(lbm_rcv_delete(my_rcv));
+  for (i = 0; i < o_num_threads; i++) {
+    delete_source(&senders[i]);
+    E(lbm_rcv_delete(senders[i].rcv));
+  }
 
-  if (rcv_thread == XSP) {
-    E(lbm_xsp_delete(my_xsp));
+  /* Sequential: keep the event loops running through the receiver deletes,
+   * then stop each before deleting the object it runs. */
+  event_threads_stop(1);
+  for (i = 0; i < num_xsps; i++) {
+    E(lbm_xsp_delete(my_xsps[i]));
   }
 
+  event_threads_stop(0);
   E(lbm_context_delete(my_ctx));
 
-  free(msg_buf);
+  /* The receivers and contexts are gone, so no callback can still be
+   * recording a sample. */
+  if (raw_samples != NULL) {
+    raw_close();
+  }
+
+  for (i = 0; i < o_num_threads; i++) {
+    free(senders[i].msg_buf);
+    hist_delete(senders[i].rtt_hist);
+  }
+  free(schedule_ns);
 
   CPRT_NET_CLEANUP;
   return 0;
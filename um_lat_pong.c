@@ -23,6 +23,7 @@
 #include "cprt.h"
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #if ! defined(_WIN32)
   #include <stdlib.h>
   #include <unistd.h>
@@ -30,10 +31,25 @@
 
 #include "lbm/lbm.h"
 #include "um_lat.h"
+#include "um_lat_hist.h"
 
 enum persist_mode_enum { STREAMING, RPP, SPP };
 enum rcv_thread_enum { MAIN_CTX, XSP };
 enum spin_method_enum { NO_SPIN, FD_MGT_BUSY };
+enum seq_spin_enum { SEQ_NO_SPIN, SEQ_PAUSE, SEQ_YIELD };
+enum handoff_enum { NO_HANDOFF, HANDOFF_SPIN, HANDOFF_PAUSE, HANDOFF_YIELD };
+enum work_dist_enum { WORK_FIXED, WORK_EXPONENTIAL, WORK_UNIFORM };
+
+#define MAX_TOPICS 64
+#define MAX_XSPS 16
+/* Context or XSP threads, plus the reflector thread (-D). */
+#define MAX_RCV_THREADS (MAX_XSPS + 2)
+#define MAX_REFLECT_BUFFS 16
+#define MAX_SOURCES 256  /* Pingers tracked by -F. */
+/* Bytes of the perf_msg header that ping and pong ever touch. */
+#define REFLECT_HDR_LEN PERF_MSG_LEN_THROUGH(pong_handoff_ts)
+#define HANDOFF_RING_SIZE 1024  /* Must be a power of 2. */
+#define WORK_TABLE_SIZE 65536  /* Must be a power of 2. */
 
 /* Forward declarations. */
 lbm_xsp_t *my_xsp_mapper_callback(lbm_context_t *ctx, lbm_new_transport_info_t *transp_info, void *clientd);
@@ -41,20 +57,42 @@ int my_rcv_cb(lbm_rcv_t *rcv, lbm_msg_t *msg, void *clientd);
 
 /* Command-line options and their defaults. String defaults are set
  * in "get_my_opts()". */
+int o_affinity_reflector = -1;  /* -A */
 int o_affinity_rcv = -1;
 char *o_config = NULL;
+char *o_handoff = NULL;  /* -D */
 int o_exit_on_eos = 0;  /* -E */
+int o_fan_in = 0;  /* -F */
 int o_generic_src = 0;
+char *o_histogram = NULL;  /* -H */
+char *o_touch = NULL;  /* -M */
 char *o_persist_mode = NULL;
 char *o_rcv_thread = NULL; /* -R */
 char *o_spin_method = NULL;
+char *o_sequential = NULL;  /* -S */
+int o_num_topics = 1;  /* -T */
+char *o_time_source = NULL;  /* -t */
+char *o_work = NULL;  /* -w */
 char *o_xml_config = NULL;
+int o_reflect_buffs = 0;  /* -Z */
 
 /* Parameters parsed out from command-line options. */
 char *app_name = "um_perf";
 enum persist_mode_enum persist_mode = STREAMING;
 enum rcv_thread_enum rcv_thread = MAIN_CTX;
+int num_xsps = 0;
 enum spin_method_enum spin_method = NO_SPIN;
+int sequential = 0;
+int seq_timeout_ms = 0;
+enum seq_spin_enum seq_spin = SEQ_NO_SPIN;
+enum handoff_enum handoff = NO_HANDOFF;
+int hist_sig_digits = 2;
+int hist_max_sec = 60;
+uint64_t touch_bytes = 0;
+uint64_t working_set_bytes = 0;
+uint64_t work_ns = 0;
+enum work_dist_enum work_dist = WORK_FIXED;
+int use_tsc = 0;
 
 /* Globals. */
 int registration_complete = 0;
@@ -63,17 +101,39 @@ int max_flight_size = 0;
 
 
 void help() {
-  fprintf(stderr, "Usage: um_lat_pong [-h] [-a affinity_rcv] [-c config] [-E] [-g]\n  [-p persist_mode] [-R rcv_thread] [-s spin_method] [-x xml_config]\n");
+  fprintf(stderr, "Usage: um_lat_pong [-h] [-A affinity_reflector] [-a affinity_rcv] [-c config]\n  [-D handoff] [-E] [-F] [-g] [-H hist_sig_digits,hist_max_sec]\n  [-M touch_bytes[,working_set_bytes]] [-p persist_mode] [-R rcv_thread]\n  [-S seq_timeout_ms[,seq_spin]] [-s spin_method] [-T num_topics] [-t time_source]\n  [-w work_ns[,work_dist]] [-x xml_config] [-Z num_buffs]\n");
   fprintf(stderr, "Where:\n"
       "  -h : print help\n"
+      "  -A affinity_reflector : CPU number (0..N-1) for reflector thread (-D)\n"
+      "       (-1=none)\n"
       "  -a affinity_rcv : CPU number (0..N-1) for receive thread (-1=none)\n"
       "  -c config : configuration file; can be repeated\n"
+      "  -D handoff : '' (empty)=reflect in receive thread, else hand off to a\n"
+      "       reflector thread which waits by 's'=spin, 'p'=spin with pause,\n"
+      "       'y'=yield\n"
       "  -E : exit on EOS\n"
+      "  -F : fan-in; per-source rate and backlog stats, reported when every\n"
+      "       source that joined has ended\n"
       "  -g : generic source\n"
+      "  -H hist_sig_digits,hist_max_sec : service time histogram precision and range\n"
+      "  -M touch_bytes[,working_set_bytes] : per-message work; write\n"
+      "       touch_bytes of a working set (default=touch_bytes) before reflecting\n"
       "  -p persist_mode : '' (empty)=streaming, 'r'=RPP, 's'=SPP\n"
-      "  -R rcv_thread : '' (empty)=main context, 'x'=XSP\n"
+      "  -R rcv_thread : '' (empty)=main context, 'x'=XSP, 'x:N'=N XSPs\n"
+      "       (receive thread N uses affinity_rcv+N)\n"
+      "  -S seq_timeout_ms[,seq_spin] : sequential context and XSPs, run by\n"
+      "       application threads calling process_events with seq_timeout_ms\n"
+      "       (0=poll); between calls seq_spin: '' (empty)=none, 'p'=pause,\n"
+      "       'y'=yield\n"
       "  -s spin_method : '' (empty)=no spin, 'f'=fd mgt busy\n"
-      "  -x xml_config : configuration file\n");
+      "  -T num_topics : reflect this many topics (match ping's -T)\n"
+      "  -t time_source : '' (empty)=CLOCK_MONOTONIC, 't'=invariant TSC\n"
+      "  -w work_ns[,work_dist] : per-message work; busy-wait work_ns before\n"
+      "       reflecting. work_dist: '' (empty)=fixed, 'e'=exponential,\n"
+      "       'u'=uniform 0..2*work_ns\n"
+      "  -x xml_config : configuration file\n"
+      "  -Z num_buffs : header-only reflection rotating through num_buffs\n"
+      "                 Smart Source buffers (0=full copy)\n");
   CPRT_NET_CLEANUP;
   exit(0);
 }
@@ -86,14 +146,21 @@ void get_my_opts(int argc, char **argv)
 
   /* Set defaults for string options. */
   o_config = CPRT_STRDUP("");
+  o_handoff = CPRT_STRDUP("");
+  o_histogram = CPRT_STRDUP("2,60");
+  o_touch = CPRT_STRDUP("0");
   o_persist_mode = CPRT_STRDUP("");
   o_rcv_thread = CPRT_STRDUP("");
   o_spin_method = CPRT_STRDUP("");
+  o_sequential = CPRT_STRDUP("");
+  o_time_source = CPRT_STRDUP("");
+  o_work = CPRT_STRDUP("0");
   o_xml_config = CPRT_STRDUP("");
 
-  while ((opt = cprt_getopt(argc, argv, "ha:c:Egp:R:s:x:")) != EOF) {
+  while ((opt = cprt_getopt(argc, argv, "hA:a:c:D:EFgH:M:p:R:S:s:T:t:w:x:Z:")) != EOF) {
     switch (opt) {
       case 'h': help(); break;
+      case 'A': CPRT_ATOI(cprt_optarg, o_affinity_reflector); break;
       case 'a': CPRT_ATOI(cprt_optarg, o_affinity_rcv); break;
       /* Allow -c to be repeated, loading each config file in succession. */
       case 'c':
@@ -101,8 +168,60 @@ void get_my_opts(int argc, char **argv)
         o_config = CPRT_STRDUP(cprt_optarg);
         E(lbm_config(o_config));  /* Allow multiple calls. */
         break;
+      case 'D':
+        free(o_handoff);
+        o_handoff = CPRT_STRDUP(cprt_optarg);
+        if (strcasecmp(o_handoff, "") == 0) {
+          handoff = NO_HANDOFF;
+        } else if (strcasecmp(o_handoff, "s") == 0) {
+          handoff = HANDOFF_SPIN;
+        } else if (strcasecmp(o_handoff, "p") == 0) {
+          handoff = HANDOFF_PAUSE;
+        } else if (strcasecmp(o_handoff, "y") == 0) {
+          handoff = HANDOFF_YIELD;
+        } else {
+          FATAL_ERROR("-D value must be '', 's', 'p', or 'y'\n");
+        }
+        break;
       case 'E': o_exit_on_eos = 1; break;
+      case 'F': o_fan_in = 1; break;
       case 'g': o_generic_src = 1; break;
+      case 'H': {
+        free(o_histogram);
+        o_histogram = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_histogram);
+        char *strtok_context;
+        char *hist_sig_digits_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(hist_sig_digits_str != NULL);
+        CPRT_ATOI(hist_sig_digits_str, hist_sig_digits);
+
+        char *hist_max_sec_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        ASSRT(hist_max_sec_str != NULL);
+        CPRT_ATOI(hist_max_sec_str, hist_max_sec);
+
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        free(work_str);
+        break;
+      }
+      case 'M': {
+        free(o_touch);
+        o_touch = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_touch);
+        char *strtok_context;
+        char *touch_bytes_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(touch_bytes_str != NULL);
+        CPRT_ATOI(touch_bytes_str, touch_bytes);
+        working_set_bytes = touch_bytes;
+
+        char *working_set_bytes_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        if (working_set_bytes_str != NULL) {
+          CPRT_ATOI(working_set_bytes_str, working_set_bytes);
+        }
+
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        free(work_str);
+        break;
+      }
       case 'p':
         free(o_persist_mode);
         o_persist_mode = CPRT_STRDUP(cprt_optarg);
@@ -118,17 +237,52 @@ void get_my_opts(int argc, char **argv)
         } else {
           FATAL_ERROR("-p value must be '', 'r', or 's'");
         }
+        break;
       case 'R':
         free(o_rcv_thread);
         o_rcv_thread = CPRT_STRDUP(cprt_optarg);
         if (strcasecmp(o_rcv_thread, "") == 0) {
           rcv_thread = MAIN_CTX;
-        } else if (strcasecmp(o_rcv_thread, "x") == 0) {
+          num_xsps = 0;
+        } else if (strncasecmp(o_rcv_thread, "x", 1) == 0) {
           rcv_thread = XSP;
+          num_xsps = 1;
+          if (o_rcv_thread[1] == ':') {
+            CPRT_ATOI(&o_rcv_thread[2], num_xsps);
+          } else if (o_rcv_thread[1] != '\0') {
+            FATAL_ERROR("-R value must be '', 'x', or 'x:N'\n");
+          }
+          ASSRT(num_xsps >= 1 && num_xsps <= MAX_XSPS);
         } else {
-          FATAL_ERROR("-R value must be '' or 'x'\n");
+          FATAL_ERROR("-R value must be '', 'x', or 'x:N'\n");
         }
         break;
+      case 'S': {
+        free(o_sequential);
+        o_sequential = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_sequential);
+        char *strtok_context;
+        char *seq_timeout_ms_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(seq_timeout_ms_str != NULL);
+        CPRT_ATOI(seq_timeout_ms_str, seq_timeout_ms);
+        ASSRT(seq_timeout_ms >= 0);
+        sequential = 1;
+
+        char *seq_spin_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        if (seq_spin_str == NULL) {
+          seq_spin = SEQ_NO_SPIN;
+        } else if (strcasecmp(seq_spin_str, "p") == 0) {
+          seq_spin = SEQ_PAUSE;
+        } else if (strcasecmp(seq_spin_str, "y") == 0) {
+          seq_spin = SEQ_YIELD;
+        } else {
+          FATAL_ERROR("-S seq_spin must be '', 'p', or 'y'\n");
+        }
+
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        free(work_str);
+        break;
+      }
       case 's':
         free(o_spin_method);
         o_spin_method = CPRT_STRDUP(cprt_optarg);
@@ -140,11 +294,48 @@ void get_my_opts(int argc, char **argv)
           FATAL_ERROR("-s value must be '' or 'f'\n");
         }
         break;
+      case 'T': CPRT_ATOI(cprt_optarg, o_num_topics); break;
+      case 't':
+        free(o_time_source);
+        o_time_source = CPRT_STRDUP(cprt_optarg);
+        if (strcasecmp(o_time_source, "") == 0) {
+          use_tsc = 0;
+        } else if (strcasecmp(o_time_source, "t") == 0) {
+          use_tsc = 1;
+        } else {
+          FATAL_ERROR("-t value must be '' or 't'\n");
+        }
+        break;
+      case 'w': {
+        free(o_work);
+        o_work = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_work);
+        char *strtok_context;
+        char *work_ns_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(work_ns_str != NULL);
+        CPRT_ATOI(work_ns_str, work_ns);
+
+        char *work_dist_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        if (work_dist_str == NULL) {
+          work_dist = WORK_FIXED;
+        } else if (strcasecmp(work_dist_str, "e") == 0) {
+          work_dist = WORK_EXPONENTIAL;
+        } else if (strcasecmp(work_dist_str, "u") == 0) {
+          work_dist = WORK_UNIFORM;
+        } else {
+          FATAL_ERROR("-w work_dist must be '', 'e', or 'u'\n");
+        }
+
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        free(work_str);
+        break;
+      }
       case 'x':
         free(o_xml_config);
         o_xml_config = CPRT_STRDUP(cprt_optarg);
         /* Don't read it now since app_name might not be set yet. */
         break;
+      case 'Z': CPRT_ATOI(cprt_optarg, o_reflect_buffs); break;
       default:
         fprintf(stderr, "um_lat_pong: ERROR: unrecognized option '%c'\nUse '-h' for help\n", opt);
         exit(1);
@@ -152,6 +343,28 @@ void get_my_opts(int argc, char **argv)
   }  /* while getopt */
 
   ASSRT(cprt_optind == argc);  /* No further command-line parameters allowed. */
+  ASSRT(o_num_topics >= 1 && o_num_topics <= MAX_TOPICS);
+  ASSRT(hist_sig_digits >= 1 && hist_sig_digits <= 5);
+  ASSRT(hist_max_sec >= 1);
+  ASSRT(touch_bytes <= working_set_bytes);
+  ASSRT(o_reflect_buffs >= 0 && o_reflect_buffs <= MAX_REFLECT_BUFFS);
+  if (handoff != NO_HANDOFF) {
+    ASSRT(num_xsps <= 1);  /* The handoff ring has a single producer. */
+  }
+  if (o_fan_in) {
+    /* Fan-in pingers' sessions would be spread across XSPs, but all share
+     * one reflector, which is not thread-safe. */
+    ASSRT(num_xsps <= 1);
+  }
+  if (o_reflect_buffs > 0 && o_generic_src) {
+    FATAL_ERROR("-Z requires Smart Source (not -g)\n");
+  }
+
+  /* The first TSC selection calibrates it (about 50 ms) if it is invariant. */
+  if (use_tsc && ! cprt_tsc_select(1)) {
+    printf("WARNING: TSC is not invariant, using CLOCK_MONOTONIC\n");
+    use_tsc = 0;
+  }
 
   /* Waited to read xml config (if any) so that app_name is set up right. */
   if (strlen(o_xml_config) > 0) {
@@ -228,18 +441,78 @@ int src_event_cb(lbm_src_t *src, int event, void *extra_data, void *client_data)
 }  /* src_event_cb */
 
 
+/* Sequential mode (-S): application threads run the UM event loops of the
+ * context and each XSP, instead of UM's own threads. */
+struct event_thread_s {
+  lbm_context_t *ctx;  /* Exactly one of ctx and xsp is set. */
+  lbm_xsp_t *xsp;
+  int affinity;  /* -1=none. */
+  int running;
+  CPRT_THREAD_T thread_id;
+};
+struct event_thread_s event_threads[MAX_XSPS + 1];
+int num_event_threads = 0;
+
+CPRT_THREAD_ENTRYPOINT event_thread(void *in_arg)
+{
+  struct event_thread_s *et = (struct event_thread_s *)in_arg;
+
+  if (et->affinity > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(et->affinity, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+
+  while (__atomic_load_n(&et->running, __ATOMIC_ACQUIRE)) {
+    if (et->xsp != NULL) {
+      E(lbm_xsp_process_events(et->xsp, seq_timeout_ms));
+    }
+    else {
+      E(lbm_context_process_events(et->ctx, seq_timeout_ms));
+    }
+    if (seq_spin == SEQ_PAUSE) {
+      CPRT_CPU_PAUSE();
+    }
+    else if (seq_spin == SEQ_YIELD) {
+      CPRT_YIELD();
+    }
+  }
+
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* event_thread */
+
+
+void event_thread_start(lbm_context_t *ctx, lbm_xsp_t *xsp, int affinity)
+{
+  ASSRT(num_event_threads < MAX_XSPS + 1);
+  struct event_thread_s *et = &event_threads[num_event_threads];
+  et->ctx = ctx;
+  et->xsp = xsp;
+  et->affinity = affinity;
+  et->running = 1;
+  CPRT_THREAD_CREATE(et->thread_id, event_thread, et);
+  num_event_threads++;
+}  /* event_thread_start */
+
+
 lbm_context_t *my_ctx = NULL;
-lbm_xsp_t *my_xsp = NULL;
+lbm_xsp_t *my_xsps[MAX_XSPS];
+int next_xsp = 0;  /* Only accessed by the context thread. */
 
 void create_context()
 {
   /* Create UM context. */
   lbm_context_attr_t *ctx_attr;
   E(lbm_context_attr_create(&ctx_attr));
+  if (sequential) {
+    E(lbm_context_attr_str_setopt(ctx_attr, "operational_mode", "sequential"));
+  }
 
   lbm_transport_mapping_func_t mapping_func;
   if (rcv_thread == XSP) {
-    /* Set all receive transport sessions to my_xsp. */
+    /* Spread receive transport sessions across my_xsps. */
     mapping_func.mapping_func = my_xsp_mapper_callback;
     mapping_func.clientd = NULL;
     E(lbm_context_attr_setopt(ctx_attr,
@@ -258,10 +531,18 @@ void create_context()
   /* Context thread inherits the initial CPU set of the process. */
   E(lbm_context_create(&my_ctx, ctx_attr, NULL, NULL));
   E(lbm_context_attr_delete(ctx_attr));
+  if (sequential) {
+    /* Without XSPs, the context thread is the receive thread. */
+    event_thread_start(my_ctx, NULL, (rcv_thread == XSP) ? -1 : o_affinity_rcv);
+  }
 
-  if (rcv_thread == XSP) {
+  int i;
+  for (i = 0; i < num_xsps; i++) {
     /* Xsp in use; create a fresh context attr (can't re-use parent's). */
     E(lbm_context_attr_create(&ctx_attr));
+    if (sequential) {
+      E(lbm_context_attr_str_setopt(ctx_attr, "operational_mode", "sequential"));
+    }
     /* Main context will host receivers; set desired options. */
     E(lbm_context_attr_str_setopt(ctx_attr,
         "ume_session_id", "0x7"));  /* Pong uses session ID 7. */
@@ -270,93 +551,592 @@ void create_context()
           "file_descriptor_management_behavior", "busy_wait"));
     }
 
-    E(lbm_xsp_create(&my_xsp, my_ctx, ctx_attr, NULL));
+    E(lbm_xsp_create(&my_xsps[i], my_ctx, ctx_attr, NULL));
     E(lbm_context_attr_delete(ctx_attr));
+    if (sequential) {
+      event_thread_start(NULL, my_xsps[i], (o_affinity_rcv > -1) ? o_affinity_rcv + i : -1);
+    }
   }
 
 }  /* create_context */
 
 
-lbm_src_t *src;  /* Used if o_generic_src is 1. */
-lbm_ssrc_t *ssrc;  /* Used if o_generic_src is 0. */
-char *ssrc_buff;
-
-void create_source(lbm_context_t *ctx)
+/* One reflector per ping sender thread (-T): messages received on
+ * "topic1" are reflected to "topic2", "topic1.N" to "topic2.N". All
+ * receivers are serviced by the same receive thread. */
+struct reflector_s {
+  char rcv_topic[32];
+  char src_topic[32];
+  lbm_src_t *src;  /* Used if o_generic_src is 1. */
+  lbm_ssrc_t *ssrc;  /* Used if o_generic_src is 0. */
+  char *ssrc_buff;
+  lbm_rcv_t *rcv;
+  /* Used if o_reflect_buffs > 0. */
+  char *ssrc_buffs[MAX_REFLECT_BUFFS];
+  size_t ssrc_buff_lens[MAX_REFLECT_BUFFS];  /* Length last fully copied. */
+  int cur_buff;
+  /* Generic src copy of message, for timestamps. A topic's messages are
+   * always reflected by the same thread (one session per topic, or -F
+   * without XSPs). */
+  char *reflect_buf;
+  size_t reflect_buf_len;
+};
+struct reflector_s reflectors[MAX_TOPICS];
+
+void create_source(lbm_context_t *ctx, struct reflector_s *reflector)
 {
   lbm_src_topic_attr_t *src_attr;
   lbm_topic_t *topic_obj;
 
   /* Set some options in code. */
   E(lbm_src_topic_attr_create(&src_attr));
+  if (o_reflect_buffs > 0) {
+    char buff_count[16];
+    snprintf(buff_count, sizeof(buff_count), "%d", o_reflect_buffs);
+    E(lbm_src_topic_attr_str_setopt(src_attr, "smart_src_user_buffer_count", buff_count));
+  }
 
-  /* The "pong" program sends messages to "topic2". */
-  E(lbm_src_topic_alloc(&topic_obj, ctx, "topic2", src_attr));
+  /* The "pong" program sends messages to "topic2" (and "topic2.N"). */
+  E(lbm_src_topic_alloc(&topic_obj, ctx, reflector->src_topic, src_attr));
   if (o_generic_src) {
-    E(lbm_src_create(&src, ctx, topic_obj,
+    E(lbm_src_create(&reflector->src, ctx, topic_obj,
         src_event_cb, NULL, NULL));
   }
   else {  /* Smart Src API. */
-    E(lbm_ssrc_create(&ssrc, ctx, topic_obj,
+    E(lbm_ssrc_create(&reflector->ssrc, ctx, topic_obj,
         ssrc_event_cb, NULL, NULL));
-    E(lbm_ssrc_buff_get(ssrc, &ssrc_buff, 0));
+    E(lbm_ssrc_buff_get(reflector->ssrc, &reflector->ssrc_buff, 0));
+    if (o_reflect_buffs > 0) {
+      int i;
+      reflector->ssrc_buffs[0] = reflector->ssrc_buff;
+      for (i = 1; i < o_reflect_buffs; i++) {
+        E(lbm_ssrc_buff_get(reflector->ssrc, &reflector->ssrc_buffs[i], 0));
+      }
+      /* Lengths of 0 force a full copy the first time each is used. */
+      memset(reflector->ssrc_buff_lens, 0, sizeof(reflector->ssrc_buff_lens));
+      reflector->cur_buff = 0;
+    }
   }
 
   E(lbm_src_topic_attr_delete(src_attr));
 }  /* create_source */
 
 
-lbm_rcv_t *my_rcv;
+/* Fan-in (-F): any number of pingers can send to a topic. Each source
+ * gets its own slot through the receiver's source notification callback,
+ * so the receive path finds it via msg->source_clientd. A source's messages
+ * are always delivered by the same receive thread. */
+struct CPRT_CACHE_ALIGN source_s {
+  int id;
+  char source[LBM_MSG_MAX_SOURCE_LEN];
+  char topic[32];
+  uint64_t num_rcv_msgs;
+  uint64_t num_rx_msgs;
+  uint64_t num_unrec_loss;
+  uint64_t num_measured;  /* Messages with a send timestamp (not warmup). */
+  struct timespec first_rcv_ts;  /* Of the measured messages. */
+  struct timespec last_rcv_ts;
+  int64_t min_delay_ns;  /* Smallest receive minus send time so far. */
+  hist_t *backlog_hist;
+};
+struct source_s sources[MAX_SOURCES];
+int num_sources = 0;
+
+
+void *source_create_cb(const char *source_name, void *clientd)
+{
+  struct reflector_s *reflector = (struct reflector_s *)clientd;
+  int id = __atomic_fetch_add(&num_sources, 1, __ATOMIC_ACQ_REL);
+  ASSRT(id < MAX_SOURCES);
+  struct source_s *source = &sources[id];
+  source->id = id;
+  strncpy(source->source, source_name, sizeof(source->source) - 1);
+  strncpy(source->topic, reflector->rcv_topic, sizeof(source->topic) - 1);
+  source->backlog_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  return source;
+}  /* source_create_cb */
+
+
+int source_delete_cb(const char *source_name, void *clientd, void *source_clientd)
+{
+  return 0;  /* Keep the slot; its stats are printed at the last EOS. */
+}  /* source_delete_cb */
+
+
+/* Track a message from a fan-in source. The backlog is how much longer
+ * this message took from ping's send to this callback than the quickest
+ * message from the same source so far. Taking the difference cancels the
+ * clock offset between the hosts and the network time, leaving the time
+ * the message waited behind other pingers' messages. */
+void source_rcv(struct source_s *source, lbm_msg_t *msg, struct timespec *rcv_ts)
+{
+  perf_msg_t *perf_msg = (perf_msg_t *)msg->data;
+
+  source->num_rcv_msgs++;
+  if ((msg->flags & LBM_MSG_FLAG_RETRANSMIT) == LBM_MSG_FLAG_RETRANSMIT) {
+    source->num_rx_msgs++;
+  }
+  if (perf_msg->send_ts.tv_sec == 0) {
+    return;  /* Warmup. */
+  }
+
+  int64_t delay_ns = (int64_t)(TS_TO_NS(*rcv_ts) - TS_TO_NS(perf_msg->send_ts));
+  if (source->num_measured == 0) {
+    source->first_rcv_ts = *rcv_ts;
+    source->min_delay_ns = delay_ns;
+  }
+  else if (delay_ns < source->min_delay_ns) {
+    source->min_delay_ns = delay_ns;
+  }
+  source->num_measured++;
+  source->last_rcv_ts = *rcv_ts;
+  hist_input(source->backlog_hist, (uint64_t)(delay_ns - source->min_delay_ns));
+}  /* source_rcv */
+
+
+/* Called at the last EOS with -F. */
+void fan_in_print()
+{
+  char *name = "backlog_ns";
+  hist_t *backlog_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  double total_rate = 0.0;
+  uint64_t total_rcv_msgs = 0;
+  int n = __atomic_load_n(&num_sources, __ATOMIC_ACQUIRE);
+  int i;
+
+  for (i = 0; i < n; i++) {
+    struct source_s *source = &sources[i];
+    double rate = 0.0;
+    uint64_t duration_ns;
+    CPRT_DIFF_TS(duration_ns, source->last_rcv_ts, source->first_rcv_ts);
+    if (source->num_measured > 1 && duration_ns > 0) {
+      rate = (double)(source->num_measured - 1) * 1000000000.0 / (double)duration_ns;
+    }
+    total_rate += rate;
+    total_rcv_msgs += source->num_rcv_msgs;
+    hist_merge(backlog_hist, source->backlog_hist);
+
+    /* Leave "comma space" at end of line to make parsing output easier. */
+    printf("Source: id=%d, topic=%s, source=%s, num_rcv_msgs=%"PRIu64", num_rx_msgs=%"PRIu64", num_unrec_loss=%"PRIu64", rate=%.0f, backlog_p50=%"PRId64", backlog_p99=%"PRId64", backlog_p99.9=%"PRId64", backlog_max=%"PRId64", \n",
+        source->id, source->topic, source->source, source->num_rcv_msgs,
+        source->num_rx_msgs, source->num_unrec_loss, rate,
+        hist_percentile(source->backlog_hist, 50.0),
+        hist_percentile(source->backlog_hist, 99.0),
+        hist_percentile(source->backlog_hist, 99.9),
+        hist_percentile(source->backlog_hist, 100.0));
+  }
+
+  printf("FanIn: num_sources=%d, num_rcv_msgs=%"PRIu64", total_rate=%.0f, \n",
+      n, total_rcv_msgs, total_rate);
+  hist_print_compare("FanIn:", 1, &backlog_hist, &name);
+  hist_delete(backlog_hist);
+}  /* fan_in_print */
 
-void create_receiver(lbm_context_t *ctx)
+
+void create_receiver(lbm_context_t *ctx, struct reflector_s *reflector)
 {
   lbm_rcv_topic_attr_t *rcv_attr;
   E(lbm_rcv_topic_attr_create(&rcv_attr));
+  if (o_fan_in) {
+    lbm_rcv_src_notification_func_t source_notification;
+    source_notification.create_func = source_create_cb;
+    source_notification.delete_func = source_delete_cb;
+    source_notification.clientd = reflector;
+    E(lbm_rcv_topic_attr_setopt(rcv_attr, "source_notification_function",
+        &source_notification, sizeof(source_notification)));
+  }
 
   /* Receive messages from ping. */
   lbm_topic_t *topic_obj;
-  E(lbm_rcv_topic_lookup(&topic_obj, my_ctx, "topic1", rcv_attr));
-  E(lbm_rcv_create(&my_rcv, my_ctx, topic_obj, my_rcv_cb, NULL, NULL));
+  E(lbm_rcv_topic_lookup(&topic_obj, ctx, reflector->rcv_topic, rcv_attr));
+  E(lbm_rcv_create(&reflector->rcv, ctx, topic_obj, my_rcv_cb, reflector, NULL));
+  E(lbm_rcv_topic_attr_delete(rcv_attr));
 }  /* create_receiver */
 
 
-uint64_t num_rcv_msgs;
-uint64_t num_rx_msgs;
-uint64_t num_unrec_loss;
-uint64_t num_sent;
+uint64_t *work_ns_table = NULL;  /* Busy-wait time per message (-w). */
+int num_eos = 0;
+
+/* Statistics and working state of each thread that receives or reflects
+ * messages (the context thread or one per XSP, plus the reflector thread
+ * with -D). Each thread claims a slot the first time it needs one. */
+struct CPRT_CACHE_ALIGN rcv_thread_s {
+  int id;
+  int ready;  /* Set (release) once the slot is set up. */
+  uint64_t num_rcv_msgs;
+  uint64_t num_rx_msgs;
+  uint64_t num_unrec_loss;
+  uint64_t num_sent;
+  hist_t *service_hist;  /* Start of processing to reflect completion. */
+  int work_index;
+  char *working_set;  /* Written by -M. */
+  uint64_t touch_offset;
+};
+struct rcv_thread_s rcv_threads[MAX_RCV_THREADS];
+int num_rcv_threads = 0;
+__thread struct rcv_thread_s *cur_rcv_thread = NULL;
+
+
+/* Return the calling thread's slot, claiming one on first use. */
+struct rcv_thread_s *rcv_thread_get()
+{
+  if (cur_rcv_thread == NULL) {
+    int id = __atomic_fetch_add(&num_rcv_threads, 1, __ATOMIC_RELAXED);
+    ASSRT(id < MAX_RCV_THREADS);
+    struct rcv_thread_s *rt = &rcv_threads[id];
+    rt->id = id;
+    rt->service_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+    if (working_set_bytes > 0) {
+      rt->working_set = (char *)malloc(working_set_bytes);
+      ASSRT(rt->working_set != NULL);
+      memset(rt->working_set, 0, working_set_bytes);  /* Map the pages now. */
+    }
+    __atomic_store_n(&rt->ready, 1, __ATOMIC_RELEASE);
+    cur_rcv_thread = rt;
+  }
+  return cur_rcv_thread;
+}  /* rcv_thread_get */
+
+
+/* Pre-compute the busy-wait times so the distribution's math is not in the
+ * time-critical path. Fixed seed so that runs are repeatable. */
+void work_table_create()
+{
+  unsigned short xsubi[3] = { 0x1234, 0x5678, 0x9abc };
+  int i;
+
+  work_ns_table = (uint64_t *)malloc(WORK_TABLE_SIZE * sizeof(uint64_t));
+  ASSRT(work_ns_table != NULL);
+  for (i = 0; i < WORK_TABLE_SIZE; i++) {
+    switch (work_dist) {
+    case WORK_FIXED:
+      work_ns_table[i] = work_ns;
+      break;
+    case WORK_EXPONENTIAL:
+      work_ns_table[i] = (uint64_t)(-log(1.0 - erand48(xsubi)) * (double)work_ns);
+      break;
+    case WORK_UNIFORM:
+      work_ns_table[i] = (uint64_t)(erand48(xsubi) * 2.0 * (double)work_ns);
+      break;
+    }
+  }
+}  /* work_table_create */
+
+
+/* Synthetic per-message work (-M, -w), done before reflecting. */
+void do_work(struct rcv_thread_s *rt)
+{
+  if (touch_bytes > 0) {
+    /* Write one byte per cache line, carrying on where the previous message
+     * left off so that a large working set cycles through the caches. */
+    uint64_t touched;
+    for (touched = 0; touched < touch_bytes; touched += 64) {
+      rt->working_set[rt->touch_offset]++;
+      rt->touch_offset += 64;
+      if (rt->touch_offset >= working_set_bytes) {
+        rt->touch_offset = 0;
+      }
+    }
+  }
+
+  if (work_ns > 0) {
+    uint64_t spin_ns = work_ns_table[rt->work_index];
+    rt->work_index = (rt->work_index + 1) & (WORK_TABLE_SIZE - 1);
+    struct timespec start_ts, now_ts;
+    uint64_t elapsed_ns;
+    CPRT_GETTIME(&start_ts);
+    do {
+      CPRT_GETTIME(&now_ts);
+      CPRT_DIFF_TS(elapsed_ns, now_ts, start_ts);
+    } while (elapsed_ns < spin_ns);
+  }
+}  /* do_work */
+
+
+/* Called at the last EOS. Merges the threads' service times and, with more
+ * than one thread, prints a line per thread. */
+void service_print()
+{
+  char *name = "service_ns";
+  hist_t *service_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  int i;
+
+  for (i = 0; i < MAX_RCV_THREADS; i++) {
+    struct rcv_thread_s *rt = &rcv_threads[i];
+    if (! __atomic_load_n(&rt->ready, __ATOMIC_ACQUIRE)) {
+      continue;
+    }
+    hist_merge(service_hist, rt->service_hist);
+    if (num_rcv_threads > 1) {
+      /* Leave "comma space" at end of line to make parsing output easier. */
+      printf("RcvThread: id=%d, num_rcv_msgs=%"PRIu64", num_rx_msgs=%"PRIu64", num_unrec_loss=%"PRIu64", num_sent=%"PRIu64", service_p50=%"PRId64", service_p99=%"PRId64", service_max=%"PRId64", \n",
+          rt->id, rt->num_rcv_msgs, rt->num_rx_msgs, rt->num_unrec_loss,
+          rt->num_sent, hist_percentile(rt->service_hist, 50.0),
+          hist_percentile(rt->service_hist, 99.0),
+          hist_percentile(rt->service_hist, 100.0));
+    }
+  }
+
+  printf("Service: num_samples=%"PRIu64", hist_overflows=%"PRIu64", work_ns=%"PRIu64", work_dist=%d, touch_bytes=%"PRIu64", working_set_bytes=%"PRIu64", \n",
+      service_hist->num_samples, service_hist->overflows, work_ns, work_dist,
+      touch_bytes, working_set_bytes);
+  hist_print_compare("Service:", 1, &service_hist, &name);
+  hist_delete(service_hist);
+}  /* service_print */
+
+/* Messages handed from the receive callback to the reflector thread (-D). */
+struct handoff_entry_s {
+  lbm_msg_t *msg;  /* Retained by the receive callback; NULL=reset stats (BOS). */
+  struct reflector_s *reflector;
+  struct timespec rcv_ts;
+};
+/* Single producer (receive callback), single consumer (reflector thread).
+ * Each side's index is on its own cache line along with its cached copy of
+ * the other side's index, so the line holding the other side's index is
+ * only read when the ring looks full (producer) or empty (consumer). */
+struct handoff_ring_s {
+  CPRT_CACHE_ALIGN uint64_t head;  /* Next slot to fill. */
+  uint64_t tail_cache;  /* Producer's last look at "tail". */
+  uint64_t num_full;  /* Times the producer had to wait for room. */
+  CPRT_CACHE_ALIGN uint64_t tail;  /* Next slot to reflect. */
+  uint64_t head_cache;  /* Consumer's last look at "head". */
+  CPRT_CACHE_ALIGN struct handoff_entry_s entries[HANDOFF_RING_SIZE];
+};
+struct handoff_ring_s handoff_ring;
+CPRT_THREAD_T reflector_thread_id;
+
+
+/* Send a received message back to ping. If "handoff_ts" is not NULL, the
+ * message went through the handoff ring and this is when it was taken. */
+void reflect_msg(struct reflector_s *reflector, lbm_msg_t *msg,
+    struct timespec *rcv_ts, struct timespec *handoff_ts)
+{
+  /* If ping left room, tell it when we received and reflected the
+   * message so it can split up the round trip. */
+  int fill_timestamps = PERF_MSG_HAS(msg->len, pong_send_ts);
+  int fill_handoff = (handoff_ts != NULL && PERF_MSG_HAS(msg->len, pong_handoff_ts));
+  /* Service time starts when this thread gets the message. */
+  struct timespec start_ts = (handoff_ts != NULL) ? *handoff_ts : *rcv_ts;
+  struct rcv_thread_s *rt = rcv_thread_get();
+
+  if (touch_bytes > 0 || work_ns > 0) {
+    do_work(rt);
+  }
+
+  if (o_generic_src) {
+    const char *send_data = msg->data;
+    if (fill_timestamps) {
+      if (msg->len > reflector->reflect_buf_len) {  /* Only grows on first message. */
+        free(reflector->reflect_buf);
+        reflector->reflect_buf = (char *)malloc(msg->len);
+        ASSRT(reflector->reflect_buf != NULL);
+        reflector->reflect_buf_len = msg->len;
+      }
+      memcpy(reflector->reflect_buf, msg->data, msg->len);
+      perf_msg_t *perf_msg = (perf_msg_t *)reflector->reflect_buf;
+      perf_msg->pong_rcv_ts = *rcv_ts;
+      if (fill_handoff) {
+        perf_msg->pong_handoff_ts = *handoff_ts;
+      }
+      CPRT_GETTIME(&perf_msg->pong_send_ts);
+      send_data = reflector->reflect_buf;
+    }
+    /* Send message. */
+    int e = lbm_src_send(reflector->src, send_data, msg->len, LBM_SRC_NONBLOCK);
+    if (e == -1) {
+      printf("num_sent=%"PRIu64", max_flight_size=%d\n", rt->num_sent, max_flight_size);
+    }
+    E(e);  /* If error, print message and fail. */
+  }
+  else {  /* Smart Src API. */
+    char *buff = reflector->ssrc_buff;
+    if (o_reflect_buffs > 0) {
+      /* Header-only reflection. Ping's payload past the header never
+       * changes, so a buffer that already holds a message of this length
+       * only needs the header rewritten. */
+      int b = reflector->cur_buff;
+      reflector->cur_buff = (b + 1 == o_reflect_buffs) ? 0 : b + 1;
+      buff = reflector->ssrc_buffs[b];
+      if (reflector->ssrc_buff_lens[b] == msg->len && msg->len > REFLECT_HDR_LEN) {
+        memcpy(buff, msg->data, REFLECT_HDR_LEN);
+      }
+      else {
+        memcpy(buff, msg->data, msg->len);
+        reflector->ssrc_buff_lens[b] = msg->len;
+      }
+    }
+    else {
+      memcpy(buff, msg->data, msg->len);
+    }
+    if (fill_timestamps) {
+      perf_msg_t *perf_msg = (perf_msg_t *)buff;
+      perf_msg->pong_rcv_ts = *rcv_ts;
+      if (fill_handoff) {
+        perf_msg->pong_handoff_ts = *handoff_ts;
+      }
+      CPRT_GETTIME(&perf_msg->pong_send_ts);
+    }
+    /* Send message and get next buffer from shared memory. */
+    int e = lbm_ssrc_send_ex(reflector->ssrc, buff, msg->len, 0, NULL);
+    if (e == -1) {
+      printf("num_sent=%"PRIu64", max_flight_size=%d\n", rt->num_sent, max_flight_size);
+    }
+    E(e);  /* If error, print message and fail. */
+  }
+  rt->num_sent++;
+  int cur = __sync_fetch_and_add(&cur_flight_size, 1);
+  if (cur > max_flight_size) {
+    max_flight_size = cur;
+  }
+
+  struct timespec done_ts;
+  uint64_t ns_service;
+  CPRT_GETTIME(&done_ts);
+  CPRT_DIFF_TS(ns_service, done_ts, start_ts);
+  hist_input(rt->service_hist, ns_service);
+}  /* reflect_msg */
+
+
+/* Called by the receive callback (the only producer). */
+void handoff_push(struct reflector_s *reflector, lbm_msg_t *msg, struct timespec *rcv_ts)
+{
+  struct handoff_ring_s *ring = &handoff_ring;
+  uint64_t head = ring->head;  /* Only this thread writes it. */
+
+  if (head - ring->tail_cache >= HANDOFF_RING_SIZE) {
+    ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - ring->tail_cache >= HANDOFF_RING_SIZE) {
+      /* Reflector is behind; hold up the receive thread until it catches up. */
+      ring->num_full++;
+      do {
+        CPRT_CPU_PAUSE();
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+      } while (head - ring->tail_cache >= HANDOFF_RING_SIZE);
+    }
+  }
+
+  struct handoff_entry_s *entry = &ring->entries[head & (HANDOFF_RING_SIZE - 1)];
+  entry->msg = msg;
+  entry->reflector = reflector;
+  entry->rcv_ts = *rcv_ts;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}  /* handoff_push */
+
+
+/* The only consumer of the handoff ring; never returns. */
+CPRT_THREAD_ENTRYPOINT reflector_thread(void *in_arg)
+{
+  struct handoff_ring_s *ring = &handoff_ring;
+  uint64_t tail = 0;
+
+  if (o_affinity_reflector > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(o_affinity_reflector, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+  (void)rcv_thread_get();  /* Claim a slot before the first message. */
+
+  while (1) {
+    if (tail == ring->head_cache) {
+      /* Ring looks empty; wait for the receive callback. */
+      while ((ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) == tail) {
+        if (handoff == HANDOFF_PAUSE) {
+          CPRT_CPU_PAUSE();
+        }
+        else if (handoff == HANDOFF_YIELD) {
+          CPRT_YIELD();
+        }
+      }
+    }
+
+    struct handoff_entry_s *entry = &ring->entries[tail & (HANDOFF_RING_SIZE - 1)];
+    if (entry->msg == NULL) {
+      /* BOS: in ring order, so it falls between the old and new messages. */
+      struct rcv_thread_s *rt = rcv_thread_get();
+      rt->num_sent = 0;
+      hist_init(rt->service_hist);
+    }
+    else {
+      struct timespec handoff_ts;
+      CPRT_GETTIME(&handoff_ts);
+      reflect_msg(entry->reflector, entry->msg, &entry->rcv_ts, &handoff_ts);
+      lbm_msg_delete(entry->msg);
+    }
+
+    tail++;
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+  }
+
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* reflector_thread */
+
 
 /* UM callback for receiver events, including received messages. */
 int my_rcv_cb(lbm_rcv_t *rcv, lbm_msg_t *msg, void *clientd)
 {
+  struct timespec rcv_ts;
+  CPRT_GETTIME(&rcv_ts);
+  struct rcv_thread_s *rt = rcv_thread_get();
+
   switch (msg->type) {
   case LBM_MSG_BOS:
     /* Assume receive thread is calling this; pin the time-critical thread
      * to the requested CPU. */
-    if (o_affinity_rcv > -1) {
+    if (o_affinity_rcv > -1 && ! sequential) {  /* -S threads pin themselves. */
       uint64_t cpuset;
       CPRT_CPU_ZERO(&cpuset);
-      CPRT_CPU_SET(o_affinity_rcv, &cpuset);
+      CPRT_CPU_SET(o_affinity_rcv + rt->id, &cpuset);
       cprt_set_affinity(cpuset);
     }
 
-    num_rcv_msgs = 0;
-    num_rx_msgs = 0;
-    num_unrec_loss = 0;
-    num_sent = 0;
-    printf("rcv event BOS, topic_name='%s', source=%s, \n",
-      msg->topic_name, msg->source);
+    if (! o_fan_in) {  /* With -F, other pingers may already be running. */
+      rt->num_rcv_msgs = 0;
+      rt->num_rx_msgs = 0;
+      rt->num_unrec_loss = 0;
+      rt->num_sent = 0;
+      hist_init(rt->service_hist);
+      if (handoff != NO_HANDOFF) {
+        /* The reflector thread owns its slot; have it reset its own. */
+        handoff_push(NULL, NULL, &rcv_ts);
+      }
+    }
+    printf("rcv event BOS, topic_name='%s', source=%s, rcv_thread_id=%d, \n",
+      msg->topic_name, msg->source, rt->id);
     fflush(stdout);
     break;
 
   case LBM_MSG_EOS:
-    printf("rcv event EOS, '%s', %s, num_rcv_msgs=%"PRIu64", num_rx_msgs=%"PRIu64", num_unrec_loss=%"PRIu64", max_flight_size=%d\n",
-        msg->topic_name, msg->source, num_rcv_msgs, num_rx_msgs, num_unrec_loss, max_flight_size);
+  {
+    printf("rcv event EOS, '%s', %s, rcv_thread_id=%d, num_rcv_msgs=%"PRIu64", num_rx_msgs=%"PRIu64", num_unrec_loss=%"PRIu64", max_flight_size=%d, handoff_num_full=%"PRIu64"\n",
+        msg->topic_name, msg->source, rt->id, rt->num_rcv_msgs, rt->num_rx_msgs,
+        rt->num_unrec_loss, max_flight_size, handoff_ring.num_full);
+    /* Report (and exit) once every topic has ended; with -F, once every
+     * source that joined has ended. */
+    int eos_count = __atomic_add_fetch(&num_eos, 1, __ATOMIC_ACQ_REL);
+    int last_eos = (eos_count == o_num_topics);
+    if (o_fan_in) {
+      last_eos = (eos_count >= o_num_topics &&
+          eos_count == __atomic_load_n(&num_sources, __ATOMIC_ACQUIRE));
+    }
+    if (last_eos) {
+      if (! o_fan_in) {
+        __atomic_store_n(&num_eos, 0, __ATOMIC_RELEASE);  /* Ready for the next ping. */
+      }
+      service_print();
+      if (o_fan_in) {
+        fan_in_print();
+      }
+    }
     fflush(stdout);
 
-    if (o_exit_on_eos) {
+    if (o_exit_on_eos && last_eos) {
       CPRT_NET_CLEANUP;
       exit(0);
     }
     break;
+  }
 
   case LBM_MSG_UME_REGISTRATION_ERROR:
   {
@@ -367,38 +1147,31 @@ int my_rcv_cb(lbm_rcv_t *rcv, lbm_msg_t *msg, void *clientd)
 
   case LBM_MSG_UNRECOVERABLE_LOSS:
   {
-    num_unrec_loss++;
+    rt->num_unrec_loss++;
+    if (msg->source_clientd != NULL) {
+      ((struct source_s *)msg->source_clientd)->num_unrec_loss++;
+    }
     break;
   }
 
   case LBM_MSG_DATA:
   {
-    num_rcv_msgs++;
+    struct reflector_s *reflector = (struct reflector_s *)clientd;
+    rt->num_rcv_msgs++;
+    if (msg->source_clientd != NULL) {
+      source_rcv((struct source_s *)msg->source_clientd, msg, &rcv_ts);
+    }
     if ((msg->flags & LBM_MSG_FLAG_RETRANSMIT) == LBM_MSG_FLAG_RETRANSMIT) {
-      num_rx_msgs++;
+      rt->num_rx_msgs++;
     }
 
-    if (o_generic_src) {
-      /* Send message. */
-      int e = lbm_src_send(src, (void *)msg->data, msg->len, LBM_SRC_NONBLOCK);
-      if (e == -1) {
-        printf("num_sent=%"PRIu64", max_flight_size=%d\n", num_sent, max_flight_size);
-      }
-      E(e);  /* If error, print message and fail. */
-    }
-    else {  /* Smart Src API. */
-      memcpy(ssrc_buff, msg->data, msg->len);
-      /* Send message and get next buffer from shared memory. */
-      int e = lbm_ssrc_send_ex(ssrc, ssrc_buff, msg->len, 0, NULL);
-      if (e == -1) {
-        printf("num_sent=%"PRIu64", max_flight_size=%d\n", num_sent, max_flight_size);
-      }
-      E(e);  /* If error, print message and fail. */
+    if (handoff == NO_HANDOFF) {
+      reflect_msg(reflector, msg, &rcv_ts, NULL);
     }
-    num_sent++;
-    int cur = __sync_fetch_and_add(&cur_flight_size, 1);
-    if (cur > max_flight_size) {
-      max_flight_size = cur;
+    else {
+      /* The reflector thread deletes the message after reflecting it. */
+      lbm_msg_retain(msg);
+      handoff_push(reflector, msg, &rcv_ts);
     }
 
     break;
@@ -412,9 +1185,13 @@ int my_rcv_cb(lbm_rcv_t *rcv, lbm_msg_t *msg, void *clientd)
 }  /* my_rcv_cb */
 
 
+/* Called by the context thread for each new receive transport session. */
 lbm_xsp_t *my_xsp_mapper_callback(lbm_context_t *ctx, lbm_new_transport_info_t *transp_info, void *clientd)
 {
-  return my_xsp;
+  /* Round-robin, in the order the sessions are joined. */
+  lbm_xsp_t *xsp = my_xsps[next_xsp];
+  next_xsp = (next_xsp + 1) % num_xsps;
+  return xsp;
 }  /* my_xsp_mapper_callback */
 
 
@@ -434,19 +1211,40 @@ int main(int argc, char **argv)
   /* Set up callback for UM log messages. */
   E(lbm_log(my_logger_cb, NULL));
 
+  CPRT_INITTIME();
+
   get_my_opts(argc, argv);
 
-  printf("o_affinity_rcv=%d, o_config=%s, o_exit_on_eos=%d, o_generic_src=%d, o_persist_mode='%s', o_rcv_thread='%s', o_spin_method='%s', o_xml_config=%s, \n",
-      o_affinity_rcv, o_config, o_exit_on_eos, o_generic_src, o_persist_mode,
-      o_rcv_thread, o_spin_method, o_xml_config);
-  printf("app_name='%s', persist_mode=%d, spin_method=%d, \n",
-      app_name, persist_mode, spin_method);
+  printf("o_affinity_reflector=%d, o_affinity_rcv=%d, o_config=%s, o_handoff='%s', o_exit_on_eos=%d, o_fan_in=%d, o_generic_src=%d, o_histogram=%s, o_touch=%s, o_persist_mode='%s', o_rcv_thread='%s', o_spin_method='%s', o_sequential='%s', o_num_topics=%d, o_time_source='%s', o_work=%s, o_xml_config=%s, o_reflect_buffs=%d, \n",
+      o_affinity_reflector, o_affinity_rcv, o_config, o_handoff, o_exit_on_eos, o_fan_in, o_generic_src, o_histogram, o_touch, o_persist_mode,
+      o_rcv_thread, o_spin_method, o_sequential, o_num_topics, o_time_source, o_work, o_xml_config,
+      o_reflect_buffs);
+  printf("app_name='%s', persist_mode=%d, spin_method=%d, handoff=%d, use_tsc=%d, tsc_ghz=%f, \n",
+      app_name, persist_mode, spin_method, handoff, use_tsc, cprt_tsc_ghz());
 
-  create_context();
+  work_table_create();
+
+  if (handoff != NO_HANDOFF) {
+    memset(&handoff_ring, 0, sizeof(handoff_ring));
+    CPRT_THREAD_CREATE(reflector_thread_id, reflector_thread, NULL);
+  }
 
-  create_source(my_ctx);
+  create_context();
 
-  create_receiver(my_ctx);
+  int i;
+  for (i = 0; i < o_num_topics; i++) {
+    struct reflector_s *reflector = &reflectors[i];
+    if (i == 0) {
+      strcpy(reflector->rcv_topic, "topic1");
+      strcpy(reflector->src_topic, "topic2");
+    }
+    else {
+      snprintf(reflector->rcv_topic, sizeof(reflector->rcv_topic), "topic1.%d", i);
+      snprintf(reflector->src_topic, sizeof(reflector->src_topic), "topic2.%d", i);
+    }
+    create_source(my_ctx, reflector);
+    create_receiver(my_ctx, reflector);
+  }
 
   /* The subscriber must be "kill"ed externally. */
   CPRT_SLEEP_SEC(2000000000);  /* 23+ centuries. */
@@ -0,0 +1,260 @@
+/* um_lat_proc.c - per-CPU counters from /proc, for um_lat_jitter.
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#include "cprt.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "um_lat.h"
+#include "um_lat_proc.h"
+
+
+/* Return the whole file as a string (caller frees), or NULL. Files in /proc
+ * don't have a size, so read until EOF. */
+static char *proc_file_read(char *path)
+{
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return NULL;
+  }
+  size_t buf_size = 64 * 1024;
+  size_t len = 0;
+  char *buf = (char *)malloc(buf_size);
+  ASSRT(buf != NULL);
+  size_t n;
+  while ((n = fread(&buf[len], 1, buf_size - len - 1, fp)) > 0) {
+    len += n;
+    if (len == buf_size - 1) {
+      buf_size *= 2;
+      buf = (char *)realloc(buf, buf_size);
+      ASSRT(buf != NULL);
+    }
+  }
+  fclose(fp);
+  buf[len] = '\0';
+
+  return buf;
+}  /* proc_file_read */
+
+
+/* Copy at most "len" chars of "src" into "dst" (of size "dst_size"). */
+static void proc_copy(char *dst, size_t dst_size, char *src, size_t len)
+{
+  if (len > dst_size - 1) {
+    len = dst_size - 1;
+  }
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+}  /* proc_copy */
+
+
+proc_counts_t *proc_counts_read(char *path)
+{
+  char *text = proc_file_read(path);
+  if (text == NULL) {
+    return NULL;
+  }
+
+  /* The header line names the column of each (online) CPU: "CPU0 CPU1 ...". */
+  int col_cpu[1024];
+  int num_cols = 0;
+  int num_cpus = 0;
+  char *line = text;
+  char *line_end = strchr(line, '\n');
+  ASSRT(line_end != NULL);
+  *line_end = '\0';
+  char *p = line;
+  while ((p = strstr(p, "CPU")) != NULL && num_cols < 1024) {
+    p += 3;
+    col_cpu[num_cols] = atoi(p);
+    if (col_cpu[num_cols] + 1 > num_cpus) {
+      num_cpus = col_cpu[num_cols] + 1;
+    }
+    num_cols++;
+  }
+
+  proc_counts_t *counts = (proc_counts_t *)malloc(sizeof(proc_counts_t));
+  ASSRT(counts != NULL);
+  counts->num_cpus = num_cpus;
+  counts->num_rows = 0;
+
+  /* Each row: "name: count count ... [description]". Some rows (e.g. "ERR")
+   * have only one count. */
+  line = line_end + 1;
+  while (*line != '\0' && counts->num_rows < PROC_MAX_ROWS) {
+    line_end = strchr(line, '\n');
+    if (line_end != NULL) {
+      *line_end = '\0';
+    }
+    while (isspace(*line)) line++;
+    char *colon = strchr(line, ':');
+    if (colon != NULL) {
+      struct proc_row_s *row = &counts->rows[counts->num_rows];
+      proc_copy(row->name, sizeof(row->name), line, colon - line);
+      row->counts = (uint64_t *)calloc(num_cpus, sizeof(uint64_t));
+      ASSRT(row->counts != NULL);
+
+      p = colon + 1;
+      int col;
+      for (col = 0; col < num_cols; col++) {
+        while (*p == ' ') p++;
+        if (! isdigit(*p)) {
+          break;
+        }
+        row->counts[col_cpu[col]] = strtoull(p, &p, 10);
+      }
+      while (isspace(*p)) p++;
+      proc_copy(row->desc, sizeof(row->desc), p, strlen(p));
+      counts->num_rows++;
+    }
+    if (line_end == NULL) {
+      break;
+    }
+    line = line_end + 1;
+  }
+
+  free(text);
+  return counts;
+}  /* proc_counts_read */
+
+
+void proc_counts_delete(proc_counts_t *counts)
+{
+  int r;
+  for (r = 0; r < counts->num_rows; r++) {
+    free(counts->rows[r].counts);
+  }
+  free(counts);
+}  /* proc_counts_delete */
+
+
+void proc_counts_print_delta(char *label, proc_counts_t *before, proc_counts_t *after, int cpu)
+{
+  int r;
+
+  if (cpu >= before->num_cpus || cpu >= after->num_cpus) {
+    return;  /* CPU went on-line during the test. */
+  }
+  for (r = 0; r < after->num_rows; r++) {
+    struct proc_row_s *row = &after->rows[r];
+    /* Rows are normally in the same order, but IRQs can come and go. */
+    struct proc_row_s *before_row = NULL;
+    if (r < before->num_rows && strcmp(before->rows[r].name, row->name) == 0) {
+      before_row = &before->rows[r];
+    }
+    else {
+      int b;
+      for (b = 0; b < before->num_rows; b++) {
+        if (strcmp(before->rows[b].name, row->name) == 0) {
+          before_row = &before->rows[b];
+          break;
+        }
+      }
+    }
+    uint64_t count = row->counts[cpu];
+    if (before_row != NULL) {
+      count -= before_row->counts[cpu];
+    }
+    if (count > 0) {
+      /* Leave "comma space" at end of line to make parsing output easier. */
+      printf("%s cpu=%d, name=%s, count=%"PRIu64", desc='%s', \n",
+          label, cpu, row->name, count, row->desc);
+    }
+  }
+}  /* proc_counts_print_delta */
+
+
+proc_schedstat_t *proc_schedstat_read()
+{
+  char *text = proc_file_read("/proc/schedstat");
+  if (text == NULL) {
+    return NULL;
+  }
+
+  /* Per-CPU lines: "cpuN yld_count 0 sched_count sched_goidle ttwu_count
+   * ttwu_local run_time_ns run_delay_ns timeslices" (schedstat version 15). */
+  int num_cpus = 0;
+  char *p = text;
+  while ((p = strstr(p, "\ncpu")) != NULL) {
+    p += 4;
+    if (isdigit(*p) && atoi(p) + 1 > num_cpus) {
+      num_cpus = atoi(p) + 1;
+    }
+  }
+
+  proc_schedstat_t *sched = (proc_schedstat_t *)malloc(sizeof(proc_schedstat_t));
+  ASSRT(sched != NULL);
+  sched->num_cpus = num_cpus;
+  sched->present = (int *)calloc(num_cpus + 1, sizeof(int));
+  ASSRT(sched->present != NULL);
+  sched->fields = calloc(num_cpus + 1, sizeof(sched->fields[0]));
+  ASSRT(sched->fields != NULL);
+
+  p = text;
+  while ((p = strstr(p, "\ncpu")) != NULL) {
+    p += 4;
+    if (! isdigit(*p)) {
+      continue;
+    }
+    int cpu = (int)strtol(p, &p, 10);
+    int f;
+    for (f = 0; f < PROC_SCHEDSTAT_FIELDS; f++) {
+      while (*p == ' ') p++;
+      if (! isdigit(*p)) {
+        break;
+      }
+      sched->fields[cpu][f] = strtoull(p, &p, 10);
+    }
+    sched->present[cpu] = 1;
+  }
+
+  free(text);
+  return sched;
+}  /* proc_schedstat_read */
+
+
+void proc_schedstat_delete(proc_schedstat_t *sched)
+{
+  free(sched->present);
+  free(sched->fields);
+  free(sched);
+}  /* proc_schedstat_delete */
+
+
+void proc_schedstat_print_delta(proc_schedstat_t *before, proc_schedstat_t *after, int cpu)
+{
+  uint64_t delta[PROC_SCHEDSTAT_FIELDS];
+  int f;
+
+  if (cpu >= before->num_cpus || cpu >= after->num_cpus ||
+      ! before->present[cpu] || ! after->present[cpu]) {
+    return;
+  }
+  for (f = 0; f < PROC_SCHEDSTAT_FIELDS; f++) {
+    delta[f] = after->fields[cpu][f] - before->fields[cpu][f];
+  }
+  /* Leave "comma space" at end of line to make parsing output easier. */
+  printf("Schedstat: cpu=%d, sched_count=%"PRIu64", sched_goidle=%"PRIu64", ttwu_count=%"PRIu64", ttwu_local=%"PRIu64", run_time_ns=%"PRIu64", run_delay_ns=%"PRIu64", timeslices=%"PRIu64", \n",
+      cpu, delta[2], delta[3], delta[4], delta[5], delta[6], delta[7], delta[8]);
+}  /* proc_schedstat_print_delta */
@@ -0,0 +1,70 @@
+/* um_lat_proc.h - per-CPU counters from /proc, for um_lat_jitter.
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#ifndef UM_LAT_PROC_H
+#define UM_LAT_PROC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+
+/* A snapshot of /proc/interrupts or /proc/softirqs. Each row is an IRQ
+ * line (or softirq type) with one count per CPU. */
+#define PROC_MAX_ROWS 1024
+struct proc_row_s {
+  char name[32];  /* E.g. "LOC" or "TIMER". */
+  char desc[80];  /* Rest of the line (interrupts only). */
+  uint64_t *counts;  /* Indexed by CPU number. */
+};
+struct proc_counts_s {
+  int num_cpus;  /* Highest CPU number + 1. */
+  int num_rows;
+  struct proc_row_s rows[PROC_MAX_ROWS];
+};
+typedef struct proc_counts_s proc_counts_t;
+
+/* A snapshot of /proc/schedstat's per-CPU lines. */
+#define PROC_SCHEDSTAT_FIELDS 9
+struct proc_schedstat_s {
+  int num_cpus;  /* Highest CPU number + 1. */
+  int *present;  /* Indexed by CPU number. */
+  uint64_t (*fields)[PROC_SCHEDSTAT_FIELDS];
+};
+typedef struct proc_schedstat_s proc_schedstat_t;
+
+/* The read functions return NULL if the file can't be read. */
+proc_counts_t *proc_counts_read(char *path);
+void proc_counts_delete(proc_counts_t *counts);
+/* Print each row whose count on "cpu" changed. */
+void proc_counts_print_delta(char *label, proc_counts_t *before, proc_counts_t *after, int cpu);
+
+proc_schedstat_t *proc_schedstat_read();
+void proc_schedstat_delete(proc_schedstat_t *sched);
+void proc_schedstat_print_delta(proc_schedstat_t *before, proc_schedstat_t *after, int cpu);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  /* UM_LAT_PROC_H */
@@ -0,0 +1,229 @@
+/* um_lat_shm.c - shared-memory rings for um_lat_shm_ping and um_lat_shm_pong.
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#include "cprt.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "um_lat.h"
+#include "um_lat_shm.h"
+
+
+enum shm_wait_method_enum shm_wait_method_parse(char *method_str)
+{
+  if (strcasecmp(method_str, "") == 0) {
+    return SHM_WAIT_FUTEX;
+  } else if (strcasecmp(method_str, "s") == 0) {
+    return SHM_WAIT_SPIN;
+  } else if (strcasecmp(method_str, "p") == 0) {
+    return SHM_WAIT_PAUSE;
+  }
+  FATAL_ERROR("-s value must be '', 's', or 'p'");
+  return SHM_WAIT_FUTEX;
+}  /* shm_wait_method_parse */
+
+
+char *shm_wait_method_name(enum shm_wait_method_enum method)
+{
+  switch (method) {
+    case SHM_WAIT_FUTEX: return "futex";
+    case SHM_WAIT_SPIN: return "spin";
+    case SHM_WAIT_PAUSE: return "pause";
+  }
+  return "?";
+}  /* shm_wait_method_name */
+
+
+static shm_seg_t *shm_seg_map(char *name, int create)
+{
+  char path[256];
+  snprintf(path, sizeof(path), "/%s", name);
+
+  int fd = shm_open(path, create ? (O_RDWR | O_CREAT) : O_RDWR, 0666);
+  if (fd == -1) {
+    return NULL;  /* Not created yet. */
+  }
+  if (create) {
+    CPRT_EOK0(ftruncate(fd, sizeof(shm_seg_t)));
+  }
+  else {
+    struct stat st;
+    CPRT_EOK0(fstat(fd, &st));
+    if (st.st_size < (off_t)sizeof(shm_seg_t)) {
+      close(fd);
+      return NULL;  /* Being created. */
+    }
+  }
+
+  shm_seg_t *seg = (shm_seg_t *)mmap(NULL, sizeof(shm_seg_t),
+      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ASSRT(seg != MAP_FAILED);
+  close(fd);
+
+  return seg;
+}  /* shm_seg_map */
+
+
+shm_seg_t *shm_seg_create(char *name)
+{
+  shm_seg_t *seg = shm_seg_map(name, 1);
+  ASSRT(seg != NULL);
+
+  /* Start clean, even if the segment is left over from an earlier run. */
+  __atomic_store_n(&seg->magic, 0, __ATOMIC_RELEASE);
+  memset(seg, 0, sizeof(shm_seg_t));
+  __atomic_store_n(&seg->magic, SHM_SEG_MAGIC, __ATOMIC_RELEASE);
+
+  return seg;
+}  /* shm_seg_create */
+
+
+shm_seg_t *shm_seg_open(char *name)
+{
+  shm_seg_t *seg;
+  int waits = 0;
+
+  while ((seg = shm_seg_map(name, 0)) == NULL ||
+      __atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != SHM_SEG_MAGIC) {
+    if (seg != NULL) {
+      shm_seg_close(seg);
+    }
+    if (waits++ % 10 == 0) {
+      printf("Waiting for pong to create '%s'.\n", name);
+      fflush(stdout);
+    }
+    CPRT_SLEEP_MS(100);
+  }
+
+  return seg;
+}  /* shm_seg_open */
+
+
+void shm_seg_close(shm_seg_t *seg)
+{
+  munmap(seg, sizeof(shm_seg_t));
+}  /* shm_seg_close */
+
+
+void shm_seg_unlink(char *name)
+{
+  char path[256];
+  snprintf(path, sizeof(path), "/%s", name);
+  shm_unlink(path);
+}  /* shm_seg_unlink */
+
+
+void shm_ring_consumer_init(shm_ring_t *ring, enum shm_wait_method_enum method)
+{
+  __atomic_store_n(&ring->consumer_futex, (method == SHM_WAIT_FUTEX), __ATOMIC_RELEASE);
+}  /* shm_ring_consumer_init */
+
+
+void shm_ring_send(shm_ring_t *ring, int mpsc, uint32_t producer, void *data, size_t len)
+{
+  uint64_t pos;
+
+  ASSRT(len <= SHM_MAX_MSG_LEN);
+  if (mpsc) {
+    pos = __atomic_fetch_add(&ring->tail, 1, __ATOMIC_RELAXED);
+  }
+  else {
+    pos = ring->tail;  /* Only this thread writes it. */
+    __atomic_store_n(&ring->tail, pos + 1, __ATOMIC_RELAXED);
+  }
+
+  /* Wait for the consumer to free the slot. */
+  while (pos - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= SHM_RING_SLOTS) {
+    CPRT_CPU_PAUSE();
+  }
+
+  struct shm_slot_s *slot = &ring->slots[pos & (SHM_RING_SLOTS - 1)];
+  slot->len = (uint32_t)len;
+  slot->producer = producer;
+  memcpy(slot->data, data, len);
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+  if (__atomic_load_n(&ring->consumer_futex, __ATOMIC_RELAXED)) {
+    /* Either the consumer sees the message before it sleeps, or this
+     * sees that it is sleeping. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_RELAXED)) {
+      __atomic_add_fetch(&ring->futex_word, 1, __ATOMIC_RELEASE);
+      syscall(SYS_futex, &ring->futex_word, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+  }
+}  /* shm_ring_send */
+
+
+ssize_t shm_ring_rcv(shm_ring_t *ring, enum shm_wait_method_enum method,
+    void *buf, size_t buf_len, uint32_t *producer, int *running)
+{
+  uint64_t pos = ring->head;  /* Only this thread writes it. */
+  struct shm_slot_s *slot = &ring->slots[pos & (SHM_RING_SLOTS - 1)];
+
+  while (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+    if (! __atomic_load_n(running, __ATOMIC_RELAXED)) {
+      return -1;
+    }
+    if (method == SHM_WAIT_PAUSE) {
+      CPRT_CPU_PAUSE();
+    }
+    else if (method == SHM_WAIT_FUTEX) {
+      uint32_t futex_val = __atomic_load_n(&ring->futex_word, __ATOMIC_ACQUIRE);
+      __atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+        /* Wake up periodically to check for shutdown. */
+        struct timespec timeout_ts;
+        timeout_ts.tv_sec = 0;
+        timeout_ts.tv_nsec = 100000000;
+        int e = syscall(SYS_futex, &ring->futex_word, FUTEX_WAIT, futex_val, &timeout_ts, NULL, 0);
+        if (e == -1 && errno == ETIMEDOUT) {
+          __atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+          return -1;
+        }
+      }
+      __atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+    }
+  }
+
+  size_t len = slot->len;
+  if (len > buf_len) {
+    len = buf_len;
+  }
+  memcpy(buf, slot->data, len);
+  if (producer != NULL) {
+    *producer = slot->producer;
+  }
+  __atomic_store_n(&ring->head, pos + 1, __ATOMIC_RELEASE);
+
+  return (ssize_t)len;
+}  /* shm_ring_rcv */
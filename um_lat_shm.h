@@ -0,0 +1,101 @@
+/* um_lat_shm.h - shared-memory rings for um_lat_shm_ping and um_lat_shm_pong.
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#ifndef UM_LAT_SHM_H
+#define UM_LAT_SHM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+#include <sys/types.h>
+#include "cprt.h"
+
+/* A ring is an array of fixed-size slots, each holding one message. A slot
+ * is published by writing its "seq" (ring position + 1) last, so the
+ * consumer needs nothing but the slot itself. The producers' index (tail)
+ * and the consumer's index (head) are each in their own cache line.
+ * With one producer (SPSC), the tail is private to it; with several
+ * (MPSC), each message's position is reserved with an atomic add.
+ * A producer waits (spins) while the ring is full. */
+#define SHM_RING_SLOTS 1024  /* Power of 2. */
+#define SHM_SLOT_SIZE 1024
+#define SHM_MAX_MSG_LEN (SHM_SLOT_SIZE - 16)
+
+/* How a consumer waits for a message. */
+enum shm_wait_method_enum {
+  SHM_WAIT_FUTEX,  /* Sleep on a futex; the producer wakes it. */
+  SHM_WAIT_SPIN,  /* Busy loop. */
+  SHM_WAIT_PAUSE  /* Busy loop with the CPU's pause instruction. */
+};
+
+struct shm_slot_s {
+  uint64_t seq;  /* Ring position + 1 once the message is written. */
+  uint32_t len;
+  uint32_t producer;  /* Producer's id (e.g. ping's sender thread). */
+  char data[SHM_MAX_MSG_LEN];
+};
+
+struct shm_ring_s {
+  CPRT_CACHE_ALIGN uint64_t tail;  /* Next position to write (producers). */
+  CPRT_CACHE_ALIGN uint64_t head;  /* Next position to read (consumer). */
+  CPRT_CACHE_ALIGN uint32_t futex_word;  /* Bumped by a producer to wake. */
+  uint32_t consumer_waiting;  /* Set while the consumer (futex) sleeps. */
+  uint32_t consumer_futex;  /* Consumer uses SHM_WAIT_FUTEX. */
+  CPRT_CACHE_ALIGN struct shm_slot_s slots[SHM_RING_SLOTS];
+};
+typedef struct shm_ring_s shm_ring_t;
+
+/* The segment shared by ping and pong: ping's senders to pong (request),
+ * and pong to ping's receive thread (reply). */
+#define SHM_SEG_MAGIC 0x554d4c53  /* "UMLS" */
+struct shm_seg_s {
+  uint32_t magic;  /* Set by pong once the rings are initialized. */
+  CPRT_CACHE_ALIGN shm_ring_t request;
+  CPRT_CACHE_ALIGN shm_ring_t reply;
+};
+typedef struct shm_seg_s shm_seg_t;
+
+/* Parse a -s option: '' (empty)=futex, 's'=spin, 'p'=spin with pause. */
+enum shm_wait_method_enum shm_wait_method_parse(char *method_str);
+char *shm_wait_method_name(enum shm_wait_method_enum method);
+
+/* Pong creates (or re-initializes) the segment; ping waits for it. */
+shm_seg_t *shm_seg_create(char *name);
+shm_seg_t *shm_seg_open(char *name);
+void shm_seg_close(shm_seg_t *seg);
+/* Pong removes the name on exit so a later ping waits for a new pong. */
+void shm_seg_unlink(char *name);
+
+void shm_ring_consumer_init(shm_ring_t *ring, enum shm_wait_method_enum method);
+void shm_ring_send(shm_ring_t *ring, int mpsc, uint32_t producer, void *data, size_t len);
+/* Returns the message's length, or -1 if there was none within about
+ * 100 ms or "*running" was cleared (so the caller can check for shutdown). */
+ssize_t shm_ring_rcv(shm_ring_t *ring, enum shm_wait_method_enum method,
+    void *buf, size_t buf_len, uint32_t *producer, int *running);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  /* UM_LAT_SHM_H */
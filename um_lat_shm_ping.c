@@ -0,0 +1,483 @@
+/* um_lat_shm_ping.c - shared-memory version of um_lat_ping (no UM).
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#include "cprt.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "um_lat.h"
+#include "um_lat_hist.h"
+#include "um_lat_shm.h"
+
+
+/* Command-line options and their defaults. String defaults are set
+ * in "get_my_opts()".
+ */
+int o_affinity_src = -1;  /* -A */
+int o_affinity_rcv = -1;
+char *o_histogram = NULL;  /* -H */
+char *o_shm_name = NULL;  /* -k */
+int o_linger_ms = 1000;
+int o_mpsc = 0;  /* -M */
+int o_msg_len = 0;
+int o_num_msgs = 0;
+int o_rate = 0;
+char *o_wait_method = NULL;  /* -s */
+int o_num_threads = 1;  /* -T */
+char *o_time_source = NULL;  /* -t */
+char *o_warmup = NULL;
+
+/* Parameters parsed out from command-line options. */
+int hist_sig_digits = 2;
+int hist_max_sec = 60;
+enum shm_wait_method_enum wait_method = SHM_WAIT_FUTEX;
+int mpsc = 0;  /* Request ring has several producers (-T, -M). */
+int use_tsc = 0;
+int warmup_loops = 0;
+int warmup_rate = 0;
+
+/* Each sender thread (-T) is one of the request ring's producers. The
+ * fields written by the sending thread and those written by the receive
+ * thread are in separate cache lines. */
+#define MAX_SENDERS 64
+struct CPRT_CACHE_ALIGN sender_s {
+  int id;
+  char *msg_buf;
+  perf_msg_t *perf_msg;
+  CPRT_THREAD_T thread_id;
+
+  /* Written by the sending thread. */
+  CPRT_CACHE_ALIGN uint64_t next_seq;  /* Written to perf_msg->seq. */
+  int max_tight_sends;
+  int actual_sends;
+
+  /* Written by the receive thread. */
+  CPRT_CACHE_ALIGN uint64_t num_rcv_msgs;
+  uint64_t last_rcv_seq;
+};
+struct sender_s senders[MAX_SENDERS];
+
+/* Globals. */
+shm_seg_t *seg = NULL;
+CPRT_THREAD_T rcv_thread_id;
+int rcv_running = 0;
+int global_max_tight_sends = 0;
+hist_t *rtt_hist = NULL;
+hist_t *turnaround_hist = NULL;  /* Pong's receive to its reflect. */
+uint64_t num_rcv_msgs = 0;
+uint64_t num_seq_gaps = 0;  /* Messages skipped over in the seq sequence. */
+uint64_t num_seq_backward = 0;  /* Messages received out of seq order. */
+
+
+void help() {
+  fprintf(stderr, "Usage: um_lat_shm_ping [-h] [-A affinity_src] [-a affinity_rcv]\n  [-H hist_sig_digits,hist_max_sec] [-k shm_name] [-l linger_ms] [-M] -m msg_len\n  -n num_msgs -r rate [-s wait_method] [-T num_threads] [-t time_source]\n  [-w warmup_loops,warmup_rate]\n");
+  fprintf(stderr, "Where (those marked with 'R' are required):\n"
+      "  -h : print help\n"
+      "  -A affinity_src : CPU number (0..N-1) for send thread (-1=none);\n"
+      "       sender thread N uses affinity_src+N\n"
+      "  -a affinity_rcv : CPU number (0..N-1) for receive thread (-1=none)\n"
+      "  -H hist_sig_digits,hist_max_sec : round-trip time histogram precision and range\n"
+      "  -k shm_name : shared memory name, created by pong (default um_lat_shm)\n"
+      "  -l linger_ms : linger time before exit\n"
+      "  -M : multi-producer (MPSC) request ring even with one sender thread\n"
+      "R -m msg_len : message length (%d..%d)\n"
+      "R -n num_msgs : number of messages to send (per sender thread)\n"
+      "R -r rate : messages per second to send (per sender thread)\n"
+      "  -s wait_method : receive thread waits by '' (empty)=futex, 's'=spin,\n"
+      "       'p'=spin with pause\n"
+      "  -T num_threads : number of sender threads; more than 1 implies -M\n"
+      "  -t time_source : '' (empty)=CLOCK_MONOTONIC, 't'=invariant TSC\n"
+      "  -w warmup_loops,warmup_rate : messages to send before measurement\n",
+      (int)sizeof(struct timespec), SHM_MAX_MSG_LEN);
+  CPRT_NET_CLEANUP;
+  exit(0);
+}
+
+
+/* Process command-line options. */
+void get_my_opts(int argc, char **argv)
+{
+  int opt;  /* Loop variable for getopt(). */
+
+  /* Set defaults for string options. */
+  o_histogram = CPRT_STRDUP("2,60");
+  o_shm_name = CPRT_STRDUP("um_lat_shm");
+  o_wait_method = CPRT_STRDUP("");
+  o_time_source = CPRT_STRDUP("");
+  o_warmup = CPRT_STRDUP("0,0");
+
+  while ((opt = cprt_getopt(argc, argv, "hA:a:H:k:l:Mm:n:r:s:T:t:w:")) != EOF) {
+    switch (opt) {
+      case 'h': help(); break;
+      case 'A': CPRT_ATOI(cprt_optarg, o_affinity_src); break;
+      case 'a': CPRT_ATOI(cprt_optarg, o_affinity_rcv); break;
+      case 'H': {
+        free(o_histogram);
+        o_histogram = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_histogram);
+        char *strtok_context;
+        char *hist_sig_digits_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(hist_sig_digits_str != NULL);
+        CPRT_ATOI(hist_sig_digits_str, hist_sig_digits);
+
+        char *hist_max_sec_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        ASSRT(hist_max_sec_str != NULL);
+        CPRT_ATOI(hist_max_sec_str, hist_max_sec);
+
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        free(work_str);
+        break;
+      }
+      case 'k': free(o_shm_name); o_shm_name = CPRT_STRDUP(cprt_optarg); break;
+      case 'l': CPRT_ATOI(cprt_optarg, o_linger_ms); break;
+      case 'M': o_mpsc = 1; break;
+      case 'm': CPRT_ATOI(cprt_optarg, o_msg_len); break;
+      case 'n': CPRT_ATOI(cprt_optarg, o_num_msgs); break;
+      case 'r': CPRT_ATOI(cprt_optarg, o_rate); break;
+      case 's':
+        free(o_wait_method);
+        o_wait_method = CPRT_STRDUP(cprt_optarg);
+        wait_method = shm_wait_method_parse(o_wait_method);
+        break;
+      case 'T': CPRT_ATOI(cprt_optarg, o_num_threads); break;
+      case 't':
+        free(o_time_source);
+        o_time_source = CPRT_STRDUP(cprt_optarg);
+        if (strcasecmp(o_time_source, "") == 0) {
+          use_tsc = 0;
+        } else if (strcasecmp(o_time_source, "t") == 0) {
+          use_tsc = 1;
+        } else {
+          FATAL_ERROR("-t value must be '' or 't'\n");
+        }
+        break;
+      case 'w': {
+        free(o_warmup);
+        o_warmup = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_warmup);
+        char *strtok_context;
+        char *warmup_loops_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(warmup_loops_str != NULL);
+        CPRT_ATOI(warmup_loops_str, warmup_loops);
+
+        char *warmup_rate_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        ASSRT(warmup_rate_str != NULL);
+        CPRT_ATOI(warmup_rate_str, warmup_rate);
+
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        if (warmup_loops > 0) {
+          ASSRT(warmup_rate > 0);
+        }
+        free(work_str);
+        break;
+      }
+      default:
+        fprintf(stderr, "um_lat_shm_ping: ERROR: unrecognized option '%c'\nUse '-h' for help\n", opt);
+        exit(1);
+    }  /* switch opt */
+  }  /* while getopt */
+
+  ASSRT(cprt_optind == argc);  /* No further command-line parameters allowed. */
+
+  /* Shorter messages (no send_ts) are pong's end-of-test signal. */
+  ASSRT(o_msg_len >= (int)sizeof(struct timespec) && o_msg_len <= SHM_MAX_MSG_LEN);
+  ASSRT(o_num_msgs > 0);
+  ASSRT(o_rate > 0);
+  ASSRT(hist_sig_digits >= 1 && hist_sig_digits <= 5);
+  ASSRT(hist_max_sec > 0);
+  ASSRT(o_num_threads >= 1 && o_num_threads <= MAX_SENDERS);
+  mpsc = (o_mpsc || o_num_threads > 1);
+
+  /* The first TSC selection calibrates it (about 50 ms) if it is invariant. */
+  if (use_tsc && ! cprt_tsc_select(1)) {
+    printf("WARNING: TSC is not invariant, using CLOCK_MONOTONIC\n");
+    use_tsc = 0;
+  }
+}  /* get_my_opts */
+
+
+void send_one(struct sender_s *sender, int send_timestamp)
+{
+  perf_msg_t *perf_msg = sender->perf_msg;
+
+  if (PERF_MSG_HAS(o_msg_len, seq)) {
+    perf_msg->seq = sender->next_seq;
+  }
+  sender->next_seq++;
+
+  if (send_timestamp) {
+    CPRT_GETTIME(&(perf_msg->send_ts));
+  }
+  else {
+    perf_msg->send_ts.tv_sec = 0;
+    perf_msg->send_ts.tv_nsec = 0;
+  }
+
+  shm_ring_send(&seg->request, mpsc, sender->id, sender->msg_buf, o_msg_len);
+}  /* send_one */
+
+
+/* Same pacing as um_lat_ping's send_loop(): send evenly spaced at
+ * sends_per_sec, catching up with back-to-back sends when behind. */
+int send_loop(struct sender_s *sender, int num_sends, uint64_t sends_per_sec, int send_timestamp)
+{
+  struct timespec cur_ts;
+  struct timespec start_ts;
+
+  int max_tight_sends = 0;
+
+  /* Send messages evenly-spaced using busy looping. Based on algorithm:
+   * http://www.geeky-boy.com/catchup/html/ */
+  CPRT_GETTIME(&start_ts);
+  cur_ts = start_ts;
+  int num_sent = 0;
+  do {  /* while num_sent < num_sends */
+    uint64_t ns_so_far;
+    CPRT_DIFF_TS(ns_so_far, cur_ts, start_ts);
+    /* The +1 is because we want to send, then pause. */
+    int should_have_sent = (int)((ns_so_far * sends_per_sec)/1000000000 + 1);
+    if (should_have_sent > num_sends) {
+      should_have_sent = num_sends;  // Don't send more than requested.
+    }
+    if ((should_have_sent - num_sent) > max_tight_sends) {
+      max_tight_sends = should_have_sent - num_sent;
+    }
+
+    /* If we are behind where we should be, get caught up. */
+    while (num_sent < should_have_sent) {
+      send_one(sender, send_timestamp);
+      num_sent++;
+    }  /* while num_sent < should_have_sent */
+
+    CPRT_GETTIME(&cur_ts);
+  } while (num_sent < num_sends);
+
+  sender->max_tight_sends = max_tight_sends;
+
+  return num_sent;
+}  /* send_loop */
+
+
+static CPRT_THREAD_ENTRYPOINT sender_thread(void *in_arg)
+{
+  struct sender_s *sender = (struct sender_s *)in_arg;
+
+  if (o_affinity_src > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(o_affinity_src + sender->id, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+
+  sender->actual_sends = send_loop(sender, o_num_msgs, o_rate, 1);
+
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* sender_thread */
+
+
+static CPRT_THREAD_ENTRYPOINT rcv_thread(void *in_arg)
+{
+  char *rcv_buf = (char *)malloc(SHM_MAX_MSG_LEN);
+  ASSRT(rcv_buf != NULL);
+  perf_msg_t *rcv_perf_msg = (perf_msg_t *)rcv_buf;
+
+  if (o_affinity_rcv > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(o_affinity_rcv, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+
+  while (__atomic_load_n(&rcv_running, __ATOMIC_ACQUIRE)) {
+    uint32_t producer;
+    ssize_t len = shm_ring_rcv(&seg->reply, wait_method, rcv_buf, SHM_MAX_MSG_LEN,
+        &producer, &rcv_running);
+    if (len < (ssize_t)sizeof(struct timespec) || producer >= (uint32_t)o_num_threads) {
+      continue;  /* Timeout. */
+    }
+    struct timespec rcv_ts;
+    CPRT_GETTIME(&rcv_ts);
+    struct sender_s *sender = &senders[producer];
+
+    __atomic_store_n(&sender->num_rcv_msgs, sender->num_rcv_msgs + 1, __ATOMIC_RELAXED);
+
+    if (rcv_perf_msg->send_ts.tv_sec != 0) {
+      uint64_t ns_rtt;
+      CPRT_DIFF_TS(ns_rtt, rcv_ts, rcv_perf_msg->send_ts);
+      hist_input(rtt_hist, ns_rtt);
+
+      if (PERF_MSG_HAS(len, pong_send_ts)) {
+        uint64_t ns_turnaround;
+        CPRT_DIFF_TS(ns_turnaround, rcv_perf_msg->pong_send_ts, rcv_perf_msg->pong_rcv_ts);
+        hist_input(turnaround_hist, ns_turnaround);
+      }
+    }
+
+    if (PERF_MSG_HAS(len, seq)) {
+      uint64_t seq = rcv_perf_msg->seq;
+      if (seq > sender->last_rcv_seq + 1) {
+        num_seq_gaps += seq - sender->last_rcv_seq - 1;
+      }
+      if (seq <= sender->last_rcv_seq) {
+        num_seq_backward++;
+      }
+      else {
+        sender->last_rcv_seq = seq;
+      }
+    }
+  }
+
+  free(rcv_buf);
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* rcv_thread */
+
+
+int main(int argc, char **argv)
+{
+  struct timespec start_ts;  /* struct timespec is used by clock_gettime(). */
+  struct timespec end_ts;
+  uint64_t duration_ns;
+  int actual_sends;
+  double result_rate;
+  int i;
+
+  CPRT_NET_START;
+
+  CPRT_INITTIME();
+
+  get_my_opts(argc, argv);
+
+  /* Leave "comma space" at end of line to make parsing output easier. */
+  printf("o_affinity_src=%d, o_affinity_rcv=%d, o_histogram=%s, o_shm_name=%s, o_linger_ms=%d, o_mpsc=%d, o_msg_len=%d, o_num_msgs=%d, o_rate=%d, o_wait_method='%s', o_num_threads=%d, o_time_source='%s', o_warmup=%s, \n",
+      o_affinity_src, o_affinity_rcv, o_histogram, o_shm_name, o_linger_ms, o_mpsc, o_msg_len, o_num_msgs, o_rate, o_wait_method, o_num_threads, o_time_source, o_warmup);
+  printf("hist_sig_digits=%d, hist_max_sec=%d, wait_method=%s, mpsc=%d, use_tsc=%d, tsc_ghz=%f, warmup_loops=%d, warmup_rate=%d, \n",
+      hist_sig_digits, hist_max_sec, shm_wait_method_name(wait_method), mpsc, use_tsc, cprt_tsc_ghz(), warmup_loops, warmup_rate);
+  fflush(stdout);
+
+  rtt_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  turnaround_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+
+  for (i = 0; i < o_num_threads; i++) {
+    struct sender_s *sender = &senders[i];
+    sender->id = i;
+    sender->msg_buf = (char *)malloc(o_msg_len);
+    ASSRT(sender->msg_buf != NULL);
+    memset(sender->msg_buf, 0, o_msg_len);
+    sender->perf_msg = (perf_msg_t *)sender->msg_buf;
+    sender->next_seq = 1;
+  }
+
+  seg = shm_seg_open(o_shm_name);
+  shm_ring_consumer_init(&seg->reply, wait_method);
+  rcv_running = 1;
+  CPRT_THREAD_CREATE(rcv_thread_id, rcv_thread, NULL);
+
+  if (o_affinity_src > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(o_affinity_src, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+
+  if (warmup_loops > 0) {
+    /* Warmup loops to get CPU caches loaded. */
+    for (i = 0; i < o_num_threads; i++) {
+      send_loop(&senders[i], warmup_loops, warmup_rate, 0);
+    }
+    CPRT_SLEEP_MS(o_linger_ms);
+  }
+
+  /* Measure overall send rate by timing the main send loop. */
+  for (i = 0; i < o_num_threads; i++) {
+    struct sender_s *sender = &senders[i];
+    __atomic_store_n(&sender->num_rcv_msgs, 0, __ATOMIC_RELAXED);
+    sender->last_rcv_seq = sender->next_seq - 1;
+  }
+  CPRT_GETTIME(&start_ts);
+  if (o_num_threads == 1) {
+    senders[0].actual_sends = send_loop(&senders[0], o_num_msgs, o_rate, 1);
+  }
+  else {
+    for (i = 0; i < o_num_threads; i++) {
+      CPRT_THREAD_CREATE(senders[i].thread_id, sender_thread, &senders[i]);
+    }
+    for (i = 0; i < o_num_threads; i++) {
+      CPRT_THREAD_JOIN(senders[i].thread_id);
+    }
+  }
+  CPRT_GETTIME(&end_ts);
+  CPRT_DIFF_TS(duration_ns, end_ts, start_ts);
+
+  CPRT_SLEEP_MS(o_linger_ms);
+
+  __atomic_store_n(&rcv_running, 0, __ATOMIC_RELEASE);
+  CPRT_THREAD_JOIN(rcv_thread_id);
+
+  /* A zero-length message tells pong (-E) that the test is over. */
+  shm_ring_send(&seg->request, mpsc, 0, senders[0].msg_buf, 0);
+
+  actual_sends = 0;
+  for (i = 0; i < o_num_threads; i++) {
+    actual_sends += senders[i].actual_sends;
+    num_rcv_msgs += senders[i].num_rcv_msgs;
+    if (senders[i].max_tight_sends > global_max_tight_sends) {
+      global_max_tight_sends = senders[i].max_tight_sends;
+    }
+  }
+
+  result_rate = (double)(duration_ns);
+  result_rate /= (double)1000000000;
+  /* Don't count initial message. */
+  result_rate = (double)(actual_sends - 1) / result_rate;
+
+  hist_print(rtt_hist);
+  if (turnaround_hist->num_samples > 0) {
+    hist_t *hists[1];
+    char *names[1];
+    hists[0] = turnaround_hist; names[0] = "turnaround_ns";
+    printf("Legs: turnaround_num_samples=%"PRIu64", \n", turnaround_hist->num_samples);
+    hist_print_compare("Legs:", 1, hists, names);
+  }
+
+  /* Leave "comma space" at end of line to make parsing output easier. */
+  printf("actual_sends=%d, duration_ns=%"PRIu64", result_rate=%f, global_max_tight_sends=%d, \n",
+      actual_sends, duration_ns, result_rate, global_max_tight_sends);
+
+  printf("Rcv: num_rcv_msgs=%"PRIu64", num_seq_gaps=%"PRIu64", num_seq_backward=%"PRIu64", \n",
+      num_rcv_msgs, num_seq_gaps, num_seq_backward);
+
+  ASSRT(num_rcv_msgs == (uint64_t)actual_sends);
+
+  shm_seg_close(seg);
+  for (i = 0; i < o_num_threads; i++) {
+    free(senders[i].msg_buf);
+  }
+  hist_delete(rtt_hist);
+  hist_delete(turnaround_hist);
+
+  CPRT_NET_CLEANUP;
+  return 0;
+}  /* main */
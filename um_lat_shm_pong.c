@@ -0,0 +1,181 @@
+/* um_lat_shm_pong.c - shared-memory version of um_lat_pong (no UM).
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#include "cprt.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "um_lat.h"
+#include "um_lat_shm.h"
+
+
+/* Command-line options and their defaults. String defaults are set
+ * in "get_my_opts()".
+ */
+int o_affinity_rcv = -1;
+int o_exit_on_eos = 0;  /* -E */
+char *o_shm_name = NULL;  /* -k */
+char *o_wait_method = NULL;  /* -s */
+char *o_time_source = NULL;  /* -t */
+
+/* Parameters parsed out from command-line options. */
+enum shm_wait_method_enum wait_method = SHM_WAIT_FUTEX;
+int use_tsc = 0;
+
+/* Globals. */
+int running = 1;
+uint64_t num_rcv_msgs = 0;
+
+
+void help() {
+  fprintf(stderr, "Usage: um_lat_shm_pong [-h] [-a affinity_rcv] [-E] [-k shm_name]\n  [-s wait_method] [-t time_source]\n");
+  fprintf(stderr, "Where:\n"
+      "  -h : print help\n"
+      "  -a affinity_rcv : CPU number (0..N-1) for receive thread (-1=none)\n"
+      "  -E : exit when ping ends the test\n"
+      "  -k shm_name : shared memory name (default um_lat_shm)\n"
+      "  -s wait_method : '' (empty)=futex, 's'=spin, 'p'=spin with pause\n"
+      "  -t time_source : '' (empty)=CLOCK_MONOTONIC, 't'=invariant TSC\n");
+  CPRT_NET_CLEANUP;
+  exit(0);
+}
+
+
+/* Process command-line options. */
+void get_my_opts(int argc, char **argv)
+{
+  int opt;  /* Loop variable for getopt(). */
+
+  /* Set defaults for string options. */
+  o_shm_name = CPRT_STRDUP("um_lat_shm");
+  o_wait_method = CPRT_STRDUP("");
+  o_time_source = CPRT_STRDUP("");
+
+  while ((opt = cprt_getopt(argc, argv, "ha:Ek:s:t:")) != EOF) {
+    switch (opt) {
+      case 'h': help(); break;
+      case 'a': CPRT_ATOI(cprt_optarg, o_affinity_rcv); break;
+      case 'E': o_exit_on_eos = 1; break;
+      case 'k': free(o_shm_name); o_shm_name = CPRT_STRDUP(cprt_optarg); break;
+      case 's':
+        free(o_wait_method);
+        o_wait_method = CPRT_STRDUP(cprt_optarg);
+        wait_method = shm_wait_method_parse(o_wait_method);
+        break;
+      case 't':
+        free(o_time_source);
+        o_time_source = CPRT_STRDUP(cprt_optarg);
+        if (strcasecmp(o_time_source, "") == 0) {
+          use_tsc = 0;
+        } else if (strcasecmp(o_time_source, "t") == 0) {
+          use_tsc = 1;
+        } else {
+          FATAL_ERROR("-t value must be '' or 't'\n");
+        }
+        break;
+      default:
+        fprintf(stderr, "um_lat_shm_pong: ERROR: unrecognized option '%c'\nUse '-h' for help\n", opt);
+        exit(1);
+    }  /* switch opt */
+  }  /* while getopt */
+
+  ASSRT(cprt_optind == argc);  /* No further command-line parameters allowed. */
+
+  /* The first TSC selection calibrates it (about 50 ms) if it is invariant. */
+  if (use_tsc && ! cprt_tsc_select(1)) {
+    printf("WARNING: TSC is not invariant, using CLOCK_MONOTONIC\n");
+    use_tsc = 0;
+  }
+}  /* get_my_opts */
+
+
+int main(int argc, char **argv)
+{
+  CPRT_NET_START;
+
+  CPRT_INITTIME();
+
+  get_my_opts(argc, argv);
+
+  printf("o_affinity_rcv=%d, o_exit_on_eos=%d, o_shm_name=%s, o_wait_method='%s', o_time_source='%s', \n",
+      o_affinity_rcv, o_exit_on_eos, o_shm_name, o_wait_method, o_time_source);
+  printf("wait_method=%s, use_tsc=%d, tsc_ghz=%f, \n",
+      shm_wait_method_name(wait_method), use_tsc, cprt_tsc_ghz());
+  fflush(stdout);
+
+  char *msg_buf = (char *)malloc(SHM_MAX_MSG_LEN);
+  ASSRT(msg_buf != NULL);
+  perf_msg_t *perf_msg = (perf_msg_t *)msg_buf;
+
+  shm_seg_t *seg = shm_seg_create(o_shm_name);
+  shm_ring_consumer_init(&seg->request, wait_method);
+
+  /* The main thread is the receive thread. */
+  if (o_affinity_rcv > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(o_affinity_rcv, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+
+  while (running) {
+    uint32_t producer;
+    ssize_t len = shm_ring_rcv(&seg->request, wait_method, msg_buf, SHM_MAX_MSG_LEN,
+        &producer, &running);
+    if (len == -1) {
+      continue;  /* Timeout. */
+    }
+    struct timespec rcv_ts;
+    CPRT_GETTIME(&rcv_ts);
+
+    if (len < (ssize_t)sizeof(struct timespec)) {
+      /* Ping's end of test. */
+      printf("rcv end, num_rcv_msgs=%"PRIu64", \n", num_rcv_msgs);
+      fflush(stdout);
+      num_rcv_msgs = 0;
+      if (o_exit_on_eos) {
+        running = 0;
+      }
+      continue;
+    }
+    num_rcv_msgs++;
+
+    /* If ping left room, tell it when we received and reflected the
+     * message so it can split up the round trip. */
+    if (PERF_MSG_HAS(len, pong_send_ts)) {
+      perf_msg->pong_rcv_ts = rcv_ts;
+      CPRT_GETTIME(&perf_msg->pong_send_ts);
+    }
+    /* Pong is the reply ring's only producer. The reply goes back to the
+     * sender thread that sent the request. */
+    shm_ring_send(&seg->reply, 0, producer, msg_buf, len);
+  }
+
+  shm_seg_close(seg);
+  shm_seg_unlink(o_shm_name);
+  free(msg_buf);
+
+  CPRT_NET_CLEANUP;
+  return 0;
+}  /* main */
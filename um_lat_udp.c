@@ -0,0 +1,200 @@
+/* um_lat_udp.c - raw UDP sockets for um_lat_udp_ping and um_lat_udp_pong.
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#include "cprt.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <arpa/inet.h>
+
+#include "um_lat.h"
+#include "um_lat_udp.h"
+
+#define UDP_SOCK_BUF_SIZE (8 * 1024 * 1024)
+
+
+enum udp_rcv_method_enum udp_rcv_method_parse(char *method_str)
+{
+  if (strcasecmp(method_str, "") == 0) {
+    return UDP_RCV_BLOCKING;
+  } else if (strcasecmp(method_str, "s") == 0) {
+    return UDP_RCV_SPIN;
+  } else if (strcasecmp(method_str, "e") == 0) {
+    return UDP_RCV_EPOLL;
+  }
+  FATAL_ERROR("-s value must be '', 's', or 'e'");
+  return UDP_RCV_BLOCKING;
+}  /* udp_rcv_method_parse */
+
+
+char *udp_rcv_method_name(enum udp_rcv_method_enum method)
+{
+  switch (method) {
+    case UDP_RCV_BLOCKING: return "blocking";
+    case UDP_RCV_SPIN: return "spin";
+    case UDP_RCV_EPOLL: return "epoll";
+  }
+  return "?";
+}  /* udp_rcv_method_name */
+
+
+int udp_send_sock_create(struct in_addr iface)
+{
+  int sock = socket(PF_INET, SOCK_DGRAM, 0);
+  ASSRT(sock != -1);
+
+  CPRT_EOK0(setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF,
+      (char *)&iface, sizeof(iface)));
+  char ttl = 15;
+  CPRT_EOK0(setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL,
+      (char *)&ttl, sizeof(ttl)));
+  char loop = 1;  /* Ping and pong can be on the same host. */
+  CPRT_EOK0(setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP,
+      (char *)&loop, sizeof(loop)));
+  int buf_size = UDP_SOCK_BUF_SIZE;
+  CPRT_EOK0(setsockopt(sock, SOL_SOCKET, SO_SNDBUF,
+      (char *)&buf_size, sizeof(buf_size)));
+
+  return sock;
+}  /* udp_send_sock_create */
+
+
+udp_rcv_t *udp_rcv_create(struct in_addr group, struct in_addr iface, int port,
+    enum udp_rcv_method_enum method)
+{
+  udp_rcv_t *rcv = (udp_rcv_t *)malloc(sizeof(udp_rcv_t));
+  ASSRT(rcv != NULL);
+  memset(rcv, 0, sizeof(udp_rcv_t));
+  rcv->method = method;
+  rcv->epoll_fd = -1;
+
+  rcv->sock = socket(PF_INET, SOCK_DGRAM, 0);
+  ASSRT(rcv->sock != -1);
+
+  int opt = 1;
+  CPRT_EOK0(setsockopt(rcv->sock, SOL_SOCKET, SO_REUSEADDR,
+      (char *)&opt, sizeof(opt)));
+  opt = UDP_SOCK_BUF_SIZE;
+  CPRT_EOK0(setsockopt(rcv->sock, SOL_SOCKET, SO_RCVBUF,
+      (char *)&opt, sizeof(opt)));
+
+  struct sockaddr_in bind_sin;
+  memset(&bind_sin, 0, sizeof(bind_sin));
+  bind_sin.sin_family = AF_INET;
+  bind_sin.sin_addr.s_addr = htonl(INADDR_ANY);
+  bind_sin.sin_port = htons(port);
+  CPRT_EOK0(bind(rcv->sock, (struct sockaddr *)&bind_sin, sizeof(bind_sin)));
+
+  if (IN_MULTICAST(ntohl(group.s_addr))) {
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = group;
+    mreq.imr_interface = iface;
+    CPRT_EOK0(setsockopt(rcv->sock, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+        (char *)&mreq, sizeof(mreq)));
+  }
+
+  if (method == UDP_RCV_BLOCKING) {
+    /* Wake up periodically to check for shutdown. */
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 100000;
+    CPRT_EOK0(setsockopt(rcv->sock, SOL_SOCKET, SO_RCVTIMEO,
+        (char *)&tv, sizeof(tv)));
+  }
+  else if (method == UDP_RCV_EPOLL) {
+    struct epoll_event ev;
+    rcv->epoll_fd = epoll_create1(0);
+    ASSRT(rcv->epoll_fd != -1);
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = rcv->sock;
+    CPRT_EOK0(epoll_ctl(rcv->epoll_fd, EPOLL_CTL_ADD, rcv->sock, &ev));
+  }
+
+  return rcv;
+}  /* udp_rcv_create */
+
+
+void udp_rcv_delete(udp_rcv_t *rcv)
+{
+  if (rcv->epoll_fd != -1) {
+    close(rcv->epoll_fd);
+  }
+  close(rcv->sock);
+  free(rcv);
+}  /* udp_rcv_delete */
+
+
+ssize_t udp_rcv(udp_rcv_t *rcv, void *buf, size_t buf_len, int *running)
+{
+  socklen_t from_len = sizeof(rcv->from_sin);
+  ssize_t len;
+
+  switch (rcv->method) {
+    case UDP_RCV_BLOCKING:
+      len = recvfrom(rcv->sock, buf, buf_len, 0,
+          (struct sockaddr *)&rcv->from_sin, &from_len);
+      break;
+
+    case UDP_RCV_SPIN:
+      do {
+        len = recvfrom(rcv->sock, buf, buf_len, MSG_DONTWAIT,
+            (struct sockaddr *)&rcv->from_sin, &from_len);
+      } while (len == -1 && errno == EAGAIN &&
+          __atomic_load_n(running, __ATOMIC_RELAXED));
+      break;
+
+    case UDP_RCV_EPOLL:
+    {
+      struct epoll_event ev;
+      int num_events = epoll_wait(rcv->epoll_fd, &ev, 1, 100);
+      if (num_events <= 0) {
+        if (num_events == -1 && errno != EINTR) {
+          CPRT_EM1(num_events);
+        }
+        return -1;
+      }
+      len = recvfrom(rcv->sock, buf, buf_len, MSG_DONTWAIT,
+          (struct sockaddr *)&rcv->from_sin, &from_len);
+      break;
+    }
+
+    default:
+      len = -1;
+  }
+
+  if (len == -1 && errno != EAGAIN && errno != EINTR) {
+    CPRT_EM1(len);  /* Print the error and exit. */
+  }
+  return len;
+}  /* udp_rcv */
+
+
+void udp_send(int sock, struct sockaddr_in *dest_sin, void *buf, size_t len)
+{
+  CPRT_EM1(sendto(sock, buf, len, 0,
+      (struct sockaddr *)dest_sin, sizeof(*dest_sin)));
+}  /* udp_send */
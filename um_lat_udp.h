@@ -0,0 +1,70 @@
+/* um_lat_udp.h - raw UDP sockets for um_lat_udp_ping and um_lat_udp_pong.
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#ifndef UM_LAT_UDP_H
+#define UM_LAT_UDP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+/* The largest datagram. */
+#define UDP_MAX_MSG_LEN 65507
+
+/* How a receiver waits for a datagram. */
+enum udp_rcv_method_enum {
+  UDP_RCV_BLOCKING,  /* recvmsg() sleeps in the kernel. */
+  UDP_RCV_SPIN,  /* Non-blocking recvmsg() in a busy loop. */
+  UDP_RCV_EPOLL  /* epoll_wait(), then non-blocking recvmsg(). */
+};
+
+struct udp_rcv_s {
+  int sock;
+  int epoll_fd;  /* UDP_RCV_EPOLL only. */
+  enum udp_rcv_method_enum method;
+  struct sockaddr_in from_sin;  /* Sender of the last datagram. */
+};
+typedef struct udp_rcv_s udp_rcv_t;
+
+/* Parse a -s option: '' (empty)=blocking, 's'=spin, 'e'=epoll. */
+enum udp_rcv_method_enum udp_rcv_method_parse(char *method_str);
+char *udp_rcv_method_name(enum udp_rcv_method_enum method);
+
+/* Socket for sending to "group" (multicast or unicast) through "iface". */
+int udp_send_sock_create(struct in_addr iface);
+/* Receive on "port"; joins "group" on "iface" if it is multicast. */
+udp_rcv_t *udp_rcv_create(struct in_addr group, struct in_addr iface, int port,
+    enum udp_rcv_method_enum method);
+void udp_rcv_delete(udp_rcv_t *rcv);
+/* Returns the datagram's length, or -1 if there was none within about
+ * 100 ms or "*running" was cleared (so the caller can check for shutdown). */
+ssize_t udp_rcv(udp_rcv_t *rcv, void *buf, size_t buf_len, int *running);
+void udp_send(int sock, struct sockaddr_in *dest_sin, void *buf, size_t len);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  /* UM_LAT_UDP_H */
@@ -0,0 +1,425 @@
+/* um_lat_udp_ping.c - raw UDP version of um_lat_ping (no UM).
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#include "cprt.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "um_lat.h"
+#include "um_lat_hist.h"
+#include "um_lat_udp.h"
+
+
+/* Command-line options and their defaults. String defaults are set
+ * in "get_my_opts()".
+ */
+int o_affinity_src = -1;  /* -A */
+int o_affinity_rcv = -1;
+char *o_group = NULL;
+char *o_histogram = NULL;  /* -H */
+char *o_interface = NULL;
+int o_linger_ms = 1000;
+int o_msg_len = 0;
+int o_num_msgs = 0;
+int o_port = 12000;
+int o_rate = 0;
+char *o_rcv_method = NULL;  /* -s */
+char *o_time_source = NULL;  /* -t */
+char *o_warmup = NULL;
+
+/* Parameters parsed out from command-line options. */
+int hist_sig_digits = 2;
+int hist_max_sec = 60;
+enum udp_rcv_method_enum rcv_method = UDP_RCV_BLOCKING;
+int use_tsc = 0;
+int warmup_loops = 0;
+int warmup_rate = 0;
+struct in_addr group_in;
+struct in_addr iface_in;
+
+/* Globals. */
+int send_sock = -1;
+struct sockaddr_in dest_sin;
+char *msg_buf = NULL;
+perf_msg_t *perf_msg = NULL;
+udp_rcv_t *udp_rcv_obj = NULL;
+CPRT_THREAD_T rcv_thread_id;
+int rcv_running = 0;
+int global_max_tight_sends = 0;
+uint64_t next_seq = 1;
+hist_t *rtt_hist = NULL;
+hist_t *turnaround_hist = NULL;  /* Pong's receive to its reflect. */
+
+/* Written by the receive thread. */
+CPRT_CACHE_ALIGN uint64_t num_rcv_msgs = 0;
+uint64_t last_rcv_seq = 0;
+uint64_t num_seq_gaps = 0;  /* Messages skipped over in the seq sequence. */
+uint64_t num_seq_backward = 0;  /* Messages received out of seq order. */
+
+
+void help() {
+  fprintf(stderr, "Usage: um_lat_udp_ping [-h] [-A affinity_src] [-a affinity_rcv] [-g group]\n  [-H hist_sig_digits,hist_max_sec] [-i interface] [-l linger_ms] -m msg_len\n  -n num_msgs [-p port] -r rate [-s rcv_method] [-t time_source]\n  [-w warmup_loops,warmup_rate]\n");
+  fprintf(stderr, "Where (those marked with 'R' are required):\n"
+      "  -h : print help\n"
+      "  -A affinity_src : CPU number (0..N-1) for send thread (-1=none)\n"
+      "  -a affinity_rcv : CPU number (0..N-1) for receive thread (-1=none)\n"
+      "  -g group : multicast group (default 239.101.3.11), or pong's unicast\n"
+      "       address\n"
+      "  -H hist_sig_digits,hist_max_sec : round-trip time histogram precision and range\n"
+      "  -i interface : interface for multicast (default 127.0.0.1)\n"
+      "  -l linger_ms : linger time before exit\n"
+      "R -m msg_len : message length (%d..%d)\n"
+      "R -n num_msgs : number of messages to send\n"
+      "  -p port : send to port, receive replies on port+1 (default 12000)\n"
+      "R -r rate : messages per second to send\n"
+      "  -s rcv_method : '' (empty)=blocking, 's'=non-blocking spin, 'e'=epoll\n"
+      "  -t time_source : '' (empty)=CLOCK_MONOTONIC, 't'=invariant TSC\n"
+      "  -w warmup_loops,warmup_rate : messages to send before measurement\n",
+      (int)sizeof(struct timespec), UDP_MAX_MSG_LEN);
+  CPRT_NET_CLEANUP;
+  exit(0);
+}
+
+
+/* Process command-line options. */
+void get_my_opts(int argc, char **argv)
+{
+  int opt;  /* Loop variable for getopt(). */
+
+  /* Set defaults for string options. */
+  o_group = CPRT_STRDUP("239.101.3.11");
+  o_histogram = CPRT_STRDUP("2,60");
+  o_interface = CPRT_STRDUP("127.0.0.1");
+  o_rcv_method = CPRT_STRDUP("");
+  o_time_source = CPRT_STRDUP("");
+  o_warmup = CPRT_STRDUP("0,0");
+
+  while ((opt = cprt_getopt(argc, argv, "hA:a:g:H:i:l:m:n:p:r:s:t:w:")) != EOF) {
+    switch (opt) {
+      case 'h': help(); break;
+      case 'A': CPRT_ATOI(cprt_optarg, o_affinity_src); break;
+      case 'a': CPRT_ATOI(cprt_optarg, o_affinity_rcv); break;
+      case 'g': free(o_group); o_group = CPRT_STRDUP(cprt_optarg); break;
+      case 'H': {
+        free(o_histogram);
+        o_histogram = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_histogram);
+        char *strtok_context;
+        char *hist_sig_digits_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(hist_sig_digits_str != NULL);
+        CPRT_ATOI(hist_sig_digits_str, hist_sig_digits);
+
+        char *hist_max_sec_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        ASSRT(hist_max_sec_str != NULL);
+        CPRT_ATOI(hist_max_sec_str, hist_max_sec);
+
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        free(work_str);
+        break;
+      }
+      case 'i': free(o_interface); o_interface = CPRT_STRDUP(cprt_optarg); break;
+      case 'l': CPRT_ATOI(cprt_optarg, o_linger_ms); break;
+      case 'm': CPRT_ATOI(cprt_optarg, o_msg_len); break;
+      case 'n': CPRT_ATOI(cprt_optarg, o_num_msgs); break;
+      case 'p': CPRT_ATOI(cprt_optarg, o_port); break;
+      case 'r': CPRT_ATOI(cprt_optarg, o_rate); break;
+      case 's':
+        free(o_rcv_method);
+        o_rcv_method = CPRT_STRDUP(cprt_optarg);
+        rcv_method = udp_rcv_method_parse(o_rcv_method);
+        break;
+      case 't':
+        free(o_time_source);
+        o_time_source = CPRT_STRDUP(cprt_optarg);
+        if (strcasecmp(o_time_source, "") == 0) {
+          use_tsc = 0;
+        } else if (strcasecmp(o_time_source, "t") == 0) {
+          use_tsc = 1;
+        } else {
+          FATAL_ERROR("-t value must be '' or 't'\n");
+        }
+        break;
+      case 'w': {
+        free(o_warmup);
+        o_warmup = CPRT_STRDUP(cprt_optarg);
+        char *work_str = CPRT_STRDUP(o_warmup);
+        char *strtok_context;
+        char *warmup_loops_str = CPRT_STRTOK(work_str, ",", &strtok_context);
+        ASSRT(warmup_loops_str != NULL);
+        CPRT_ATOI(warmup_loops_str, warmup_loops);
+
+        char *warmup_rate_str = CPRT_STRTOK(NULL, ",", &strtok_context);
+        ASSRT(warmup_rate_str != NULL);
+        CPRT_ATOI(warmup_rate_str, warmup_rate);
+
+        ASSRT((CPRT_STRTOK(NULL, ",", &strtok_context)) == NULL);
+        if (warmup_loops > 0) {
+          ASSRT(warmup_rate > 0);
+        }
+        free(work_str);
+        break;
+      }
+      default:
+        fprintf(stderr, "um_lat_udp_ping: ERROR: unrecognized option '%c'\nUse '-h' for help\n", opt);
+        exit(1);
+    }  /* switch opt */
+  }  /* while getopt */
+
+  ASSRT(cprt_optind == argc);  /* No further command-line parameters allowed. */
+
+  /* Shorter datagrams (no send_ts) are pong's end-of-test signal. */
+  ASSRT(o_msg_len >= (int)sizeof(struct timespec) && o_msg_len <= UDP_MAX_MSG_LEN);
+  ASSRT(o_num_msgs > 0);
+  ASSRT(o_rate > 0);
+  ASSRT(hist_sig_digits >= 1 && hist_sig_digits <= 5);
+  ASSRT(hist_max_sec > 0);
+  ASSRT(o_port > 0 && o_port < 65535);
+  ASSRT(inet_aton(o_group, &group_in) != 0);
+  ASSRT(inet_aton(o_interface, &iface_in) != 0);
+
+  /* The first TSC selection calibrates it (about 50 ms) if it is invariant. */
+  if (use_tsc && ! cprt_tsc_select(1)) {
+    printf("WARNING: TSC is not invariant, using CLOCK_MONOTONIC\n");
+    use_tsc = 0;
+  }
+}  /* get_my_opts */
+
+
+void send_one(int send_timestamp)
+{
+  if (PERF_MSG_HAS(o_msg_len, seq)) {
+    perf_msg->seq = next_seq;
+  }
+  next_seq++;
+
+  if (send_timestamp) {
+    CPRT_GETTIME(&(perf_msg->send_ts));
+  }
+  else {
+    perf_msg->send_ts.tv_sec = 0;
+    perf_msg->send_ts.tv_nsec = 0;
+  }
+
+  udp_send(send_sock, &dest_sin, msg_buf, o_msg_len);
+}  /* send_one */
+
+
+/* Same pacing as um_lat_ping's send_loop(): send evenly spaced at
+ * sends_per_sec, catching up with back-to-back sends when behind. */
+int send_loop(int num_sends, uint64_t sends_per_sec, int send_timestamp)
+{
+  struct timespec cur_ts;
+  struct timespec start_ts;
+
+  int max_tight_sends = 0;
+
+  /* Send messages evenly-spaced using busy looping. Based on algorithm:
+   * http://www.geeky-boy.com/catchup/html/ */
+  CPRT_GETTIME(&start_ts);
+  cur_ts = start_ts;
+  int num_sent = 0;
+  do {  /* while num_sent < num_sends */
+    uint64_t ns_so_far;
+    CPRT_DIFF_TS(ns_so_far, cur_ts, start_ts);
+    /* The +1 is because we want to send, then pause. */
+    int should_have_sent = (int)((ns_so_far * sends_per_sec)/1000000000 + 1);
+    if (should_have_sent > num_sends) {
+      should_have_sent = num_sends;  // Don't send more than requested.
+    }
+    if ((should_have_sent - num_sent) > max_tight_sends) {
+      max_tight_sends = should_have_sent - num_sent;
+    }
+
+    /* If we are behind where we should be, get caught up. */
+    while (num_sent < should_have_sent) {
+      send_one(send_timestamp);
+      num_sent++;
+    }  /* while num_sent < should_have_sent */
+
+    CPRT_GETTIME(&cur_ts);
+  } while (num_sent < num_sends);
+
+  global_max_tight_sends = max_tight_sends;
+
+  return num_sent;
+}  /* send_loop */
+
+
+static CPRT_THREAD_ENTRYPOINT rcv_thread(void *in_arg)
+{
+  char *rcv_buf = (char *)malloc(UDP_MAX_MSG_LEN);
+  ASSRT(rcv_buf != NULL);
+  perf_msg_t *rcv_perf_msg = (perf_msg_t *)rcv_buf;
+
+  if (o_affinity_rcv > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(o_affinity_rcv, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+
+  while (__atomic_load_n(&rcv_running, __ATOMIC_ACQUIRE)) {
+    ssize_t len = udp_rcv(udp_rcv_obj, rcv_buf, UDP_MAX_MSG_LEN, &rcv_running);
+    if (len < (ssize_t)sizeof(struct timespec)) {
+      continue;  /* Timeout. */
+    }
+    struct timespec rcv_ts;
+    CPRT_GETTIME(&rcv_ts);
+
+    __atomic_store_n(&num_rcv_msgs, num_rcv_msgs + 1, __ATOMIC_RELAXED);
+
+    if (rcv_perf_msg->send_ts.tv_sec != 0) {
+      uint64_t ns_rtt;
+      CPRT_DIFF_TS(ns_rtt, rcv_ts, rcv_perf_msg->send_ts);
+      hist_input(rtt_hist, ns_rtt);
+
+      if (PERF_MSG_HAS(len, pong_send_ts)) {
+        uint64_t ns_turnaround;
+        CPRT_DIFF_TS(ns_turnaround, rcv_perf_msg->pong_send_ts, rcv_perf_msg->pong_rcv_ts);
+        hist_input(turnaround_hist, ns_turnaround);
+      }
+    }
+
+    if (PERF_MSG_HAS(len, seq)) {
+      uint64_t seq = rcv_perf_msg->seq;
+      if (seq > last_rcv_seq + 1) {
+        num_seq_gaps += seq - last_rcv_seq - 1;
+      }
+      if (seq <= last_rcv_seq) {
+        num_seq_backward++;
+      }
+      else {
+        last_rcv_seq = seq;
+      }
+    }
+  }
+
+  free(rcv_buf);
+  CPRT_THREAD_EXIT;
+  return 0;
+}  /* rcv_thread */
+
+
+int main(int argc, char **argv)
+{
+  struct timespec start_ts;  /* struct timespec is used by clock_gettime(). */
+  struct timespec end_ts;
+  uint64_t duration_ns;
+  int actual_sends;
+  double result_rate;
+
+  CPRT_NET_START;
+
+  CPRT_INITTIME();
+
+  get_my_opts(argc, argv);
+
+  /* Leave "comma space" at end of line to make parsing output easier. */
+  printf("o_affinity_src=%d, o_affinity_rcv=%d, o_group=%s, o_histogram=%s, o_interface=%s, o_linger_ms=%d, o_msg_len=%d, o_num_msgs=%d, o_port=%d, o_rate=%d, o_rcv_method='%s', o_time_source='%s', o_warmup=%s, \n",
+      o_affinity_src, o_affinity_rcv, o_group, o_histogram, o_interface, o_linger_ms, o_msg_len, o_num_msgs, o_port, o_rate, o_rcv_method, o_time_source, o_warmup);
+  printf("hist_sig_digits=%d, hist_max_sec=%d, rcv_method=%s, use_tsc=%d, tsc_ghz=%f, warmup_loops=%d, warmup_rate=%d, \n",
+      hist_sig_digits, hist_max_sec, udp_rcv_method_name(rcv_method), use_tsc, cprt_tsc_ghz(), warmup_loops, warmup_rate);
+  fflush(stdout);
+
+  rtt_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+  turnaround_hist = hist_create(hist_sig_digits, (uint64_t)hist_max_sec * 1000000000ull);
+
+  msg_buf = (char *)malloc(o_msg_len);
+  ASSRT(msg_buf != NULL);
+  memset(msg_buf, 0, o_msg_len);
+  perf_msg = (perf_msg_t *)msg_buf;
+
+  send_sock = udp_send_sock_create(iface_in);
+  memset(&dest_sin, 0, sizeof(dest_sin));
+  dest_sin.sin_family = AF_INET;
+  dest_sin.sin_addr = group_in;
+  dest_sin.sin_port = htons(o_port);
+
+  udp_rcv_obj = udp_rcv_create(group_in, iface_in, o_port + 1, rcv_method);
+  rcv_running = 1;
+  CPRT_THREAD_CREATE(rcv_thread_id, rcv_thread, NULL);
+
+  if (o_affinity_src > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(o_affinity_src, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+
+  if (warmup_loops > 0) {
+    /* Warmup loops to get CPU caches loaded. */
+    send_loop(warmup_loops, warmup_rate, 0);
+    CPRT_SLEEP_MS(o_linger_ms);
+  }
+
+  /* Measure overall send rate by timing the main send loop. */
+  __atomic_store_n(&num_rcv_msgs, 0, __ATOMIC_RELAXED);
+  last_rcv_seq = next_seq - 1;
+  CPRT_GETTIME(&start_ts);
+  actual_sends = send_loop(o_num_msgs, o_rate, 1);
+  CPRT_GETTIME(&end_ts);
+  CPRT_DIFF_TS(duration_ns, end_ts, start_ts);
+
+  CPRT_SLEEP_MS(o_linger_ms);
+
+  __atomic_store_n(&rcv_running, 0, __ATOMIC_RELEASE);
+  CPRT_THREAD_JOIN(rcv_thread_id);
+
+  /* A zero-length datagram tells pong (-E) that the test is over. */
+  udp_send(send_sock, &dest_sin, msg_buf, 0);
+
+  result_rate = (double)(duration_ns);
+  result_rate /= (double)1000000000;
+  /* Don't count initial message. */
+  result_rate = (double)(actual_sends - 1) / result_rate;
+
+  hist_print(rtt_hist);
+  if (turnaround_hist->num_samples > 0) {
+    hist_t *hists[1];
+    char *names[1];
+    hists[0] = turnaround_hist; names[0] = "turnaround_ns";
+    printf("Legs: turnaround_num_samples=%"PRIu64", \n", turnaround_hist->num_samples);
+    hist_print_compare("Legs:", 1, hists, names);
+  }
+
+  /* Leave "comma space" at end of line to make parsing output easier. */
+  printf("actual_sends=%d, duration_ns=%"PRIu64", result_rate=%f, global_max_tight_sends=%d, \n",
+      actual_sends, duration_ns, result_rate, global_max_tight_sends);
+
+  printf("Rcv: num_rcv_msgs=%"PRIu64", num_seq_gaps=%"PRIu64", num_seq_backward=%"PRIu64", \n",
+      num_rcv_msgs, num_seq_gaps, num_seq_backward);
+
+  ASSRT(num_rcv_msgs == (uint64_t)actual_sends);
+
+  udp_rcv_delete(udp_rcv_obj);
+  close(send_sock);
+  free(msg_buf);
+  hist_delete(rtt_hist);
+  hist_delete(turnaround_hist);
+
+  CPRT_NET_CLEANUP;
+  return 0;
+}  /* main */
@@ -0,0 +1,203 @@
+/* um_lat_udp_pong.c - raw UDP version of um_lat_pong (no UM).
+ * See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#include "cprt.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "um_lat.h"
+#include "um_lat_udp.h"
+
+
+/* Command-line options and their defaults. String defaults are set
+ * in "get_my_opts()".
+ */
+int o_affinity_rcv = -1;
+int o_exit_on_eos = 0;  /* -E */
+char *o_group = NULL;
+char *o_interface = NULL;
+int o_port = 12000;
+char *o_rcv_method = NULL;  /* -s */
+char *o_time_source = NULL;  /* -t */
+
+/* Parameters parsed out from command-line options. */
+enum udp_rcv_method_enum rcv_method = UDP_RCV_BLOCKING;
+int use_tsc = 0;
+struct in_addr group_in;
+struct in_addr iface_in;
+
+/* Globals. */
+int running = 1;
+uint64_t num_rcv_msgs = 0;
+
+
+void help() {
+  fprintf(stderr, "Usage: um_lat_udp_pong [-h] [-a affinity_rcv] [-E] [-g group] [-i interface]\n  [-p port] [-s rcv_method] [-t time_source]\n");
+  fprintf(stderr, "Where:\n"
+      "  -h : print help\n"
+      "  -a affinity_rcv : CPU number (0..N-1) for receive thread (-1=none)\n"
+      "  -E : exit when ping ends the test\n"
+      "  -g group : multicast group (default 239.101.3.11), or this host's\n"
+      "       unicast address (replies go to each message's sender)\n"
+      "  -i interface : interface for multicast (default 127.0.0.1)\n"
+      "  -p port : receive on port, reflect to port+1 (default 12000)\n"
+      "  -s rcv_method : '' (empty)=blocking, 's'=non-blocking spin, 'e'=epoll\n"
+      "  -t time_source : '' (empty)=CLOCK_MONOTONIC, 't'=invariant TSC\n");
+  CPRT_NET_CLEANUP;
+  exit(0);
+}
+
+
+/* Process command-line options. */
+void get_my_opts(int argc, char **argv)
+{
+  int opt;  /* Loop variable for getopt(). */
+
+  /* Set defaults for string options. */
+  o_group = CPRT_STRDUP("239.101.3.11");
+  o_interface = CPRT_STRDUP("127.0.0.1");
+  o_rcv_method = CPRT_STRDUP("");
+  o_time_source = CPRT_STRDUP("");
+
+  while ((opt = cprt_getopt(argc, argv, "ha:Eg:i:p:s:t:")) != EOF) {
+    switch (opt) {
+      case 'h': help(); break;
+      case 'a': CPRT_ATOI(cprt_optarg, o_affinity_rcv); break;
+      case 'E': o_exit_on_eos = 1; break;
+      case 'g': free(o_group); o_group = CPRT_STRDUP(cprt_optarg); break;
+      case 'i': free(o_interface); o_interface = CPRT_STRDUP(cprt_optarg); break;
+      case 'p': CPRT_ATOI(cprt_optarg, o_port); break;
+      case 's':
+        free(o_rcv_method);
+        o_rcv_method = CPRT_STRDUP(cprt_optarg);
+        rcv_method = udp_rcv_method_parse(o_rcv_method);
+        break;
+      case 't':
+        free(o_time_source);
+        o_time_source = CPRT_STRDUP(cprt_optarg);
+        if (strcasecmp(o_time_source, "") == 0) {
+          use_tsc = 0;
+        } else if (strcasecmp(o_time_source, "t") == 0) {
+          use_tsc = 1;
+        } else {
+          FATAL_ERROR("-t value must be '' or 't'\n");
+        }
+        break;
+      default:
+        fprintf(stderr, "um_lat_udp_pong: ERROR: unrecognized option '%c'\nUse '-h' for help\n", opt);
+        exit(1);
+    }  /* switch opt */
+  }  /* while getopt */
+
+  ASSRT(cprt_optind == argc);  /* No further command-line parameters allowed. */
+
+  ASSRT(o_port > 0 && o_port < 65535);
+  ASSRT(inet_aton(o_group, &group_in) != 0);
+  ASSRT(inet_aton(o_interface, &iface_in) != 0);
+
+  /* The first TSC selection calibrates it (about 50 ms) if it is invariant. */
+  if (use_tsc && ! cprt_tsc_select(1)) {
+    printf("WARNING: TSC is not invariant, using CLOCK_MONOTONIC\n");
+    use_tsc = 0;
+  }
+}  /* get_my_opts */
+
+
+int main(int argc, char **argv)
+{
+  CPRT_NET_START;
+
+  CPRT_INITTIME();
+
+  get_my_opts(argc, argv);
+
+  printf("o_affinity_rcv=%d, o_exit_on_eos=%d, o_group=%s, o_interface=%s, o_port=%d, o_rcv_method='%s', o_time_source='%s', \n",
+      o_affinity_rcv, o_exit_on_eos, o_group, o_interface, o_port, o_rcv_method, o_time_source);
+  printf("rcv_method=%s, use_tsc=%d, tsc_ghz=%f, \n",
+      udp_rcv_method_name(rcv_method), use_tsc, cprt_tsc_ghz());
+  fflush(stdout);
+
+  char *msg_buf = (char *)malloc(UDP_MAX_MSG_LEN);
+  ASSRT(msg_buf != NULL);
+  perf_msg_t *perf_msg = (perf_msg_t *)msg_buf;
+
+  int send_sock = udp_send_sock_create(iface_in);
+  int multicast = IN_MULTICAST(ntohl(group_in.s_addr));
+  struct sockaddr_in dest_sin;
+  memset(&dest_sin, 0, sizeof(dest_sin));
+  dest_sin.sin_family = AF_INET;
+  dest_sin.sin_addr = group_in;
+  dest_sin.sin_port = htons(o_port + 1);
+
+  udp_rcv_t *rcv = udp_rcv_create(group_in, iface_in, o_port, rcv_method);
+
+  /* The main thread is the receive thread. */
+  if (o_affinity_rcv > -1) {
+    uint64_t cpuset;
+    CPRT_CPU_ZERO(&cpuset);
+    CPRT_CPU_SET(o_affinity_rcv, &cpuset);
+    cprt_set_affinity(cpuset);
+  }
+
+  while (running) {
+    ssize_t len = udp_rcv(rcv, msg_buf, UDP_MAX_MSG_LEN, &running);
+    if (len == -1) {
+      continue;  /* Timeout. */
+    }
+    struct timespec rcv_ts;
+    CPRT_GETTIME(&rcv_ts);
+
+    if (len < (ssize_t)sizeof(struct timespec)) {
+      /* Ping's end of test. */
+      printf("rcv end, num_rcv_msgs=%"PRIu64", \n", num_rcv_msgs);
+      fflush(stdout);
+      num_rcv_msgs = 0;
+      if (o_exit_on_eos) {
+        running = 0;
+      }
+      continue;
+    }
+    num_rcv_msgs++;
+
+    /* If ping left room, tell it when we received and reflected the
+     * message so it can split up the round trip. */
+    if (PERF_MSG_HAS(len, pong_send_ts)) {
+      perf_msg->pong_rcv_ts = rcv_ts;
+      CPRT_GETTIME(&perf_msg->pong_send_ts);
+    }
+    if (! multicast) {
+      dest_sin.sin_addr = rcv->from_sin.sin_addr;
+    }
+    udp_send(send_sock, &dest_sin, msg_buf, len);
+  }
+
+  udp_rcv_delete(rcv);
+  close(send_sock);
+  free(msg_buf);
+
+  CPRT_NET_CLEANUP;
+  return 0;
+}  /* main */
@@ -0,0 +1,184 @@
+/* um_lat_uring.c - minimal io_uring wrapper (raw system calls, no liburing)
+ * for um_lat_jitter. See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#include "cprt.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "um_lat.h"
+#include "um_lat_uring.h"
+
+
+uring_t *uring_create(unsigned entries, int sqpoll_cpu, uring_t *attach)
+{
+  struct io_uring_params params;
+  uring_t *ring = (uring_t *)malloc(sizeof(uring_t));
+  ASSRT(ring != NULL);
+  memset(ring, 0, sizeof(uring_t));
+
+  memset(&params, 0, sizeof(params));
+  if (sqpoll_cpu >= 0) {
+    params.flags |= IORING_SETUP_SQPOLL | IORING_SETUP_SQ_AFF;
+    params.sq_thread_cpu = sqpoll_cpu;
+    params.sq_thread_idle = 2000;  /* ms of no work before it sleeps. */
+    ring->sqpoll = 1;
+  }
+  if (attach != NULL) {
+    params.flags |= IORING_SETUP_ATTACH_WQ;
+    params.wq_fd = attach->fd;
+  }
+  ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  CPRT_EM1(ring->fd);
+  ring->sq_entries = params.sq_entries;
+
+  ring->sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    /* SQ and CQ rings are in one mapping. */
+    if (ring->cq_ring_len > ring->sq_ring_len) {
+      ring->sq_ring_len = ring->cq_ring_len;
+    }
+    ring->cq_ring_len = ring->sq_ring_len;
+  }
+  ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  ASSRT(ring->sq_ring != MAP_FAILED);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ring = ring->sq_ring;
+  }
+  else {
+    ring->cq_ring = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ASSRT(ring->cq_ring != MAP_FAILED);
+  }
+  ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  ASSRT(ring->sqes != MAP_FAILED);
+
+  char *sq = (char *)ring->sq_ring;
+  ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+  ring->sq_flags = (unsigned *)(sq + params.sq_off.flags);
+  ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+  ring->sqe_tail = *ring->sq_tail;
+  char *cq = (char *)ring->cq_ring;
+  ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+  return ring;
+}  /* uring_create */
+
+
+void uring_delete(uring_t *ring)
+{
+  munmap(ring->sqes, ring->sqes_len);
+  if (ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_len);
+  }
+  munmap(ring->sq_ring, ring->sq_ring_len);
+  close(ring->fd);
+  free(ring);
+}  /* uring_delete */
+
+
+void uring_register_buffer(uring_t *ring, void *buf, size_t len)
+{
+  struct iovec iov;
+  iov.iov_base = buf;
+  iov.iov_len = len;
+  CPRT_EM1(syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, &iov, 1));
+}  /* uring_register_buffer */
+
+
+struct io_uring_sqe *uring_get_sqe(uring_t *ring)
+{
+  unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  if (ring->sqe_tail - head >= ring->sq_entries) {
+    return NULL;  /* Full. */
+  }
+  unsigned index = ring->sqe_tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  ring->sq_array[index] = index;
+  memset(sqe, 0, sizeof(*sqe));
+  ring->sqe_tail++;
+
+  return sqe;
+}  /* uring_get_sqe */
+
+
+void uring_submit(uring_t *ring, unsigned wait_nr)
+{
+  unsigned to_submit = ring->sqe_tail - *ring->sq_tail;
+  unsigned flags = 0;
+
+  /* Publish the prepared SQEs. */
+  __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+
+  if (ring->sqpoll) {
+    /* The polling thread sees the new tail, unless it went to sleep. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(ring->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) {
+      flags |= IORING_ENTER_SQ_WAKEUP;
+    }
+    else if (wait_nr == 0) {
+      return;  /* No system call. */
+    }
+  }
+  else if (to_submit == 0 && wait_nr == 0) {
+    return;
+  }
+  if (wait_nr > 0) {
+    flags |= IORING_ENTER_GETEVENTS;
+  }
+
+  int ret;
+  do {
+    ret = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr, flags, NULL, 0);
+  } while (ret == -1 && errno == EINTR);
+  CPRT_EM1(ret);
+}  /* uring_submit */
+
+
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring)
+{
+  unsigned head = *ring->cq_head;  /* Only this thread writes it. */
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+  return &ring->cqes[head & *ring->cq_mask];
+}  /* uring_peek_cqe */
+
+
+void uring_cqe_seen(uring_t *ring)
+{
+  __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}  /* uring_cqe_seen */
@@ -0,0 +1,82 @@
+/* um_lat_uring.h - minimal io_uring wrapper (raw system calls, no liburing)
+ * for um_lat_jitter. See https://github.com/UltraMessaging/um_lat */
+/*
+  Copyright (c) 2021-2022 Informatica Corporation
+  Permission is granted to licensees to use or alter this software for any
+  purpose, including commercial applications, according to the terms laid
+  out in the Software License Agreement.
+
+  This source code example is provided by Informatica for educational
+  and evaluation purposes only.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND INFORMATICA DISCLAIMS ALL WARRANTIES
+  EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY IMPLIED WARRANTIES OF
+  NON-INFRINGEMENT, MERCHANTABILITY OR FITNESS FOR A PARTICULAR
+  PURPOSE.  INFORMATICA DOES NOT WARRANT THAT USE OF THE SOFTWARE WILL BE
+  UNINTERRUPTED OR ERROR-FREE.  INFORMATICA SHALL NOT, UNDER ANY CIRCUMSTANCES,
+  BE LIABLE TO LICENSEE FOR LOST PROFITS, CONSEQUENTIAL, INCIDENTAL, SPECIAL OR
+  INDIRECT DAMAGES ARISING OUT OF OR RELATED TO THIS AGREEMENT OR THE
+  TRANSACTIONS CONTEMPLATED HEREUNDER, EVEN IF INFORMATICA HAS BEEN APPRISED OF
+  THE LIKELIHOOD OF SUCH DAMAGES.
+*/
+
+#ifndef UM_LAT_URING_H
+#define UM_LAT_URING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/* One io_uring: the submission queue (SQ) and completion queue (CQ) rings
+ * shared with the kernel, and the array of submission queue entries (SQEs).
+ * SQEs are prepared with uring_get_sqe() and handed to the kernel together
+ * by uring_submit(), so many requests cost one system call (or none, with
+ * a kernel SQ polling thread). */
+struct uring_s {
+  int fd;
+  int sqpoll;  /* Kernel thread polls the SQ. */
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_flags;
+  unsigned *sq_array;
+  unsigned sq_entries;
+  unsigned sqe_tail;  /* SQEs prepared; published to sq_tail by submit. */
+  struct io_uring_sqe *sqes;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_ring;
+  size_t sq_ring_len;
+  void *cq_ring;
+  size_t cq_ring_len;
+  size_t sqes_len;
+};
+typedef struct uring_s uring_t;
+
+/* sqpoll_cpu: -1 for no SQ polling thread, else the CPU to pin it to.
+ * attach: share the SQ polling thread of another ring (or NULL). */
+uring_t *uring_create(unsigned entries, int sqpoll_cpu, uring_t *attach);
+void uring_delete(uring_t *ring);
+/* Register one buffer (index 0) for READ_FIXED and WRITE_FIXED. */
+void uring_register_buffer(uring_t *ring, void *buf, size_t len);
+/* Returns a zeroed SQE, or NULL if the SQ is full. */
+struct io_uring_sqe *uring_get_sqe(uring_t *ring);
+/* Submit the prepared SQEs and, if wait_nr > 0, wait for that many
+ * completions. With SQ polling, only makes a system call to wake the
+ * polling thread or to wait. */
+void uring_submit(uring_t *ring, unsigned wait_nr);
+/* Returns the next completion, or NULL if none. */
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring);
+void uring_cqe_seen(uring_t *ring);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif  /* UM_LAT_URING_H */